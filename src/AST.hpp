@@ -1,9 +1,10 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <unordered_map>
 #include <unordered_set>
-#include <filesystem>
 
 struct Program
 {
@@ -39,7 +40,8 @@ struct Program
       LT_,
       GT_,
       EQ_,
-      BTN
+      BTN,
+      LUT_      // Compiled combinational cone, only produced by optimizeProgram()
     } type;
     std::string name;
     std::vector<int> inputs;
@@ -48,8 +50,12 @@ struct Program
     float hardcodedPresetTime = -1.0f;
     int hardcodedPresetValue = -1;
     int cvOutputSignal = -1;  // For counters: optional second output to expose CV value
+    uint64_t invertMask = 0;  // AND/OR/XOR/SR/RS: bit i set = inputs[i] is read inverted (inline NOT)
+    std::vector<uint64_t> lookupTable;  // LUT_: bit k = output when the input values, packed LSB first, equal k
+    std::vector<int> coveredLines;      // LUT_: sourceLines of the gates folded into it, for highlighting
+
+    bool invertedInput(size_t i) const { return i < 64 && ((invertMask >> i) & 1); }
   };
   std::vector<Node> nodes;
   std::vector<std::string> sourceLines;
-  std::filesystem::file_time_type lastModifiedAt;
 };
@@ -0,0 +1,128 @@
+#include "Bdd.hpp"
+#include <algorithm>
+#include <climits>
+
+BddManager::BddManager(size_t nodeLimit) : nodeLimit_(nodeLimit) {
+  // Terminals sort below every variable
+  nodes_.push_back({INT_MAX, False, False});
+  nodes_.push_back({INT_MAX, True, True});
+}
+
+BddManager::Ref BddManager::make_(int var, Ref low, Ref high) {
+  if (low == high) {
+    return low;
+  }
+  Key key{var, low, high};
+  auto it = unique_.find(key);
+  if (it != unique_.end()) {
+    return it->second;
+  }
+  if (nodes_.size() >= nodeLimit_) {
+    overflow_ = true;
+    return False;
+  }
+  Ref r = static_cast<Ref>(nodes_.size());
+  nodes_.push_back({var, low, high});
+  unique_.emplace(key, r);
+  return r;
+}
+
+int BddManager::topVar_(Ref f) const {
+  return nodes_[f].var;
+}
+
+BddManager::Ref BddManager::cofactor_(Ref f, int var, bool value) const {
+  const Node& n = nodes_[f];
+  if (n.var != var) {
+    return f;
+  }
+  return value ? n.high : n.low;
+}
+
+BddManager::Ref BddManager::var(int v) {
+  return make_(v, False, True);
+}
+
+BddManager::Ref BddManager::ite(Ref f, Ref g, Ref h) {
+  if (f == True) return g;
+  if (f == False) return h;
+  if (g == h) return g;
+  if (g == True && h == False) return f;
+  if (overflow_) return False;
+
+  Key key{f, g, h};
+  auto it = iteCache_.find(key);
+  if (it != iteCache_.end()) {
+    return it->second;
+  }
+  int v = std::min({topVar_(f), topVar_(g), topVar_(h)});
+  Ref t = ite(cofactor_(f, v, true), cofactor_(g, v, true), cofactor_(h, v, true));
+  Ref e = ite(cofactor_(f, v, false), cofactor_(g, v, false), cofactor_(h, v, false));
+  Ref r = make_(v, e, t);
+  if (!overflow_) {
+    iteCache_.emplace(key, r);
+  }
+  return r;
+}
+
+std::vector<int> BddManager::support(Ref f) const {
+  std::vector<int> vars;
+  std::vector<bool> seen(nodes_.size(), false);
+  std::vector<Ref> stack{f};
+  while (!stack.empty()) {
+    Ref r = stack.back();
+    stack.pop_back();
+    if (isConstant(r) || seen[r]) continue;
+    seen[r] = true;
+    vars.push_back(nodes_[r].var);
+    stack.push_back(nodes_[r].low);
+    stack.push_back(nodes_[r].high);
+  }
+  std::sort(vars.begin(), vars.end());
+  vars.erase(std::unique(vars.begin(), vars.end()), vars.end());
+  return vars;
+}
+
+bool BddManager::isop(Ref f, size_t maxCubes, std::vector<Cube>& cover) {
+  cover.clear();
+  bool tooBig = false;
+  isop_(f, f, maxCubes, cover, tooBig);
+  return !tooBig && !overflow_;
+}
+
+// Cover of some function g with lower <= g <= upper; returns g
+BddManager::Ref BddManager::isop_(Ref lower, Ref upper, size_t maxCubes, std::vector<Cube>& cover, bool& tooBig) {
+  if (tooBig || overflow_ || lower == False) {
+    return False;
+  }
+  if (upper == True) {
+    cover.push_back({});
+    return True;
+  }
+  int x = std::min(topVar_(lower), topVar_(upper));
+  Ref l0 = cofactor_(lower, x, false), l1 = cofactor_(lower, x, true);
+  Ref u0 = cofactor_(upper, x, false), u1 = cofactor_(upper, x, true);
+
+  // Terms that need x = 0, terms that need x = 1, then terms independent of x
+  std::vector<Cube> c0, c1, cs;
+  Ref f0 = isop_(andOf(l0, negate(u1)), u0, maxCubes, c0, tooBig);
+  Ref f1 = isop_(andOf(l1, negate(u0)), u1, maxCubes, c1, tooBig);
+  Ref rest = orOf(andOf(l0, negate(f0)), andOf(l1, negate(f1)));
+  Ref fs = isop_(rest, andOf(u0, u1), maxCubes, cs, tooBig);
+
+  for (auto& c : c0) {
+    c.insert(c.begin(), {x, false});
+    cover.push_back(std::move(c));
+  }
+  for (auto& c : c1) {
+    c.insert(c.begin(), {x, true});
+    cover.push_back(std::move(c));
+  }
+  for (auto& c : cs) {
+    cover.push_back(std::move(c));
+  }
+  if (cover.size() > maxCubes) {
+    tooBig = true;
+  }
+  return orOf(orOf(andOf(negate(var(x)), f0), andOf(var(x), f1)), fs);
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Reduced ordered binary decision diagrams. Variables are ordered by their
+// number, so the same function over the same variables always yields the same
+// Ref within one manager, which makes equivalence a simple comparison.
+class BddManager {
+public:
+  using Ref = int;
+  static constexpr Ref False = 0;
+  static constexpr Ref True = 1;
+
+  // A product term: (variable, positive) literals in variable order
+  using Cube = std::vector<std::pair<int, bool>>;
+
+  explicit BddManager(size_t nodeLimit = size_t{1} << 20);
+
+  Ref var(int v);
+  Ref ite(Ref f, Ref g, Ref h);
+  Ref negate(Ref f) { return ite(f, False, True); }
+  Ref andOf(Ref f, Ref g) { return ite(f, g, False); }
+  Ref orOf(Ref f, Ref g) { return ite(f, True, g); }
+
+  bool isConstant(Ref f) const { return f == False || f == True; }
+  // Set once the node limit was hit. Results computed since then are
+  // meaningless; clearOverflow() before the next independent computation.
+  bool overflow() const { return overflow_; }
+  void clearOverflow() { overflow_ = false; }
+
+  // Variables f depends on, ascending
+  std::vector<int> support(Ref f) const;
+  // Irredundant sum-of-products cover of f (Minato-Morreale). Returns false
+  // if the cover would need more than maxCubes terms.
+  bool isop(Ref f, size_t maxCubes, std::vector<Cube>& cover);
+
+private:
+  struct Node {
+    int var;
+    Ref low, high;
+  };
+  struct Key {
+    int a, b, c;
+    bool operator==(const Key&) const = default;
+  };
+  struct KeyHash {
+    size_t operator()(const Key& k) const noexcept {
+      uint64_t h = static_cast<uint32_t>(k.a);
+      h = h * 0x9E3779B97F4A7C15ull ^ static_cast<uint32_t>(k.b);
+      h = h * 0x9E3779B97F4A7C15ull ^ static_cast<uint32_t>(k.c);
+      return static_cast<size_t>(h ^ (h >> 29));
+    }
+  };
+  std::vector<Node> nodes_;
+  std::unordered_map<Key, Ref, KeyHash> unique_;   // (var, low, high) -> node
+  std::unordered_map<Key, Ref, KeyHash> iteCache_; // (f, g, h) -> result
+  size_t nodeLimit_;
+  bool overflow_ = false;
+
+  Ref make_(int var, Ref low, Ref high);
+  int topVar_(Ref f) const;
+  Ref cofactor_(Ref f, int var, bool value) const;
+  Ref isop_(Ref lower, Ref upper, size_t maxCubes, std::vector<Cube>& cover, bool& tooBig);
+};
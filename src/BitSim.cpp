@@ -0,0 +1,394 @@
+#include "BitSim.hpp"
+#include "Graph.hpp"
+#include <algorithm>
+#include <bit>
+
+BitSim::BitSim(const Program& prog, ScanOrder order) : prog_(prog) {
+  supported_ = order != ScanOrder::Settle;
+
+  // Same schedule as Simulator: unscheduled nodes go last in source order
+  if (order == ScanOrder::Source) {
+    computeTopologicalOrder(prog_, order_);
+  } else {
+    computeDependencyOrder(prog_, order_);
+  }
+  std::vector<bool> scheduled(prog_.nodes.size(), false);
+  for (int idx : order_) {
+    scheduled[idx] = true;
+  }
+  for (size_t i = 0; i < prog_.nodes.size(); ++i) {
+    if (!scheduled[i]) order_.push_back(static_cast<int>(i));
+  }
+
+  wideIndex_.assign(prog_.symbolToSignal.size(), -1);
+  int wide = 0;
+  auto makeWide = [&](int sig) {
+    if (sig >= 0 && sig < static_cast<int>(wideIndex_.size()) && wideIndex_[sig] < 0) {
+      wideIndex_[sig] = wide++;
+    }
+  };
+  for (int sig : prog_.analogSignals) {
+    makeWide(sig);
+  }
+  for (const auto& [sig, value] : prog_.constantSignalValues) {
+    makeWide(sig);
+  }
+  for (const auto& node : prog_.nodes) {
+    makeWide(node.cvOutputSignal);
+  }
+  curWide_.assign(static_cast<size_t>(wide) * kLanes, 0);
+  reset();
+}
+
+void BitSim::reset() {
+  scanCount_ = 0;
+  pendingBits_.clear();
+  pendingValues_.clear();
+  cur_.assign(wideIndex_.size(), 0);
+  std::fill(curWide_.begin(), curWide_.end(), 0);
+  for (const auto& [sig, value] : prog_.constantSignalValues) {
+    if (sig < 0 || sig >= static_cast<int>(cur_.size())) continue;
+    cur_[sig] = value != 0 ? ~uint64_t{0} : 0;
+    std::fill_n(curWide_.begin() + static_cast<size_t>(wideIndex_[sig]) * kLanes, kLanes,
+                static_cast<uint64_t>(value));
+  }
+  if (!stuck0_.empty()) {
+    for (size_t sig = 0; sig < cur_.size(); ++sig) {
+      applyStuck_(cur_, curWide_, static_cast<int>(sig));
+    }
+  }
+
+  state_.assign(prog_.nodes.size(), NodeState{});
+  for (size_t i = 0; i < prog_.nodes.size(); ++i) {
+    const auto& node = prog_.nodes[i];
+    auto& st = state_[i];
+    if (node.type == Program::Node::TON_ || node.type == Program::Node::TOF_) {
+      st.elapsed.assign(kLanes, 0.0f);
+      st.presetTime.assign(kLanes, node.hardcodedPresetTime > 0.0f ? node.hardcodedPresetTime : 3.0f);
+    } else if (node.type == Program::Node::CTU_ || node.type == Program::Node::CTD_) {
+      int preset = std::max(node.hardcodedPresetValue, 0);
+      st.presetCounter.assign(kLanes, preset);
+      st.counter.assign(kLanes, node.type == Program::Node::CTD_ ? preset : 0);
+    }
+  }
+}
+
+void BitSim::setBits(int sig, uint64_t lanes) {
+  if (sig >= 0 && sig < static_cast<int>(cur_.size())) {
+    pendingBits_.push_back({sig, lanes});
+  }
+}
+
+void BitSim::setValue(int sig, int lane, uint64_t value) {
+  if (sig >= 0 && sig < static_cast<int>(cur_.size()) && lane >= 0 && lane < kLanes) {
+    pendingValues_.push_back({sig, lane, value});
+  }
+}
+
+void BitSim::setButton(int node, uint64_t momentary, uint64_t latched) {
+  state_[node].momentary = momentary;
+  state_[node].latched = latched;
+}
+
+void BitSim::setPresetTime(int node, int lane, float seconds) {
+  state_[node].presetTime[lane] = seconds;
+}
+
+void BitSim::setPresetCounter(int node, int lane, int value) {
+  state_[node].presetCounter[lane] = value;
+}
+
+void BitSim::setStuck(int sig, uint64_t stuckAt0, uint64_t stuckAt1) {
+  if (stuck0_.empty()) {
+    stuck0_.assign(cur_.size(), 0);
+    stuck1_.assign(cur_.size(), 0);
+  }
+  stuck0_[sig] = stuckAt0 & ~stuckAt1;
+  stuck1_[sig] = stuckAt1;
+  applyStuck_(cur_, curWide_, sig);
+}
+
+void BitSim::clearStuck() {
+  stuck0_.clear();
+  stuck1_.clear();
+}
+
+void BitSim::applyStuck_(std::vector<uint64_t>& bits, std::vector<uint64_t>& wide, int sig) const {
+  uint64_t forced = stuck0_[sig] | stuck1_[sig];
+  if (!forced) {
+    return;
+  }
+  bits[sig] = (bits[sig] & ~forced) | stuck1_[sig];
+  int w = wideIndex_[sig];
+  if (w >= 0) {
+    for (int lane = 0; lane < kLanes; ++lane) {
+      if ((forced >> lane) & 1) wide[static_cast<size_t>(w) * kLanes + lane] = (stuck1_[sig] >> lane) & 1;
+    }
+  }
+}
+
+uint64_t BitSim::value(int sig, int lane) const {
+  int w = wideIndex_[sig];
+  return w >= 0 ? curWide_[static_cast<size_t>(w) * kLanes + lane] : (cur_[sig] >> lane) & 1;
+}
+
+void BitSim::saveLane(int lane, std::vector<uint64_t>& out) const {
+  out.clear();
+  for (size_t sig = 0; sig < cur_.size(); ++sig) {
+    out.push_back(value(static_cast<int>(sig), lane));
+  }
+  for (size_t i = 0; i < prog_.nodes.size(); ++i) {
+    const auto& st = state_[i];
+    out.push_back(((st.prev >> lane) & 1) | (((st.status >> lane) & 1) << 1));
+    if (!st.elapsed.empty()) out.push_back(std::bit_cast<uint32_t>(st.elapsed[lane]));
+    if (!st.counter.empty()) out.push_back(static_cast<uint32_t>(st.counter[lane]));
+  }
+}
+
+void BitSim::loadLane(int lane, const std::vector<uint64_t>& state) {
+  uint64_t bit = uint64_t{1} << lane;
+  auto setBit = [bit](uint64_t& word, bool on) { word = on ? word | bit : word & ~bit; };
+  size_t k = 0;
+  for (size_t sig = 0; sig < cur_.size(); ++sig) {
+    uint64_t v = state[k++];
+    setBit(cur_[sig], v != 0);
+    int w = wideIndex_[sig];
+    if (w >= 0) curWide_[static_cast<size_t>(w) * kLanes + lane] = v;
+  }
+  for (size_t i = 0; i < prog_.nodes.size(); ++i) {
+    auto& st = state_[i];
+    uint64_t flags = state[k++];
+    setBit(st.prev, flags & 1);
+    setBit(st.status, flags & 2);
+    if (!st.elapsed.empty()) st.elapsed[lane] = std::bit_cast<float>(static_cast<uint32_t>(state[k++]));
+    if (!st.counter.empty()) st.counter[lane] = static_cast<int>(static_cast<uint32_t>(state[k++]));
+  }
+}
+
+uint64_t BitSim::laneValue_(int sig, int lane) const {
+  int w = wideIndex_[sig];
+  return w >= 0 ? nextWide_[static_cast<size_t>(w) * kLanes + lane] : (next_[sig] >> lane) & 1;
+}
+
+uint64_t BitSim::in_(const Program::Node& n, size_t i) const {
+  uint64_t word = next_[n.inputs[i]];
+  return n.invertedInput(i) ? ~word : word;
+}
+
+void BitSim::write_(int sig, uint64_t word) {
+  next_[sig] = word;
+  int w = wideIndex_[sig];
+  if (w >= 0) {
+    uint64_t* values = &nextWide_[static_cast<size_t>(w) * kLanes];
+    for (int lane = 0; lane < kLanes; ++lane) {
+      values[lane] = (word >> lane) & 1;
+    }
+  }
+  if (!stuck0_.empty()) applyStuck_(next_, nextWide_, sig);
+}
+
+void BitSim::writeValue_(int sig, int lane, uint64_t value) {
+  uint64_t bit = uint64_t{1} << lane;
+  next_[sig] = value != 0 ? next_[sig] | bit : next_[sig] & ~bit;
+  int w = wideIndex_[sig];
+  if (w >= 0) {
+    nextWide_[static_cast<size_t>(w) * kLanes + lane] = value;
+  }
+  if (!stuck0_.empty()) applyStuck_(next_, nextWide_, sig);
+}
+
+// Simulator::advanceTimers_, lane by lane
+void BitSim::advanceTimers_(float dt) {
+  for (size_t i = 0; i < prog_.nodes.size(); ++i) {
+    const auto& node = prog_.nodes[i];
+    if (node.type != Program::Node::TON_ && node.type != Program::Node::TOF_) continue;
+    auto& st = state_[i];
+    uint64_t active = node.inputs.empty() ? 0 : cur_[node.inputs[0]];
+    for (int lane = 0; lane < kLanes; ++lane) {
+      uint64_t bit = uint64_t{1} << lane;
+      bool on = (active & bit) != 0;
+      float& elapsed = st.elapsed[lane];
+      if (node.type == Program::Node::TON_) {
+        if (on) elapsed += dt;
+        if (elapsed >= st.presetTime[lane]) {
+          elapsed = 0.0f;
+          st.status |= bit;
+        }
+        if (!on && (st.status & bit)) {
+          elapsed = 0.0f;
+          st.status &= ~bit;
+        }
+      } else {
+        if (on) elapsed = 0.0f;
+        else if (st.status & bit) elapsed += dt;
+        if (elapsed >= st.presetTime[lane]) {
+          elapsed = 0.0f;
+          st.status &= ~bit;
+        }
+      }
+    }
+  }
+}
+
+void BitSim::scan(float dt) {
+  if (!supported_) {
+    return;
+  }
+  if (dt > 0.0f) {
+    advanceTimers_(dt);
+  }
+  for (const auto& [sig, word] : pendingBits_) {
+    cur_[sig] = word;
+    int w = wideIndex_[sig];
+    if (w >= 0) {
+      for (int lane = 0; lane < kLanes; ++lane) {
+        curWide_[static_cast<size_t>(w) * kLanes + lane] = (word >> lane) & 1;
+      }
+    }
+    if (!stuck0_.empty()) applyStuck_(cur_, curWide_, sig);
+  }
+  pendingBits_.clear();
+  for (const auto& p : pendingValues_) {
+    uint64_t bit = uint64_t{1} << p.lane;
+    int w = wideIndex_[p.sig];
+    uint64_t value = w >= 0 ? p.value : (p.value != 0);
+    cur_[p.sig] = value != 0 ? cur_[p.sig] | bit : cur_[p.sig] & ~bit;
+    if (w >= 0) {
+      curWide_[static_cast<size_t>(w) * kLanes + p.lane] = value;
+    }
+    if (!stuck0_.empty()) applyStuck_(cur_, curWide_, p.sig);
+  }
+  pendingValues_.clear();
+
+  next_ = cur_;
+  nextWide_ = curWide_;
+  for (int idx : order_) {
+    evaluate_(idx);
+  }
+  std::swap(cur_, next_);
+  std::swap(curWide_, nextWide_);
+  ++scanCount_;
+}
+
+// Simulator::evaluateNode_ on all lanes at once
+void BitSim::evaluate_(int nodeIdx) {
+  const auto& n = prog_.nodes[nodeIdx];
+  auto& st = state_[nodeIdx];
+  uint64_t out = 0;
+
+  switch (n.type) {
+  case Program::Node::AND_:
+    out = ~uint64_t{0};
+    for (size_t i = 0; i < n.inputs.size(); ++i) {
+      out &= in_(n, i);
+    }
+    break;
+  case Program::Node::OR_:
+    for (size_t i = 0; i < n.inputs.size(); ++i) {
+      out |= in_(n, i);
+    }
+    break;
+  case Program::Node::XOR_: {
+    // Exactly one input true
+    uint64_t twice = 0;
+    for (size_t i = 0; i < n.inputs.size(); ++i) {
+      uint64_t x = in_(n, i);
+      twice |= out & x;
+      out |= x;
+    }
+    out &= ~twice;
+    break;
+  }
+  case Program::Node::NOT_:
+    if (!n.inputs.empty()) out = ~next_[n.inputs[0]];
+    break;
+  case Program::Node::PS_:
+  case Program::Node::NS_:
+    if (!n.inputs.empty()) {
+      uint64_t input = next_[n.inputs[0]];
+      out = n.type == Program::Node::PS_ ? input & ~st.prev : ~input & st.prev;
+      st.prev = input;
+    }
+    break;
+  case Program::Node::SR_:
+  case Program::Node::RS_:
+    if (!n.inputs.empty()) {
+      uint64_t s = in_(n, 0), r = in_(n, 1);
+      uint64_t hold = n.outputs.empty() ? 0 : next_[n.outputs[0]];
+      out = n.type == Program::Node::SR_ ? s | (~r & hold) : ~r & (s | hold);
+    }
+    break;
+  case Program::Node::TON_:
+    if (!n.inputs.empty()) {
+      uint64_t input = next_[n.inputs[0]];
+      out = input & st.status;
+      st.status &= input;
+      for (int lane = 0; lane < kLanes; ++lane) {
+        if (!((input >> lane) & 1)) st.elapsed[lane] = 0.0f;
+      }
+    }
+    break;
+  case Program::Node::TOF_:
+    if (!n.inputs.empty()) {
+      uint64_t input = next_[n.inputs[0]];
+      uint64_t expired = 0;
+      for (int lane = 0; lane < kLanes; ++lane) {
+        if (st.elapsed[lane] >= st.presetTime[lane]) expired |= uint64_t{1} << lane;
+      }
+      st.status = input | (st.status & ~expired);
+      out = st.status;
+    }
+    break;
+  case Program::Node::CTU_:
+  case Program::Node::CTD_:
+    if (n.inputs.size() >= 2) {
+      uint64_t count = next_[n.inputs[0]], other = next_[n.inputs[1]];
+      uint64_t edge = count & ~st.prev;
+      bool up = n.type == Program::Node::CTU_;
+      bool cvOut = n.cvOutputSignal >= 0 && n.cvOutputSignal < static_cast<int>(next_.size());
+      for (int lane = 0; lane < kLanes; ++lane) {
+        int& cv = st.counter[lane];
+        int pv = st.presetCounter[lane];
+        if ((other >> lane) & 1) {
+          cv = up ? 0 : pv; // CTU reset, CTD load
+        } else if ((edge >> lane) & 1) {
+          if (up && cv < 32767) ++cv;
+          if (!up && cv > 0) --cv;
+        }
+        if (up ? cv >= pv : cv <= 0) out |= uint64_t{1} << lane;
+        if (cvOut) writeValue_(n.cvOutputSignal, lane, static_cast<uint64_t>(cv));
+      }
+      st.prev = count;
+    }
+    break;
+  case Program::Node::LT_:
+  case Program::Node::GT_:
+  case Program::Node::EQ_:
+    if (n.inputs.size() >= 2) {
+      for (int lane = 0; lane < kLanes; ++lane) {
+        int a = static_cast<int>(laneValue_(n.inputs[0], lane));
+        int b = static_cast<int>(laneValue_(n.inputs[1], lane));
+        bool res = n.type == Program::Node::LT_ ? a < b : n.type == Program::Node::GT_ ? a > b : a == b;
+        if (res) out |= uint64_t{1} << lane;
+      }
+    }
+    break;
+  case Program::Node::LUT_:
+    for (int lane = 0; lane < kLanes; ++lane) {
+      size_t index = 0;
+      for (size_t i = 0; i < n.inputs.size(); ++i) {
+        index |= static_cast<size_t>((next_[n.inputs[i]] >> lane) & 1) << i;
+      }
+      out |= ((n.lookupTable[index >> 6] >> (index & 63)) & 1) << lane;
+    }
+    break;
+  case Program::Node::BTN:
+    out = st.momentary | st.latched;
+    break;
+  default:
+    break;
+  }
+  for (int outputSig : n.outputs) {
+    write_(outputSig, out);
+  }
+}
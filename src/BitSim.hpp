@@ -0,0 +1,96 @@
+#pragma once
+#include "AST.hpp"
+#include "Sim.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Runs 64 independent copies ("lanes") of one program in lockstep, with the
+// same scan semantics as Simulator::runScan(). Digital signals are one
+// machine word per signal, bit i belonging to lane i, so gates evaluate all
+// lanes in a single operation. Analog signals and counter CV outputs keep
+// one value per lane; counters, timers and comparators work lane by lane.
+// Timer and counter presets can differ per lane.
+//
+// ScanOrder::Settle is not supported (supported() is false).
+class BitSim {
+public:
+  static constexpr int kLanes = 64;
+
+  explicit BitSim(const Program& prog, ScanOrder order = ScanOrder::Source);
+
+  bool supported() const { return supported_; }
+  // Back to the state of a freshly constructed Simulator in every lane
+  void reset();
+
+  // Inputs, committed at the start of the next scan like Simulator's
+  // buffered inputs. Digital: one bit per lane; analog: one value per lane.
+  void setBits(int sig, uint64_t lanes);
+  void setValue(int sig, int lane, uint64_t value);
+  void setButton(int node, uint64_t momentary, uint64_t latched);
+  // Per lane presets and counter values; reset() restores the program's
+  void setPresetTime(int node, int lane, float seconds);
+  void setPresetCounter(int node, int lane, int value);
+  void setCounterValue(int node, int lane, int value) { state_[node].counter[lane] = value; }
+  // Fault simulation: in the lanes of stuckAt0/stuckAt1 the signal reads 0/1
+  // whatever drives it, until changed. Kept across reset().
+  void setStuck(int sig, uint64_t stuckAt0, uint64_t stuckAt1);
+  void clearStuck();
+
+  // One scan in every lane: advance timers by dt, then evaluate every node
+  void scan(float dt);
+
+  uint64_t bits(int sig) const { return cur_[sig]; }
+  uint64_t value(int sig, int lane) const;
+  // Analog signals, constants and counter CV outputs carry values, the
+  // other signals only 0/1
+  bool hasValues(int sig) const { return wideIndex_[sig] >= 0; }
+  uint64_t scanCount() const { return scanCount_; }
+  float timerElapsed(int node, int lane) const { return state_[node].elapsed[lane]; }
+  bool timerStatus(int node, int lane) const { return (state_[node].status >> lane) & 1; }
+  int counterValue(int node, int lane) const { return state_[node].counter[lane]; }
+  // PS/NS/CTU/CTD input as of the previous scan
+  bool previousInput(int node, int lane) const { return (state_[node].prev >> lane) & 1; }
+
+  // Everything one scan hands to the next in one lane (signal values and
+  // edge, timer and counter memory; not presets or BTN inputs), to explore
+  // reachable states. Call between scans with no inputs pending.
+  void saveLane(int lane, std::vector<uint64_t>& out) const;
+  void loadLane(int lane, const std::vector<uint64_t>& state);
+
+private:
+  const Program& prog_;
+  std::vector<int> order_;
+  bool supported_ = true;
+  uint64_t scanCount_ = 0;
+
+  std::vector<uint64_t> cur_, next_;             // per signal, bit = lane != 0
+  std::vector<int> wideIndex_;                   // per signal, -1 = digital only
+  std::vector<uint64_t> curWide_, nextWide_;     // wide index * 64 + lane
+  std::vector<std::pair<int, uint64_t>> pendingBits_;
+  struct PendingValue {
+    int sig, lane;
+    uint64_t value;
+  };
+  std::vector<PendingValue> pendingValues_;
+  std::vector<uint64_t> stuck0_, stuck1_; // per signal, empty = no faults
+
+  // Per node state, indexed by node; lane arrays only for the node types
+  // that need them
+  struct NodeState {
+    uint64_t prev = 0;          // PS/NS/CTU/CTD previous input
+    uint64_t status = 0;        // TON/TOF
+    uint64_t momentary = 0, latched = 0; // BTN
+    std::vector<float> elapsed, presetTime;
+    std::vector<int> counter, presetCounter;
+  };
+  std::vector<NodeState> state_;
+
+  uint64_t in_(const Program::Node& n, size_t i) const;
+  uint64_t laneValue_(int sig, int lane) const; // from next_
+  void write_(int sig, uint64_t word);
+  void writeValue_(int sig, int lane, uint64_t value);
+  void applyStuck_(std::vector<uint64_t>& bits, std::vector<uint64_t>& wide, int sig) const;
+  void advanceTimers_(float dt);
+  void evaluate_(int nodeIdx);
+};
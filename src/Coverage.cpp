@@ -0,0 +1,168 @@
+#include "Coverage.hpp"
+#include <algorithm>
+#include <map>
+
+static size_t words(size_t bits) {
+  return (bits + 63) / 64;
+}
+
+Coverage::Coverage(const Program& prog) : prog_(prog) {
+  size_t signals = words(prog_.symbolToSignal.size()), nodes = words(prog_.nodes.size());
+  previous_.assign(signals, 0);
+  rose_.assign(signals, 0);
+  fell_.assign(signals, 0);
+  nodeTrue_.assign(nodes, 0);
+  nodeFalse_.assign(nodes, 0);
+  presets_.assign(nodes, 0);
+  branches_.assign(words(prog_.nodes.size() * 3), 0);
+}
+
+// Signal i != 0 as bit i & 63 of word w
+static uint64_t packWord(const std::vector<uint64_t>& signals, size_t w, size_t n) {
+  uint64_t word = 0;
+  for (size_t i = w * 64; i < std::min(n, w * 64 + 64); ++i) {
+    word |= uint64_t{signals[i] != 0} << (i & 63);
+  }
+  return word;
+}
+
+void Coverage::begin(const std::vector<uint64_t>& signals) {
+  size_t n = std::min(signals.size(), prog_.symbolToSignal.size());
+  for (size_t w = 0; w < previous_.size(); ++w) {
+    previous_[w] = packWord(signals, w, n);
+  }
+}
+
+void Coverage::recordScan(const std::vector<uint64_t>& signals) {
+  size_t n = std::min(signals.size(), prog_.symbolToSignal.size());
+  for (size_t w = 0; w < previous_.size(); ++w) {
+    uint64_t word = packWord(signals, w, n);
+    rose_[w] |= word & ~previous_[w];
+    fell_[w] |= previous_[w] & ~word;
+    previous_[w] = word;
+  }
+}
+
+// Non-constant signals by id, one name each (aliases share an id)
+std::vector<std::pair<int, std::string>> Coverage::signals_() const {
+  std::vector<std::pair<int, std::string>> signals;
+  for (const auto& [name, sig] : prog_.symbolToSignal) {
+    if (!prog_.constantSignalValues.count(sig)) signals.push_back({sig, name});
+  }
+  std::sort(signals.begin(), signals.end());
+  signals.erase(std::unique(signals.begin(), signals.end(),
+                            [](const auto& a, const auto& b) { return a.first == b.first; }),
+                signals.end());
+  return signals;
+}
+
+void Coverage::merge(const Coverage& other) {
+  auto orInto = [](std::vector<uint64_t>& a, const std::vector<uint64_t>& b) {
+    for (size_t i = 0; i < std::min(a.size(), b.size()); ++i) {
+      a[i] |= b[i];
+    }
+  };
+  orInto(rose_, other.rose_);
+  orInto(fell_, other.fell_);
+  orInto(nodeTrue_, other.nodeTrue_);
+  orInto(nodeFalse_, other.nodeFalse_);
+  orInto(presets_, other.presets_);
+  orInto(branches_, other.branches_);
+}
+
+static bool isLatch(const Program::Node& node) {
+  return node.type == Program::Node::SR_ || node.type == Program::Node::RS_;
+}
+
+static bool hasPreset(const Program::Node& node) {
+  return node.type == Program::Node::TON_ || node.type == Program::Node::TOF_ ||
+         node.type == Program::Node::CTU_ || node.type == Program::Node::CTD_;
+}
+
+Coverage::Summary Coverage::summary() const {
+  Summary s;
+  for (const auto& [sig, name] : signals_()) {
+    ++s.signals;
+    if (test_(rose_, sig) && test_(fell_, sig)) ++s.signalsToggled;
+  }
+  for (size_t i = 0; i < prog_.nodes.size(); ++i) {
+    int node = static_cast<int>(i);
+    ++s.nodes;
+    if (test_(nodeTrue_, node) && test_(nodeFalse_, node)) ++s.nodesCovered;
+    if (isLatch(prog_.nodes[i])) {
+      s.branches += 3;
+      for (int b = 0; b < 3; ++b) {
+        if (test_(branches_, node * 3 + b)) ++s.branchesTaken;
+      }
+    }
+    if (hasPreset(prog_.nodes[i])) {
+      ++s.presets;
+      if (test_(presets_, node)) ++s.presetsReached;
+    }
+  }
+  return s;
+}
+
+std::string Coverage::report(const std::string& title) const {
+  // Gaps by 0-based source line; signals belong to the node that writes
+  // them, inputs to their declaration
+  std::map<int, std::vector<std::string>> gaps;
+  std::vector<int> signalLine(prog_.symbolToSignal.size(), -1);
+  for (const auto& node : prog_.nodes) {
+    for (int sig : node.outputs) {
+      if (signalLine[sig] < 0) signalLine[sig] = node.sourceLine;
+    }
+    if (node.cvOutputSignal >= 0 && signalLine[node.cvOutputSignal] < 0) {
+      signalLine[node.cvOutputSignal] = node.sourceLine;
+    }
+  }
+  for (const auto& token : prog_.tokens) {
+    auto it = prog_.symbolToSignal.find(token.symbol);
+    if (it != prog_.symbolToSignal.end() && signalLine[it->second] < 0) signalLine[it->second] = token.line;
+  }
+
+  for (const auto& [sig, name] : signals_()) {
+    bool rose = test_(rose_, sig), fell = test_(fell_, sig);
+    if (!rose && !fell) gaps[signalLine[sig]].push_back(name + " never changed");
+    else if (!rose) gaps[signalLine[sig]].push_back(name + " never 0->1");
+    else if (!fell) gaps[signalLine[sig]].push_back(name + " never 1->0");
+  }
+
+  static const char* kBranchNames[3] = {"set", "reset", "held"};
+  for (size_t i = 0; i < prog_.nodes.size(); ++i) {
+    const auto& node = prog_.nodes[i];
+    int idx = static_cast<int>(i);
+    auto& lineGaps = gaps[node.sourceLine];
+    if (!test_(nodeTrue_, idx)) lineGaps.push_back(node.name + " never true");
+    if (!test_(nodeFalse_, idx)) lineGaps.push_back(node.name + " never false");
+    if (isLatch(node)) {
+      for (int b = 0; b < 3; ++b) {
+        if (!test_(branches_, idx * 3 + b)) lineGaps.push_back(node.name + " never " + kBranchNames[b]);
+      }
+    }
+    if (hasPreset(node) && !test_(presets_, idx)) lineGaps.push_back(node.name + " never reached its preset");
+  }
+
+  Summary s = summary();
+  std::string text = "Coverage of " + title + "\n";
+  text += "  toggled " + std::to_string(s.signalsToggled) + "/" + std::to_string(s.signals) + " signals, " +
+          std::to_string(s.nodesCovered) + "/" + std::to_string(s.nodes) + " nodes true and false, " +
+          std::to_string(s.branchesTaken) + "/" + std::to_string(s.branches) + " SR/RS branches, " +
+          std::to_string(s.presetsReached) + "/" + std::to_string(s.presets) + " presets reached\n";
+  for (const auto& [line, items] : gaps) {
+    if (items.empty()) continue;
+    if (line >= 0 && line < static_cast<int>(prog_.sourceLines.size())) {
+      std::string source = prog_.sourceLines[line];
+      source.erase(0, source.find_first_not_of(" \t"));
+      text += "  line " + std::to_string(line + 1) + ": " + source + "\n";
+    } else {
+      text += "  (no source line)\n";
+    }
+    std::string list;
+    for (const auto& item : items) {
+      list += (list.empty() ? "" : "; ") + item;
+    }
+    text += "      " + list + "\n";
+  }
+  return text;
+}
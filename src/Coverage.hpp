@@ -0,0 +1,48 @@
+#pragma once
+#include "AST.hpp"
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Which parts of a program a run exercised: signals toggled 0->1 and 1->0,
+// nodes whose output was true and false, SR/RS set/reset/hold branches and
+// timers/counters that reached their preset. Collected by a Simulator it is
+// attached to (Simulator::setCoverage); while running everything is only
+// OR-ed into bitsets, the mapping back to source lines happens in report().
+class Coverage {
+public:
+  enum Branch { Set, Reset, Hold };
+
+  explicit Coverage(const Program& prog);
+
+  // Signal values toggles are counted from (power-on state or a rewind)
+  void begin(const std::vector<uint64_t>& signals);
+  // End of a scan: OR this scan's toggles in
+  void recordScan(const std::vector<uint64_t>& signals);
+  void recordOutput(int node, bool out) { set_(out ? nodeTrue_ : nodeFalse_, node); }
+  void recordBranch(int node, Branch branch) { set_(branches_, node * 3 + branch); }
+  void recordPreset(int node) { set_(presets_, node); }
+  // Add another run of the same program
+  void merge(const Coverage& other);
+
+  struct Summary {
+    size_t signalsToggled = 0, signals = 0; // both directions
+    size_t nodesCovered = 0, nodes = 0;     // output seen true and false
+    size_t branchesTaken = 0, branches = 0; // SR/RS set, reset, hold
+    size_t presetsReached = 0, presets = 0; // TON/TOF/CTU/CTD
+  };
+  Summary summary() const;
+  // Summary line plus, per source line, what was never exercised
+  std::string report(const std::string& title) const;
+
+private:
+  const Program& prog_;
+  std::vector<uint64_t> previous_, rose_, fell_; // by signal id
+  std::vector<uint64_t> nodeTrue_, nodeFalse_, presets_; // by node index
+  std::vector<uint64_t> branches_; // node index * 3 + Branch
+
+  static void set_(std::vector<uint64_t>& bits, int i) { bits[i >> 6] |= uint64_t{1} << (i & 63); }
+  static bool test_(const std::vector<uint64_t>& bits, int i) { return (bits[i >> 6] >> (i & 63)) & 1; }
+  std::vector<std::pair<int, std::string>> signals_() const;
+};
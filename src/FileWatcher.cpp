@@ -0,0 +1,182 @@
+#include "FileWatcher.hpp"
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string_view>
+#include <cstdio>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <climits>
+#include <cerrno>
+#include <unordered_map>
+#endif
+
+static size_t hashFile(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return 0;
+  }
+  std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  return std::hash<std::string_view>{}(text);
+}
+
+FileWatcher::FileWatcher(std::vector<std::string> paths, std::chrono::milliseconds debounce)
+    : debounce_(debounce) {
+  for (auto& path : paths) {
+    paths_.push_back(std::filesystem::absolute(path).lexically_normal().string());
+    contentHashes_.push_back(hashFile(paths_.back()));
+  }
+#ifdef __linux__
+  wakeFd_ = eventfd(0, EFD_CLOEXEC);
+#endif
+  thread_ = std::thread(&FileWatcher::run_, this);
+}
+
+FileWatcher::~FileWatcher() {
+  stop_ = true;
+#ifdef __linux__
+  if (wakeFd_ >= 0) {
+    uint64_t one = 1;
+    (void)!write(wakeFd_, &one, sizeof(one));
+  }
+#endif
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+#ifdef __linux__
+  if (wakeFd_ >= 0) {
+    close(wakeFd_);
+  }
+#endif
+}
+
+// Saving the same bytes again (or touching the file) needs no reload.
+// A file that vanished mid-save reads as 0 and is ignored until it is back.
+bool FileWatcher::contentChanged_() {
+  bool changed = false;
+  for (size_t i = 0; i < paths_.size(); ++i) {
+    size_t hash = hashFile(paths_[i]);
+    if (hash != 0 && hash != contentHashes_[i]) {
+      contentHashes_[i] = hash;
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+#ifdef __linux__
+void FileWatcher::run_() {
+  int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0) {
+    perror("inotify_init1");
+    return;
+  }
+
+  // Watch directories, not files: editors that save via rename replace the
+  // inode, which would silently end a watch on the file itself.
+  std::unordered_map<int, std::vector<std::string>> watchedNames; // wd -> file names
+  std::unordered_map<std::string, int> dirToWd;
+  for (const auto& path : paths_) {
+    std::filesystem::path p(path);
+    std::string dir = p.parent_path().string();
+    auto it = dirToWd.find(dir);
+    if (it == dirToWd.end()) {
+      int wd = inotify_add_watch(fd, dir.c_str(),
+                                 IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_MODIFY | IN_DELETE | IN_MOVED_FROM);
+      if (wd < 0) {
+        fprintf(stderr, "Could not watch %s\n", dir.c_str());
+        continue;
+      }
+      it = dirToWd.emplace(dir, wd).first;
+    }
+    watchedNames[it->second].push_back(p.filename().string());
+  }
+
+  alignas(struct inotify_event) char buf[16 * (sizeof(struct inotify_event) + NAME_MAX + 1)];
+  bool settled = true;   // No write finished since the last check
+  auto lastActivity = std::chrono::steady_clock::now();
+
+  while (!stop_) {
+    int timeoutMs = -1;
+    if (!settled) {
+      auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - lastActivity);
+      timeoutMs = static_cast<int>(std::max<long long>(0, (debounce_ - waited).count()));
+    }
+    pollfd fds[2] = {{fd, POLLIN, 0}, {wakeFd_, POLLIN, 0}};
+    int n = poll(fds, 2, timeoutMs);
+    if (n < 0 && errno != EINTR) {
+      break;
+    }
+    if (fds[1].revents & POLLIN) {
+      break;
+    }
+    if (fds[0].revents & POLLIN) {
+      ssize_t len;
+      while ((len = read(fd, buf, sizeof(buf))) > 0) {
+        for (char* ptr = buf; ptr < buf + len;) {
+          auto* ev = reinterpret_cast<struct inotify_event*>(ptr);
+          ptr += sizeof(struct inotify_event) + ev->len;
+          auto it = watchedNames.find(ev->wd);
+          if (it == watchedNames.end() || ev->len == 0) continue;
+          bool ours = false;
+          for (const auto& name : it->second) {
+            if (name == ev->name) ours = true;
+          }
+          if (!ours) continue;
+          lastActivity = std::chrono::steady_clock::now();
+          // Only a finished write or a rename into place makes the file
+          // worth reading; plain IN_MODIFY just pushes the debounce out.
+          if (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+            settled = false;
+          }
+        }
+      }
+    }
+    if (!settled && std::chrono::steady_clock::now() - lastActivity >= debounce_) {
+      settled = true;
+      if (contentChanged_()) {
+        changed_ = true;
+      }
+    }
+  }
+  close(fd);
+}
+#else
+// Fallback without inotify: stat a few times per second on the watcher
+// thread instead of every frame on the render thread.
+void FileWatcher::run_() {
+  std::vector<std::filesystem::file_time_type> stamps(paths_.size());
+  auto stampAll = [&]() {
+    bool moved = false;
+    for (size_t i = 0; i < paths_.size(); ++i) {
+      std::error_code ec;
+      auto stamp = std::filesystem::last_write_time(paths_[i], ec);
+      if (!ec && stamp != stamps[i]) {
+        stamps[i] = stamp;
+        moved = true;
+      }
+    }
+    return moved;
+  };
+  stampAll();
+
+  bool settled = true;
+  auto lastActivity = std::chrono::steady_clock::now();
+  while (!stop_) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    if (stampAll()) {
+      settled = false;
+      lastActivity = std::chrono::steady_clock::now();
+    }
+    if (!settled && std::chrono::steady_clock::now() - lastActivity >= debounce_) {
+      settled = true;
+      if (contentChanged_()) {
+        changed_ = true;
+      }
+    }
+  }
+}
+#endif
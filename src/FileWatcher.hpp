@@ -0,0 +1,35 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Watches the program file (and any further files handed in) on a background
+// thread. On Linux this is inotify on the parent directories, so atomic
+// "write temp + rename" saves are picked up as well as in-place writes. A
+// change is only reported once the files have been quiet for the debounce
+// period and their content actually differs from what was last reported.
+class FileWatcher {
+public:
+  explicit FileWatcher(std::vector<std::string> paths,
+                       std::chrono::milliseconds debounce = std::chrono::milliseconds(150));
+  ~FileWatcher();
+  FileWatcher(const FileWatcher&) = delete;
+  FileWatcher& operator=(const FileWatcher&) = delete;
+
+  // True once per settled change. Only an atomic load - safe to call every frame.
+  bool consumeChange() { return changed_.exchange(false, std::memory_order_acq_rel); }
+
+private:
+  std::vector<std::string> paths_;
+  std::vector<size_t> contentHashes_;
+  std::chrono::milliseconds debounce_;
+  std::atomic<bool> changed_{false};
+  std::atomic<bool> stop_{false};
+  int wakeFd_ = -1;
+  std::thread thread_;
+
+  void run_();
+  bool contentChanged_();
+};
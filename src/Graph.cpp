@@ -49,4 +49,128 @@ bool computeTopologicalOrder(const Program& prog, std::vector<int>& topoOrder) {
 
   // Return false if forward references detected
   return !hasForwardReference;
-}
\ No newline at end of file
+}
+
+bool computeDependencyOrder(const Program& prog, std::vector<int>& order, std::vector<std::vector<int>>* loops) {
+  order.clear();
+  if (loops) loops->clear();
+  const int nodeCount = static_cast<int>(prog.nodes.size());
+  const size_t signalCount = prog.symbolToSignal.size();
+
+  // A node depends on every writer of the signals it reads. Writers of the
+  // same signal are not ordered against each other; chaining them would
+  // invent loops between otherwise unrelated gates.
+  std::vector<std::vector<int>> drivers(signalCount);
+  for (int i = 0; i < nodeCount; ++i) {
+    const auto& node = prog.nodes[i];
+    for (int s : node.outputs) drivers[s].push_back(i);
+    if (node.cvOutputSignal >= 0) drivers[node.cvOutputSignal].push_back(i);
+  }
+  std::vector<std::vector<int>> successors(nodeCount);
+  std::vector<bool> readsItself(nodeCount, false);
+  for (int i = 0; i < nodeCount; ++i) {
+    for (int s : prog.nodes[i].inputs) {
+      for (int d : drivers[s]) {
+        // A node reading its own output (e.g. OR hold(set, q) -> q) is a
+        // loop of its own rather than an ordering constraint
+        if (d != i) successors[d].push_back(i);
+        else readsItself[i] = true;
+      }
+    }
+  }
+
+  // Tarjan's strongly connected components, iterative so long chains do
+  // not overflow the stack
+  std::vector<int> index(nodeCount, -1), lowLink(nodeCount, 0), component(nodeCount, -1);
+  std::vector<bool> onStack(nodeCount, false);
+  std::vector<int> stack;
+  std::vector<std::pair<int, size_t>> callStack;
+  std::vector<std::vector<int>> components;
+  int nextIndex = 0;
+  for (int start = 0; start < nodeCount; ++start) {
+    if (index[start] >= 0) continue;
+    callStack.push_back({start, 0});
+    while (!callStack.empty()) {
+      auto& [v, edge] = callStack.back();
+      if (edge == 0 && index[v] < 0) {
+        index[v] = lowLink[v] = nextIndex++;
+        stack.push_back(v);
+        onStack[v] = true;
+      }
+      if (edge < successors[v].size()) {
+        int w = successors[v][edge++];
+        if (index[w] < 0) {
+          callStack.push_back({w, 0});
+        } else if (onStack[w]) {
+          lowLink[v] = std::min(lowLink[v], index[w]);
+        }
+        continue;
+      }
+      if (lowLink[v] == index[v]) {
+        std::vector<int> members;
+        int w;
+        do {
+          w = stack.back();
+          stack.pop_back();
+          onStack[w] = false;
+          component[w] = static_cast<int>(components.size());
+          members.push_back(w);
+        } while (w != v);
+        std::sort(members.begin(), members.end());
+        components.push_back(std::move(members));
+      }
+      int finished = v;
+      callStack.pop_back();
+      if (!callStack.empty()) {
+        int parent = callStack.back().first;
+        lowLink[parent] = std::min(lowLink[parent], lowLink[finished]);
+      }
+    }
+  }
+
+  // Schedule the components in dependency order; among ready components the
+  // one that starts earliest in the source goes first, so already ordered
+  // programs keep their order exactly
+  const size_t componentCount = components.size();
+  std::vector<int> pending(componentCount, 0);
+  std::vector<std::vector<int>> componentSuccessors(componentCount);
+  for (int v = 0; v < nodeCount; ++v) {
+    for (int w : successors[v]) {
+      if (component[v] != component[w]) {
+        componentSuccessors[component[v]].push_back(component[w]);
+        pending[component[w]]++;
+      }
+    }
+  }
+  using Ready = std::pair<int, int>; // (first node, component)
+  std::priority_queue<Ready, std::vector<Ready>, std::greater<Ready>> ready;
+  for (size_t c = 0; c < componentCount; ++c) {
+    if (pending[c] == 0) ready.push({components[c].front(), static_cast<int>(c)});
+  }
+  bool acyclic = true;
+  while (!ready.empty()) {
+    int c = ready.top().second;
+    ready.pop();
+    const auto& members = components[c];
+    order.insert(order.end(), members.begin(), members.end());
+    if (members.size() > 1 || readsItself[members.front()]) {
+      acyclic = false;
+      if (loops) loops->push_back(members);
+    }
+    for (int next : componentSuccessors[c]) {
+      if (--pending[next] == 0) ready.push({components[next].front(), next});
+    }
+  }
+  return acyclic;
+}
+
+void sortNodesByDependencies(Program& prog) {
+  std::vector<int> order;
+  computeDependencyOrder(prog, order);
+  std::vector<Program::Node> nodes;
+  nodes.reserve(order.size());
+  for (int i : order) {
+    nodes.push_back(std::move(prog.nodes[i]));
+  }
+  prog.nodes = std::move(nodes);
+}
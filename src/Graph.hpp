@@ -6,3 +6,15 @@
 // Returns true if successful, false if cycle detected
 bool computeTopologicalOrder(const Program& prog, std::vector<int>& topoOrder);
 
+// Order nodes so that every node runs after the nodes producing its inputs,
+// which removes the one-scan lag of forward references. Feedback loops
+// (strongly connected components, or a single node reading its own output)
+// stay together in source order; they are returned in `loops` if given.
+// Returns false if there is such a loop.
+bool computeDependencyOrder(const Program& prog, std::vector<int>& order,
+                            std::vector<std::vector<int>>* loops = nullptr);
+
+// Physically reorder prog.nodes into computeDependencyOrder's order, so that
+// passes reasoning about source positions (optimizeProgram) see the order
+// the dependency-ordered scan will run in.
+void sortNodesByDependencies(Program& prog);
@@ -0,0 +1,127 @@
+#include "History.hpp"
+#include <bit>
+
+ScanHistory::ScanHistory(size_t capacity, size_t keyframeInterval)
+    : capacity_(capacity), keyframeInterval_(keyframeInterval > 0 ? keyframeInterval : 1) {}
+
+uint64_t ScanHistory::oldestScan() const {
+  return segments_.empty() ? 0 : segments_.front().firstScan;
+}
+
+uint64_t ScanHistory::newestScan() const {
+  if (segments_.empty()) {
+    return 0;
+  }
+  const auto& seg = segments_.back();
+  return seg.firstScan + seg.times.size() - 1;
+}
+
+void ScanHistory::clear() {
+  segments_.clear();
+  scans_ = 0;
+  prevSignals_.clear();
+  prevMemory_.clear();
+}
+
+void ScanHistory::record(const Simulator& sim) {
+  if (capacity_ == 0) {
+    return;
+  }
+  uint64_t scan = sim.scanCount();
+  const auto& sig = sim.signals();
+  if (!segments_.empty() && scan <= newestScan()) {
+    truncate_(scan);
+  }
+  sim.captureMemory(memory_);
+  bool contiguous = !segments_.empty() && scan == newestScan() + 1 && sig.size() == prevSignals_.size() &&
+                    memory_.size() == prevMemory_.size();
+  if (!contiguous) {
+    clear();
+  }
+
+  if (segments_.empty() || segments_.back().times.size() >= keyframeInterval_) {
+    Segment seg;
+    seg.firstScan = scan;
+    seg.signals = sig;
+    seg.memory = memory_;
+    seg.times.push_back(sim.simTime());
+    segments_.push_back(std::move(seg));
+  } else {
+    auto& seg = segments_.back();
+    for (size_t i = 0; i < sig.size(); ++i) {
+      if (sig[i] != prevSignals_[i]) {
+        seg.changes.push_back({static_cast<uint32_t>(i), sig[i]});
+      }
+    }
+    for (size_t i = 0; i < memory_.size(); ++i) {
+      if (memory_[i] != prevMemory_[i]) {
+        seg.changes.push_back({static_cast<uint32_t>(sig.size() + i), std::bit_cast<uint64_t>(memory_[i])});
+      }
+    }
+    seg.ends.push_back(static_cast<uint32_t>(seg.changes.size()));
+    seg.times.push_back(sim.simTime());
+  }
+  prevSignals_.assign(sig.begin(), sig.end());
+  prevMemory_.swap(memory_);
+  ++scans_;
+
+  // Drop whole segments from the front while the rest still covers capacity_
+  while (segments_.size() > 1 && scans_ - segments_.front().times.size() >= capacity_) {
+    scans_ -= segments_.front().times.size();
+    segments_.pop_front();
+  }
+}
+
+void ScanHistory::reconstruct_(uint64_t scan, std::vector<uint64_t>& signals, std::vector<double>& memory,
+                               double& time) const {
+  // Segments are contiguous and ordered, find the one holding `scan`
+  auto it = segments_.end();
+  do {
+    --it;
+  } while (it->firstScan > scan);
+  const Segment& seg = *it;
+  size_t offset = scan - seg.firstScan;
+  signals = seg.signals;
+  memory = seg.memory;
+  size_t end = offset > 0 ? seg.ends[offset - 1] : 0;
+  for (size_t c = 0; c < end; ++c) {
+    const Change& change = seg.changes[c];
+    if (change.slot < signals.size()) {
+      signals[change.slot] = change.value;
+    } else {
+      memory[change.slot - signals.size()] = std::bit_cast<double>(change.value);
+    }
+  }
+  time = seg.times[offset];
+}
+
+void ScanHistory::truncate_(uint64_t scan) {
+  if (segments_.empty() || scan <= oldestScan()) {
+    clear();
+    return;
+  }
+  while (segments_.back().firstScan >= scan) {
+    scans_ -= segments_.back().times.size();
+    segments_.pop_back();
+  }
+  auto& seg = segments_.back();
+  size_t keep = scan - seg.firstScan;
+  scans_ -= seg.times.size() - keep;
+  seg.times.resize(keep);
+  seg.ends.resize(keep - 1);
+  seg.changes.resize(seg.ends.empty() ? 0 : seg.ends.back());
+  double time;
+  reconstruct_(scan - 1, prevSignals_, prevMemory_, time);
+}
+
+bool ScanHistory::restore(uint64_t scan, Simulator& sim) const {
+  if (segments_.empty() || scan < oldestScan() || scan > newestScan()) {
+    return false;
+  }
+  std::vector<uint64_t> signals;
+  std::vector<double> memory;
+  double time = 0.0;
+  reconstruct_(scan, signals, memory, time);
+  sim.restoreScan(signals, memory, scan, time);
+  return true;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "Sim.hpp"
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// Bounded record of the last scans for rewinding. Every keyframeInterval
+// scans the full state is stored (signals plus Simulator::captureMemory());
+// the scans in between only store the signal and memory slots that changed.
+// Recording is a linear compare against the previous scan, so it can stay on
+// for every run. State is kept by signal id, so clear() it on hot reload.
+class ScanHistory {
+public:
+  explicit ScanHistory(size_t capacity = 10000, size_t keyframeInterval = 128);
+
+  // Scan observer. A scan number at or below the newest one means the
+  // simulator was rewound and continued: the abandoned future is dropped.
+  void record(const Simulator& sim);
+  void clear();
+
+  bool empty() const { return segments_.empty(); }
+  size_t capacity() const { return capacity_; }
+  uint64_t oldestScan() const;
+  uint64_t newestScan() const;
+  // Put `sim` into the state it had right after `scan`; false if that scan
+  // is no longer (or not yet) held
+  bool restore(uint64_t scan, Simulator& sim) const;
+
+private:
+  // slot < signal count: signal value, otherwise memory slot (double bits)
+  struct Change {
+    uint32_t slot;
+    uint64_t value;
+  };
+  struct Segment {
+    uint64_t firstScan = 0;
+    std::vector<uint64_t> signals; // keyframe, after firstScan
+    std::vector<double> memory;
+    std::vector<double> times;     // simTime per scan, [0] = keyframe
+    std::vector<uint32_t> ends;    // per later scan: end of its changes
+    std::vector<Change> changes;
+  };
+
+  size_t capacity_, keyframeInterval_;
+  std::deque<Segment> segments_;
+  size_t scans_ = 0;
+  std::vector<uint64_t> prevSignals_;
+  std::vector<double> prevMemory_, memory_;
+
+  void reconstruct_(uint64_t scan, std::vector<uint64_t>& signals, std::vector<double>& memory,
+                    double& time) const;
+  void truncate_(uint64_t scan); // drop scan and everything after it
+};
@@ -0,0 +1,76 @@
+#include "HotReload.hpp"
+#include "Graph.hpp"
+#include "Optimizer.hpp"
+
+HotReloader::HotReloader(std::string path, LoadOptions options)
+    : path_(std::move(path)), options_(options) {
+  thread_ = std::thread(&HotReloader::run_, this);
+}
+
+HotReloader::~HotReloader() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void HotReloader::request(std::shared_ptr<const Program> current) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_ = std::move(current);
+  }
+  cv_.notify_all();
+}
+
+std::optional<HotReloader::Build> HotReloader::take() {
+  std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+  if (!lock.owns_lock() || !done_) {
+    return std::nullopt;
+  }
+  std::optional<Build> build = std::move(done_);
+  done_.reset();
+  return build;
+}
+
+void HotReloader::run_() {
+  for (;;) {
+    std::shared_ptr<const Program> base;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] { return stop_ || pending_; });
+      if (stop_) {
+        return;
+      }
+      base = std::move(pending_);
+      pending_.reset();
+    }
+
+    // The running program is only ever read on the render thread, so copying
+    // it here is safe; the copy is then patched in place.
+    Build build;
+    if (options_.optimize) {
+      build.prog = std::make_shared<Program>();
+      build.result = parseFileParallel(path_, *build.prog);
+      if (build.result.ok) {
+        if (options_.order != ScanOrder::Source) {
+          sortNodesByDependencies(*build.prog);
+        }
+        optimizeProgram(*build.prog, options_.bddMinimize);
+      }
+    } else {
+      build.prog = std::make_shared<Program>(*base);
+      build.result = reparseFile(path_, *build.prog);
+    }
+    base.reset();
+    if (build.result.ok) {
+      build.sim = std::make_unique<Simulator>(*build.prog, options_.order);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    done_ = std::move(build); // a newer build supersedes one that was never taken
+  }
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "AST.hpp"
+#include "Parser.hpp"
+#include "Sim.hpp"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+// How a program is prepared after parsing, on startup and on every reload
+struct LoadOptions {
+  // With optimize, every reload is a full parse followed by optimizeProgram(),
+  // since an optimized Program no longer matches its source line for line and
+  // cannot be patched incrementally
+  bool optimize = false;
+  bool bddMinimize = false;
+  ScanOrder order = ScanOrder::Source;
+};
+
+// Re-parses the program and builds its Simulator on a worker thread while
+// the current pair keeps running. The render loop picks the finished pair up
+// with take() and swaps it in at a scan boundary.
+class HotReloader {
+public:
+  struct Build {
+    ParseResult result;
+    std::shared_ptr<Program> prog;
+    std::unique_ptr<Simulator> sim; // references *prog
+  };
+
+  explicit HotReloader(std::string path, LoadOptions options = {});
+  ~HotReloader();
+  HotReloader(const HotReloader&) = delete;
+  HotReloader& operator=(const HotReloader&) = delete;
+
+  // Queue a rebuild from the file on disk, diffed against `current`. The
+  // worker keeps `current` alive while it copies it. A request that arrives
+  // while a build is running is coalesced into one follow-up build.
+  void request(std::shared_ptr<const Program> current);
+  // The newest finished build, if any. Never blocks on the worker.
+  std::optional<Build> take();
+
+private:
+  std::string path_;
+  LoadOptions options_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::shared_ptr<const Program> pending_;
+  std::optional<Build> done_;
+  bool stop_ = false;
+  std::thread thread_;
+
+  void run_();
+};
@@ -1,14 +1,312 @@
 #include "ModbusManager.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#ifdef _WIN32
+#include <winsock2.h>
+static void closeSocket(int fd) { closesocket(fd); }
+static int sendSome(int fd, const uint8_t* data, int length) {
+    return send(fd, reinterpret_cast<const char*>(data), length, 0);
+}
+// select() takes at most FD_SETSIZE sockets
+static bool fitsSelect(int, size_t sockets) { return sockets <= FD_SETSIZE; }
+#else
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+static void closeSocket(int fd) { close(fd); }
+// No SIGPIPE when the peer is gone, as libmodbus sends
+static int sendSome(int fd, const uint8_t* data, int length) {
+    return static_cast<int>(send(fd, data, length, MSG_NOSIGNAL));
+}
+// select() takes descriptors below FD_SETSIZE
+static bool fitsSelect(int fd, size_t) { return fd < FD_SETSIZE; }
+#endif
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+// Waits for the responses of the buses with a request in flight: epoll on
+// Linux, select() elsewhere. A bus without a descriptor to wait on (serial
+// ports on Windows) is ready right away; libmodbus then waits for it. On
+// Linux a bus whose peer hung up is reported as lost, armed or not.
+class ResponseWait {
+public:
+    ResponseWait() {
+#ifdef __linux__
+        epollFd_ = epoll_create1(0);
+#endif
+    }
+    ~ResponseWait() {
+#ifdef __linux__
+        if (epollFd_ != -1) close(epollFd_);
+#endif
+    }
+    ResponseWait(const ResponseWait&) = delete;
+    ResponseWait& operator=(const ResponseWait&) = delete;
+
+    // Buses are numbered in the order they are added
+    void add(int fd) {
+#ifdef __linux__
+        epoll_event ev{};
+        ev.events = kHangup | EPOLLONESHOT;
+        ev.data.u32 = static_cast<uint32_t>(fds_.size());
+        if (fd != -1 && (epollFd_ == -1 || epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev) == -1)) fd = -1;
+#else
+        if (fd != -1 && !fitsSelect(fd, fds_.size() + 1)) fd = -1;
+#endif
+        fds_.push_back(fd);
+        armed_.push_back(false);
+    }
+    // A request of `bus` was sent
+    void arm(int bus) { setArmed_(bus, true); }
+    // Its response is no longer waited for
+    void disarm(int bus) { setArmed_(bus, false); }
+
+    // Appends the armed buses whose response arrived to `ready` and those
+    // that hung up to `lost`, waiting at most `timeoutMs`; they are disarmed
+    void wait(int timeoutMs, std::vector<int>& ready, std::vector<int>& lost) {
+        for (size_t i = 0; i < fds_.size(); ++i) {
+            if (armed_[i] && fds_[i] == -1) {
+                armed_[i] = false;
+                ready.push_back(static_cast<int>(i));
+            }
+        }
+        if (!ready.empty()) timeoutMs = 0;
+#ifdef __linux__
+        epoll_event events[16];
+        int n = epoll_wait(epollFd_, events, 16, timeoutMs);
+        for (int e = 0; e < n; ++e) {
+            // EPOLLONESHOT disabled it: a hung up descriptor is reported
+            // once, not on every call
+            int bus = static_cast<int>(events[e].data.u32);
+            if (events[e].events & kHangup) {
+                armed_[bus] = false;
+                lost.push_back(bus);
+            } else if (armed_[bus]) {
+                armed_[bus] = false;
+                ready.push_back(bus);
+            }
+        }
+#else
+        fd_set readable;
+        FD_ZERO(&readable);
+        int maxFd = -1;
+        for (size_t i = 0; i < fds_.size(); ++i) {
+            if (!armed_[i]) continue;
+            FD_SET(fds_[i], &readable);
+            maxFd = std::max(maxFd, fds_[i]);
+        }
+        if (maxFd == -1) {
+            if (ready.empty()) std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+            return;
+        }
+        timeval timeout{timeoutMs / 1000, (timeoutMs % 1000) * 1000};
+        if (select(maxFd + 1, &readable, nullptr, nullptr, &timeout) <= 0) return;
+        for (size_t i = 0; i < fds_.size(); ++i) {
+            if (armed_[i] && FD_ISSET(fds_[i], &readable)) {
+                armed_[i] = false;
+                ready.push_back(static_cast<int>(i));
+            }
+        }
+#endif
+    }
+
+private:
+    std::vector<int> fds_;
+    std::vector<bool> armed_;
+    int epollFd_ = -1;
+#ifdef __linux__
+    // A hung up peer. ERR and HUP are reported even when not asked for, so
+    // the mask stays one-shot when disarmed: with an empty one every
+    // epoll_wait() would return them again
+    static constexpr uint32_t kHangup = EPOLLERR | EPOLLHUP | EPOLLRDHUP;
+#endif
+
+    void setArmed_(int bus, bool armed) {
+        armed_[bus] = armed;
+#ifdef __linux__
+        if (fds_[bus] == -1) return;
+        epoll_event ev{};
+        ev.events = (armed ? uint32_t{EPOLLIN} : 0u) | kHangup | EPOLLONESHOT;
+        ev.data.u32 = static_cast<uint32_t>(bus);
+        epoll_ctl(epollFd_, EPOLL_CTL_MOD, fds_[bus], &ev);
+#endif
+    }
+};
+
+// Function codes the client sends
+enum : uint8_t {
+    kReadInputBits = 0x02,
+    kReadInputRegisters = 0x04,
+    kWriteBit = 0x05,
+    kWriteRegister = 0x06,
+    kWriteBits = 0x0F,
+    kWriteRegisters = 0x10,
+};
+// Most values one request may carry
+static constexpr int kMaxReadBits = 2000, kMaxReadRegisters = 125;
+static constexpr int kMaxWriteBits = 1968, kMaxWriteRegisters = 123;
+
+// One request of a poll cycle; addresses are relative to the link
+struct Request {
+    uint8_t function;
+    int address, count;
+};
+
+static void addRequests(std::vector<Request>& requests, uint8_t function, int first, int last, int max) {
+    for (int address = first; address < last; address += max) {
+        requests.push_back({function, address, std::min(max, last - address)});
+    }
+}
+
+// Unit id, function code and data of `req` (what modbus_send_raw_request
+// takes); `bits` and `registers` are the link's outputs. Returns the length
+static int buildRequest(uint8_t* raw, int slaveId, const Request& req, const uint8_t* bits,
+                        const uint16_t* registers) {
+    int n = 0;
+    raw[n++] = static_cast<uint8_t>(slaveId);
+    raw[n++] = req.function;
+    raw[n++] = static_cast<uint8_t>(req.address >> 8);
+    raw[n++] = static_cast<uint8_t>(req.address & 0xFF);
+    switch (req.function) {
+    case kWriteBit:
+        raw[n++] = bits[req.address] ? 0xFF : 0x00;
+        raw[n++] = 0x00;
+        break;
+    case kWriteRegister:
+        raw[n++] = static_cast<uint8_t>(registers[req.address] >> 8);
+        raw[n++] = static_cast<uint8_t>(registers[req.address] & 0xFF);
+        break;
+    default:
+        raw[n++] = static_cast<uint8_t>(req.count >> 8);
+        raw[n++] = static_cast<uint8_t>(req.count & 0xFF);
+        if (req.function == kWriteBits) {
+            raw[n++] = static_cast<uint8_t>((req.count + 7) / 8);
+            std::memset(raw + n, 0, (req.count + 7) / 8);
+            for (int i = 0; i < req.count; ++i) {
+                if (bits[req.address + i]) raw[n + i / 8] |= static_cast<uint8_t>(1 << (i % 8));
+            }
+            n += (req.count + 7) / 8;
+        } else if (req.function == kWriteRegisters) {
+            raw[n++] = static_cast<uint8_t>(req.count * 2);
+            for (int i = 0; i < req.count; ++i) {
+                raw[n++] = static_cast<uint8_t>(registers[req.address + i] >> 8);
+                raw[n++] = static_cast<uint8_t>(registers[req.address + i] & 0xFF);
+            }
+        }
+        break;
+    }
+    return n;
+}
+
+// Modbus TCP header: transaction id, protocol id 0 and the length of what
+// follows, unit id included
+static constexpr int kMbapLength = 6;
+
+// Sends the request built by buildRequest() at `raw + kMbapLength` over
+// Modbus TCP as transaction `tid`. modbus_send_raw_request() numbers every
+// raw request 0, which would not tell a late response from the answer
+static bool sendTcpRequest(int fd, uint16_t tid, uint8_t* raw, int length) {
+    raw[0] = static_cast<uint8_t>(tid >> 8);
+    raw[1] = static_cast<uint8_t>(tid & 0xFF);
+    raw[2] = raw[3] = 0;
+    raw[4] = static_cast<uint8_t>(length >> 8);
+    raw[5] = static_cast<uint8_t>(length & 0xFF);
+    for (int sent = 0, total = kMbapLength + length; sent < total;) {
+        int n = sendSome(fd, raw + sent, total - sent);
+        if (n <= 0) return false;
+        sent += n;
+    }
+    return true;
+}
+
+// Whether `rsp` answers `req`, the request in flight as TCP transaction
+// `tid` or to RTU unit `slaveId`, rather than an earlier one that timed
+// out. Serial frames carry no transaction id; one of another unit, or for
+// another function or amount, is not the answer
+static bool isAnswer(const uint8_t* rsp, int length, int headerLength, bool rtu, uint16_t tid, int slaveId,
+                     const Request& req) {
+    if (!rtu) return length >= 2 && ((rsp[0] << 8) | rsp[1]) == tid;
+    const uint8_t* pdu = rsp + headerLength;
+    int pduLength = length - headerLength;
+    if (pduLength < 2 || rsp[0] != slaveId) return false;
+    if (pdu[0] == (req.function | 0x80)) return true;
+    if (pdu[0] != req.function) return false;
+    switch (req.function) {
+    case kReadInputBits: return pdu[1] == (req.count + 7) / 8;
+    case kReadInputRegisters: return pdu[1] == req.count * 2;
+    // Writes echo the address
+    default: return pduLength >= 3 && ((pdu[1] << 8) | pdu[2]) == req.address;
+    }
+}
+
+// Checks the response to `req` and stores what it read into the link's
+// `bits` or `registers`; false with `error` set if it is not the answer
+static bool parseResponse(const uint8_t* rsp, int length, int headerLength, const Request& req, uint8_t* bits,
+                          uint16_t* registers, std::string& error) {
+    const uint8_t* pdu = rsp + headerLength;
+    int pduLength = length - headerLength;
+    if (pduLength >= 2 && pdu[0] == (req.function | 0x80)) {
+        error = modbus_strerror(MODBUS_ENOBASE + pdu[1]);
+        return false;
+    }
+    if (pduLength < 2 || pdu[0] != req.function) {
+        error = "Unexpected response";
+        return false;
+    }
+    if (req.function == kReadInputBits) {
+        int bytes = (req.count + 7) / 8;
+        if (pdu[1] != bytes || pduLength < 2 + bytes) {
+            error = "Unexpected response";
+            return false;
+        }
+        for (int i = 0; i < req.count; ++i) {
+            bits[req.address + i] = (pdu[2 + i / 8] >> (i % 8)) & 1;
+        }
+    } else if (req.function == kReadInputRegisters) {
+        int bytes = req.count * 2;
+        if (pdu[1] != bytes || pduLength < 2 + bytes) {
+            error = "Unexpected response";
+            return false;
+        }
+        for (int i = 0; i < req.count; ++i) {
+            registers[req.address + i] = static_cast<uint16_t>((pdu[2 + i * 2] << 8) | pdu[3 + i * 2]);
+        }
+    }
+    return true;
+}
+
+static const char* errorPrefix(uint8_t function) {
+    switch (function) {
+    case kReadInputBits: return "Read error: ";
+    case kReadInputRegisters: return "Analog read error: ";
+    case kWriteBit: case kWriteBits: return "Write error: ";
+    default: return "Analog write error: ";
+    }
+}
+
+static int clampBits(int n) { return std::clamp(n, 1, 512); }
+static int clampAnalog(int n) { return std::clamp(n, 0, 128); }
+static int clampBaud(int baud) { return std::clamp(baud, 300, 4000000); }
+static int clampFrameDelay(int us) { return std::clamp(us, 0, 1000000); }
+
+static bool validParity(char parity) {
+    return parity == 'N' || parity == 'E' || parity == 'O';
+}
 
 ModbusManager::ModbusManager() {
     loadConfig();
-    inputBits_.resize(numInputs_, 0);
-    coilBits_.resize(numOutputs_, 0);
-    inputRegisters_.resize(numAnalogInputs_, 0);
-    holdingRegisters_.resize(numAnalogOutputs_, 0);
 }
 
 ModbusManager::~ModbusManager() {
@@ -17,53 +315,81 @@ ModbusManager::~ModbusManager() {
 }
 
 void ModbusManager::setNumInputs(int n) {
-    if (n < 1) n = 1;
-    if (n > 512) n = 512;
-    numInputs_ = n;
-    inputBits_.resize(numInputs_, 0);
+    endpoints_[0].numInputs = clampBits(n);
 }
 
 void ModbusManager::setNumOutputs(int n) {
-    if (n < 1) n = 1;
-    if (n > 512) n = 512;
-    numOutputs_ = n;
-    coilBits_.resize(numOutputs_, 0);
+    endpoints_[0].numOutputs = clampBits(n);
 }
 
 void ModbusManager::setNumAnalogInputs(int n) {
-    if (n < 0) n = 0;
-    if (n > 128) n = 128;
-    numAnalogInputs_ = n;
-    inputRegisters_.resize(numAnalogInputs_, 0);
+    endpoints_[0].numAnalogInputs = clampAnalog(n);
 }
 
 void ModbusManager::setNumAnalogOutputs(int n) {
-    if (n < 0) n = 0;
-    if (n > 128) n = 128;
-    numAnalogOutputs_ = n;
-    holdingRegisters_.resize(numAnalogOutputs_, 0);
+    endpoints_[0].numAnalogOutputs = clampAnalog(n);
+}
+
+void ModbusManager::setPollPeriodMs(int ms) {
+    if (ms < 1) ms = 1;
+    if (ms > 10000) ms = 10000;
+    pollPeriodMs_ = ms;
+}
+
+void ModbusManager::setBaudRate(int baud) {
+    endpoints_[0].baudRate = clampBaud(baud);
+}
+
+void ModbusManager::setParity(char parity) {
+    parity = static_cast<char>(std::toupper(static_cast<unsigned char>(parity)));
+    if (validParity(parity)) endpoints_[0].parity = parity;
+}
+
+void ModbusManager::setFrameDelayUs(int us) {
+    endpoints_[0].frameDelayUs = clampFrameDelay(us);
 }
 
 void ModbusManager::loadConfig() {
     std::ifstream f("modbus_config.txt");
     if (!f.is_open()) return;
 
+    // The keys before the first [endpoint] line describe the first endpoint
+    endpoints_.assign(1, Endpoint());
     std::string line;
     while (std::getline(f, line)) {
+        if (line == "[endpoint]") {
+            endpoints_.emplace_back();
+            continue;
+        }
+        Endpoint& ep = endpoints_.back();
         std::istringstream iss(line);
         std::string key, value;
         if (std::getline(iss, key, '=') && std::getline(iss, value)) {
             try {
-                if (key == "ip") ip_ = value;
-                else if (key == "port") port_ = std::stoi(value);
-                else if (key == "slave_id") slaveId_ = std::stoi(value);
-                else if (key == "num_inputs") numInputs_ = std::stoi(value);
-                else if (key == "num_outputs") numOutputs_ = std::stoi(value);
-                else if (key == "num_analog_inputs") numAnalogInputs_ = std::stoi(value);
-                else if (key == "num_analog_outputs") numAnalogOutputs_ = std::stoi(value);
+                if (key == "mode") mode_ = (value == "server") ? Mode::Server : Mode::Client;
+                else if (key == "poll_period_ms") setPollPeriodMs(std::stoi(value));
                 else if (key == "analog_register_mode") {
                     analogRegisterMode_ = (value == "32") ? AnalogRegisterMode::BITS_32 : AnalogRegisterMode::BITS_16;
                 }
+                else if (key == "transport") ep.transport = (value == "rtu") ? Transport::Rtu : Transport::Tcp;
+                else if (key == "ip") ep.ip = value;
+                else if (key == "port") ep.port = std::stoi(value);
+                else if (key == "slave_id") ep.slaveId = std::stoi(value);
+                else if (key == "serial_device") ep.serialDevice = value;
+                else if (key == "baud") ep.baudRate = clampBaud(std::stoi(value));
+                else if (key == "parity" && !value.empty() && validParity(value[0])) ep.parity = value[0];
+                else if (key == "data_bits") ep.dataBits = std::stoi(value) == 7 ? 7 : 8;
+                else if (key == "stop_bits") ep.stopBits = std::stoi(value) == 2 ? 2 : 1;
+                else if (key == "frame_delay_us") ep.frameDelayUs = clampFrameDelay(std::stoi(value));
+                else if (key == "rs485") ep.rs485 = value == "1";
+                else if (key == "num_inputs") ep.numInputs = clampBits(std::stoi(value));
+                else if (key == "num_outputs") ep.numOutputs = clampBits(std::stoi(value));
+                else if (key == "num_analog_inputs") ep.numAnalogInputs = clampAnalog(std::stoi(value));
+                else if (key == "num_analog_outputs") ep.numAnalogOutputs = clampAnalog(std::stoi(value));
+                else if (key == "first_input") ep.firstInput = std::stoi(value);
+                else if (key == "first_output") ep.firstOutput = std::stoi(value);
+                else if (key == "first_analog_input") ep.firstAnalogInput = std::stoi(value);
+                else if (key == "first_analog_output") ep.firstAnalogOutput = std::stoi(value);
             } catch (...) {}
         }
     }
@@ -73,165 +399,697 @@ void ModbusManager::saveConfig() {
     std::ofstream f("modbus_config.txt");
     if (!f.is_open()) return;
 
-    f << "ip=" << ip_ << "\n";
-    f << "port=" << port_ << "\n";
-    f << "slave_id=" << slaveId_ << "\n";
-    f << "num_inputs=" << numInputs_ << "\n";
-    f << "num_outputs=" << numOutputs_ << "\n";
-    f << "num_analog_inputs=" << numAnalogInputs_ << "\n";
-    f << "num_analog_outputs=" << numAnalogOutputs_ << "\n";
+    f << "mode=" << (mode_ == Mode::Server ? "server" : "client") << "\n";
+    f << "poll_period_ms=" << pollPeriodMs_ << "\n";
     f << "analog_register_mode=" << (analogRegisterMode_ == AnalogRegisterMode::BITS_32 ? "32" : "16") << "\n";
+    for (size_t i = 0; i < endpoints_.size(); ++i) {
+        const Endpoint& ep = endpoints_[i];
+        if (i > 0) f << "[endpoint]\n";
+        f << "transport=" << (ep.transport == Transport::Rtu ? "rtu" : "tcp") << "\n";
+        f << "ip=" << ep.ip << "\n";
+        f << "port=" << ep.port << "\n";
+        f << "slave_id=" << ep.slaveId << "\n";
+        f << "serial_device=" << ep.serialDevice << "\n";
+        f << "baud=" << ep.baudRate << "\n";
+        f << "parity=" << ep.parity << "\n";
+        f << "data_bits=" << ep.dataBits << "\n";
+        f << "stop_bits=" << ep.stopBits << "\n";
+        f << "frame_delay_us=" << ep.frameDelayUs << "\n";
+        f << "rs485=" << (ep.rs485 ? 1 : 0) << "\n";
+        f << "num_inputs=" << ep.numInputs << "\n";
+        f << "num_outputs=" << ep.numOutputs << "\n";
+        f << "num_analog_inputs=" << ep.numAnalogInputs << "\n";
+        f << "num_analog_outputs=" << ep.numAnalogOutputs << "\n";
+        if (ep.firstInput >= 0) f << "first_input=" << ep.firstInput << "\n";
+        if (ep.firstOutput >= 0) f << "first_output=" << ep.firstOutput << "\n";
+        if (ep.firstAnalogInput >= 0) f << "first_analog_input=" << ep.firstAnalogInput << "\n";
+        if (ep.firstAnalogOutput >= 0) f << "first_analog_output=" << ep.firstAnalogOutput << "\n";
+    }
+}
+
+std::string ModbusManager::getLastError() const {
+    std::lock_guard<std::mutex> lock(errorMutex_);
+    return lastError_;
+}
+
+void ModbusManager::setError_(const std::string& error) {
+    std::lock_guard<std::mutex> lock(errorMutex_);
+    lastError_ = error;
+}
+
+static int numSignals(int registers, bool wide) {
+    return wide ? registers / 2 : registers;
+}
+
+// 3.5 character times (start, data, parity and stop bits); fixed above
+// 19200 baud as the Modbus over serial line specification asks
+static int standardFrameDelayUs(int baud, int dataBits, char parity, int stopBits) {
+    if (baud > 19200) return 1750;
+    int bits = 1 + dataBits + (parity == 'N' ? 0 : 1) + stopBits;
+    return static_cast<int>(3.5 * bits * 1000000 / baud);
+}
+
+// The smallest index range [first, last) holding every difference
+template <typename T>
+static std::pair<int, int> changedSpan(const T* now, const T* before, int count) {
+    int first = 0, last = count;
+    while (first < last && now[first] == before[first]) ++first;
+    while (last > first && now[last - 1] == before[last - 1]) --last;
+    return {first, last};
 }
 
 bool ModbusManager::connect() {
     disconnect();
     saveConfig();
 
-    ctx_ = modbus_new_tcp(ip_.c_str(), port_);
-    if (!ctx_) {
-        lastError_ = "Failed to create modbus context";
+    bool server = mode_ == Mode::Server;
+    if (server && endpoints_[0].transport == Transport::Rtu) {
+        setError_("Server mode needs Modbus TCP");
         return false;
     }
 
-    modbus_set_slave(ctx_, slaveId_);
-
-    if (modbus_connect(ctx_) == -1) {
-        lastError_ = std::string("Connection failed: ") + modbus_strerror(errno);
-        modbus_free(ctx_);
-        ctx_ = nullptr;
-        return false;
+    // The server listens on the first endpoint only
+    bool wide = analogRegisterMode_ == AnalogRegisterMode::BITS_32;
+    layout_ = Layout();
+    layout_.wide = wide;
+    layout_.server = server;
+    layout_.pollPeriodMs = pollPeriodMs_;
+    int nextInput = 0, nextOutput = 0, nextAnalogInput = 0, nextAnalogOutput = 0;
+    for (size_t i = 0; i < (server ? 1 : endpoints_.size()); ++i) {
+        const Endpoint& ep = endpoints_[i];
+        bool rtu = ep.transport == Transport::Rtu;
+        // A serial line is one bus, however many units are on it
+        auto shared = std::find_if(buses_.begin(), buses_.end(), [&](const Bus& bus) {
+            return rtu && bus.rtu && bus.name == ep.serialDevice;
+        });
+        if (shared == buses_.end()) {
+            Bus bus;
+            bus.rtu = rtu;
+            bus.ctx = rtu ? modbus_new_rtu(ep.serialDevice.c_str(), ep.baudRate, ep.parity, ep.dataBits, ep.stopBits)
+                          : modbus_new_tcp(ep.ip.c_str(), ep.port);
+            if (!bus.ctx) {
+                setError_("Failed to create modbus context");
+                disconnect();
+                return false;
+            }
+            modbus_set_slave(bus.ctx, ep.slaveId);
+            bus.name = rtu ? ep.serialDevice : ep.ip + ":" + std::to_string(ep.port);
+            bus.frameDelayUs = !rtu ? 0
+                : ep.frameDelayUs > 0 ? ep.frameDelayUs : standardFrameDelayUs(ep.baudRate, ep.dataBits, ep.parity, ep.stopBits);
+            bus.rs485 = rtu && ep.rs485;
+            buses_.push_back(std::move(bus));
+            shared = buses_.end() - 1;
+        }
+        shared->links.push_back(static_cast<int>(links_.size()));
+        Link link;
+        link.bus = static_cast<int>(shared - buses_.begin());
+        link.name = rtu ? ep.serialDevice + " unit " + std::to_string(ep.slaveId) : shared->name;
+        link.slaveId = ep.slaveId;
+        link.inputs = ep.numInputs;
+        link.outputs = ep.numOutputs;
+        link.inputRegisters = ep.numAnalogInputs * (wide ? 2 : 1);
+        link.outputRegisters = ep.numAnalogOutputs * (wide ? 2 : 1);
+        link.inputOffset = layout_.inputs;
+        link.outputOffset = layout_.outputs;
+        link.inputRegisterOffset = layout_.inputRegisters;
+        link.outputRegisterOffset = layout_.outputRegisters;
+        layout_.inputs += link.inputs;
+        layout_.outputs += link.outputs;
+        layout_.inputRegisters += link.inputRegisters;
+        layout_.outputRegisters += link.outputRegisters;
+        link.firstInput = ep.firstInput >= 0 ? ep.firstInput : nextInput;
+        link.firstOutput = ep.firstOutput >= 0 ? ep.firstOutput : nextOutput;
+        link.firstAnalogInput = ep.firstAnalogInput >= 0 ? ep.firstAnalogInput : nextAnalogInput;
+        link.firstAnalogOutput = ep.firstAnalogOutput >= 0 ? ep.firstAnalogOutput : nextAnalogOutput;
+        nextInput = link.firstInput + ep.numInputs;
+        nextOutput = link.firstOutput + ep.numOutputs;
+        nextAnalogInput = link.firstAnalogInput + ep.numAnalogInputs;
+        nextAnalogOutput = link.firstAnalogOutput + ep.numAnalogOutputs;
+        links_.push_back(std::move(link));
     }
+    // Sized once here, so neither thread allocates while exchanging images
+    inputs_.forEachSlot([&](InputImage& image) {
+        image.bits.assign(layout_.inputs, 0);
+        image.registers.assign(layout_.inputRegisters, 0);
+        image.bitsValid.assign(links_.size(), 0);
+        image.registersValid.assign(links_.size(), 0);
+        image.seq = 0;
+    });
+    outputs_.forEachSlot([&](OutputImage& image) {
+        image.bits.assign(layout_.outputs, 0);
+        image.registers.assign(layout_.outputRegisters, 0);
+        image.inputBits.assign(layout_.server ? layout_.inputs : 0, 0);
+        image.inputRegisters.assign(layout_.server ? layout_.inputRegisters : 0, 0);
+        image.applied = 0;
+    });
+    applied_ = 0;
+    resolve_();
+    // Images of the previous connection must not be taken
+    inputs_.take();
+    outputs_.take();
 
-    connected_ = true;
-    lastError_ = "";
+    setError_("");
+    stop_ = false;
+    running_ = true;
+    thread_ = std::thread(&ModbusManager::run_, this);
     return true;
 }
 
 void ModbusManager::disconnect() {
-    if (ctx_) {
-        modbus_close(ctx_);
-        modbus_free(ctx_);
-        ctx_ = nullptr;
+    if (thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(stopMutex_);
+            stop_ = true;
+        }
+        stopCv_.notify_all();
+        // At most one request's response timeout
+        thread_.join();
+    }
+    for (Bus& bus : buses_) {
+        modbus_close(bus.ctx);
+        modbus_free(bus.ctx);
     }
+    buses_.clear();
+    links_.clear();
     connected_ = false;
+    running_ = false;
+    clients_ = 0;
 }
 
-void ModbusManager::sync(Simulator& sim) {
-    if (!connected_ || !ctx_) return;
-
-    // Read Discrete Inputs (Sensors) - Address 0, Read bits
-    int rc = modbus_read_input_bits(ctx_, 0, numInputs_, inputBits_.data() );
-    if (rc != -1) {
-        for (int i = 0; i < numInputs_; ++i) {
-            std::string signalName = "INPUT_" + std::to_string(i);
-            sim.setSignal(signalName, inputBits_[i] != 0);
-        }
+void ModbusManager::run_() {
+    if (layout_.server) {
+        serve_();
     } else {
-        lastError_ = std::string("Read error: ") + modbus_strerror(errno);
+        poll_();
     }
+}
 
-    // Read from Simulator and write to Coils (Actuators) - Address 0, Write bits
-    bool changed = false;
-    for (int i = 0; i < numOutputs_; ++i) {
-        std::string signalName = "OUTPUT_" + std::to_string(i);
-        uint8_t val = sim.getSignalValue(signalName) ? 1 : 0;
-        if (coilBits_[i] != val) {
-            coilBits_[i] = val;
-            changed = true;
+void ModbusManager::poll_() {
+    // Error messages name the endpoint (or bus) when there are several
+    auto report = [this](const std::string& name, const std::string& error) {
+        setError_(links_.size() > 1 ? name + ": " + error : error);
+    };
+    ResponseWait responses;
+    // A bus carries one request at a time, the next sent once it was
+    // answered and the bus's frame delay has passed
+    struct Channel {
+        int link = -1; // whose request is in flight
+        size_t turn = 0; // the bus's links take turns, from this one
+        Clock::time_point sendAt, deadline;
+        Clock::duration responseTimeout{};
+        uint16_t tid = 0; // of the last request, TCP
+        bool lost = false; // unreachable or hung up, polled no more
+    };
+    std::vector<Channel> channels(buses_.size());
+    // A bus that cannot be opened is reported and left out; the others
+    // are polled all the same
+    for (size_t b = 0; b < buses_.size(); ++b) {
+        const Bus& bus = buses_[b];
+        Channel& ch = channels[b];
+        if (modbus_connect(bus.ctx) == -1) {
+            report(bus.name, std::string("Connection failed: ") + modbus_strerror(errno));
+            ch.lost = true;
+        } else if (bus.rs485 && modbus_rtu_set_serial_mode(bus.ctx, MODBUS_RTU_RS485) == -1) {
+            // Drives the transceiver's direction through RTS
+            report(bus.name, std::string("RS-485 mode failed: ") + modbus_strerror(errno));
+            ch.lost = true;
+        }
+        if (ch.lost) {
+            responses.add(-1); // never armed
+            continue;
         }
+        int fd = modbus_get_socket(bus.ctx);
+#ifdef _WIN32
+        if (bus.rtu) fd = -1; // a HANDLE, not a socket
+#endif
+        responses.add(fd);
+        uint32_t sec = 0, usec = 0;
+        modbus_get_response_timeout(bus.ctx, &sec, &usec);
+        ch.responseTimeout = std::chrono::seconds(sec) + std::chrono::microseconds(usec);
+    }
+    if (std::all_of(channels.begin(), channels.end(), [](const Channel& ch) { return ch.lost; })) {
+        running_ = false;
+        return;
     }
+    connected_ = true;
 
-    if (changed) {
-        rc = modbus_write_bits(ctx_, 0, numOutputs_, coilBits_.data());
-        if (rc == -1) {
-            lastError_ = std::string("Write error: ") + modbus_strerror(errno);
-        }
+    // Every link polls on its own schedule, a cycle of requests each poll
+    // period. The buses wait for their responses together, so a slow
+    // device delays only its own values (and those of its serial line)
+    struct Exchange {
+        std::vector<Request> requests;
+        size_t next = 0;
+        Clock::time_point cycleAt;
+        // Whether `written` holds what the device has; if not (at first and
+        // after a failed write) the whole block is written
+        bool bitsWritten = false, registersWritten = false;
+    };
+    std::vector<Exchange> exchanges(links_.size());
+    for (Exchange& ex : exchanges) {
+        ex.requests.reserve(8);
+        ex.cycleAt = Clock::now();
     }
+    // The newest values of all links, copied into the triple buffers' slots
+    InputImage current;
+    current.bits.assign(layout_.inputs, 0);
+    current.registers.assign(layout_.inputRegisters, 0);
+    current.bitsValid.assign(links_.size(), 0);
+    current.registersValid.assign(links_.size(), 0);
+    OutputImage latest, written;
+    bool haveOutputs = false;
+    written.bits.assign(layout_.outputs, 0);
+    written.registers.assign(layout_.outputRegisters, 0);
+    std::vector<uint8_t> raw(MODBUS_MAX_ADU_LENGTH), rsp(MODBUS_MAX_ADU_LENGTH);
+    std::vector<int> ready, lost;
+    ready.reserve(buses_.size());
+    lost.reserve(buses_.size());
 
-    // Read Input Registers for analog inputs (AINPUT_N signals)
-    if (numAnalogInputs_ > 0) {
-        if (analogRegisterMode_ == AnalogRegisterMode::BITS_32) {
-            // 32-bit mode: 2 registers per analog signal
-            int numRegisters = numAnalogInputs_ * 2;
-            inputRegisters_.resize(numRegisters);
-            rc = modbus_read_input_registers(ctx_, 0, numRegisters, inputRegisters_.data());
-            if (rc != -1) {
-                for (int i = 0; i < numAnalogInputs_; ++i) {
-                    std::string signalName = "AINPUT_" + std::to_string(i);
-                    // Combine 2 x 16-bit registers into 1 x 32-bit value (big-endian)
-                    uint32_t val = (static_cast<uint32_t>(inputRegisters_[i * 2]) << 16) | 
-                                   static_cast<uint32_t>(inputRegisters_[i * 2 + 1]);
-                    sim.setAnalogSignal(signalName, static_cast<uint64_t>(val));
-                }
-            }
+    // Read Discrete Inputs (sensors) and Input Registers, address 0; write
+    // Coils (actuators) and Holding Registers: one request over the changed
+    // range, a single-coil/-register request for one value
+    auto plan = [&](size_t l) {
+        const Link& link = links_[l];
+        Exchange& ex = exchanges[l];
+        ex.requests.clear();
+        ex.next = 0;
+        current.bitsValid[l] = link.inputs > 0;
+        current.registersValid[l] = link.inputRegisters > 0;
+        addRequests(ex.requests, kReadInputBits, 0, link.inputs, kMaxReadBits);
+        addRequests(ex.requests, kReadInputRegisters, 0, link.inputRegisters, kMaxReadRegisters);
+        if (!haveOutputs) return;
+        auto [first, last] = ex.bitsWritten
+            ? changedSpan(latest.bits.data() + link.outputOffset, written.bits.data() + link.outputOffset, link.outputs)
+            : std::pair(0, link.outputs);
+        if (last - first == 1) {
+            ex.requests.push_back({kWriteBit, first, 1});
         } else {
-            // 16-bit mode: 1 register per analog signal
-            inputRegisters_.resize(numAnalogInputs_);
-            rc = modbus_read_input_registers(ctx_, 0, numAnalogInputs_, inputRegisters_.data());
-            if (rc != -1) {
-                for (int i = 0; i < numAnalogInputs_; ++i) {
-                    std::string signalName = "AINPUT_" + std::to_string(i);
-                    sim.setAnalogSignal(signalName, static_cast<uint64_t>(inputRegisters_[i]));
-                }
+            addRequests(ex.requests, kWriteBits, first, last, kMaxWriteBits);
+        }
+        std::tie(first, last) = ex.registersWritten
+            ? changedSpan(latest.registers.data() + link.outputRegisterOffset,
+                          written.registers.data() + link.outputRegisterOffset, link.outputRegisters)
+            : std::pair(0, link.outputRegisters);
+        if (last - first == 1) {
+            ex.requests.push_back({kWriteRegister, first, 1});
+        } else {
+            addRequests(ex.requests, kWriteRegisters, first, last, kMaxWriteRegisters);
+        }
+        // Cleared again if a write fails
+        ex.bitsWritten = ex.registersWritten = true;
+    };
+    // What a write sends is what the device holds once it succeeded
+    auto sent = [&](const Link& link, const Request& req) {
+        if (req.function == kWriteBit || req.function == kWriteBits) {
+            auto from = latest.bits.begin() + link.outputOffset + req.address;
+            std::copy(from, from + req.count, written.bits.begin() + link.outputOffset + req.address);
+        } else if (req.function == kWriteRegister || req.function == kWriteRegisters) {
+            auto from = latest.registers.begin() + link.outputRegisterOffset + req.address;
+            std::copy(from, from + req.count, written.registers.begin() + link.outputRegisterOffset + req.address);
+        }
+    };
+    // A failed request leaves its values invalid or unwritten
+    auto failed = [&](size_t l, const Request& req) {
+        switch (req.function) {
+        case kReadInputBits: current.bitsValid[l] = false; break;
+        case kReadInputRegisters: current.registersValid[l] = false; break;
+        case kWriteBit: case kWriteBits: exchanges[l].bitsWritten = false; break;
+        default: exchanges[l].registersWritten = false; break;
+        }
+    };
+    // Done with the request in flight (or that could not be sent); true
+    // when that completed the link's cycle
+    auto finish = [&](size_t l, bool ok, const std::string& error) {
+        const Link& link = links_[l];
+        Exchange& ex = exchanges[l];
+        Channel& ch = channels[link.bus];
+        const Request& req = ex.requests[ex.next++];
+        ch.link = -1;
+        ch.sendAt = Clock::now() + std::chrono::microseconds(buses_[link.bus].frameDelayUs);
+        if (!ok) {
+            report(link.name, errorPrefix(req.function) + error);
+            failed(l, req);
+        }
+        return ex.next == ex.requests.size();
+    };
+    // The device closed the connection or the serial port went away; the
+    // inputs of its links stay invalid until the next connect()
+    auto drop = [&](size_t b) {
+        channels[b].lost = true;
+        channels[b].link = -1;
+        for (int l : buses_[b].links) {
+            exchanges[l].requests.clear();
+            exchanges[l].next = 0;
+            current.bitsValid[l] = current.registersValid[l] = false;
+        }
+        report(buses_[b].name, "Connection lost");
+    };
+    // The next link of bus `b` with a request to send, in turn; -1 if none
+    auto nextLink = [&](size_t b) {
+        const std::vector<int>& candidates = buses_[b].links;
+        Channel& ch = channels[b];
+        for (size_t k = 0; k < candidates.size(); ++k) {
+            size_t i = (ch.turn + k) % candidates.size();
+            const Exchange& ex = exchanges[candidates[i]];
+            if (ex.next < ex.requests.size()) {
+                ch.turn = i + 1;
+                return candidates[i];
             }
         }
-        if (rc == -1) {
-            lastError_ = std::string("Analog read error: ") + modbus_strerror(errno);
-        }
-    }
-
-    // Write Holding Registers for analog outputs (AOUTPUT_N signals)
-    if (numAnalogOutputs_ > 0) {
-        bool analogChanged = false;
-        
-        if (analogRegisterMode_ == AnalogRegisterMode::BITS_32) {
-            // 32-bit mode: 2 registers per analog signal
-            int numRegisters = numAnalogOutputs_ * 2;
-            holdingRegisters_.resize(numRegisters);
-            
-            for (int i = 0; i < numAnalogOutputs_; ++i) {
-                std::string signalName = "AOUTPUT_" + std::to_string(i);
-                uint64_t val64 = sim.getAnalogSignalValue(signalName);
-                uint32_t val = static_cast<uint32_t>(val64 & 0xFFFFFFFF);
-                
-                // Split 32-bit value into 2 x 16-bit registers (big-endian)
-                uint16_t r0 = static_cast<uint16_t>((val >> 16) & 0xFFFF);
-                uint16_t r1 = static_cast<uint16_t>(val & 0xFFFF);
-                
-                if (holdingRegisters_[i * 2] != r0 || holdingRegisters_[i * 2 + 1] != r1) {
-                    holdingRegisters_[i * 2] = r0;
-                    holdingRegisters_[i * 2 + 1] = r1;
-                    analogChanged = true;
+        return -1;
+    };
+
+    bool completed = false; // publish `current`
+    while (!stop_) {
+        if (outputs_.take()) {
+            latest.bits = outputs_.front().bits;
+            latest.registers = outputs_.front().registers;
+            haveOutputs = true;
+        }
+
+        bool inFlight = false;
+        auto now = Clock::now();
+        auto wakeAt = Clock::time_point::max();
+        for (size_t b = 0; b < buses_.size(); ++b) {
+            const Bus& bus = buses_[b];
+            Channel& ch = channels[b];
+            if (ch.lost) continue;
+            if (ch.link != -1 && now >= ch.deadline) {
+                // Presumably unreachable; the rest of its requests would time
+                // out as well
+                int l = ch.link;
+                Exchange& ex = exchanges[l];
+                responses.disarm(static_cast<int>(b));
+                // A TCP stream stays framed, a late response is told apart
+                // by its transaction id; a serial line is cleared
+                if (bus.rtu) modbus_flush(bus.ctx);
+                finish(l, false, modbus_strerror(ETIMEDOUT));
+                for (; ex.next < ex.requests.size(); ++ex.next) {
+                    failed(l, ex.requests[ex.next]);
                 }
+                completed = true;
             }
-            
-            if (analogChanged) {
-                rc = modbus_write_registers(ctx_, 0, numRegisters, holdingRegisters_.data());
-                if (rc == -1) {
-                    lastError_ = std::string("Analog write error: ") + modbus_strerror(errno);
+            for (int l : bus.links) {
+                Exchange& ex = exchanges[l];
+                if (ex.next == ex.requests.size() && now >= ex.cycleAt) {
+                    // Fixed rate; after a slow cycle the next one starts right away
+                    ex.cycleAt = std::max(ex.cycleAt + std::chrono::milliseconds(layout_.pollPeriodMs), now);
+                    plan(l);
                 }
             }
-        } else {
-            // 16-bit mode: 1 register per analog signal
-            holdingRegisters_.resize(numAnalogOutputs_);
-            
-            for (int i = 0; i < numAnalogOutputs_; ++i) {
-                std::string signalName = "AOUTPUT_" + std::to_string(i);
-                uint16_t val = static_cast<uint16_t>(sim.getAnalogSignalValue(signalName) & 0xFFFF);
-                if (holdingRegisters_[i] != val) {
-                    holdingRegisters_[i] = val;
-                    analogChanged = true;
+            while (ch.link == -1 && now >= ch.sendAt) {
+                int l = nextLink(b);
+                if (l == -1) break;
+                const Link& link = links_[l];
+                const Request& req = exchanges[l].requests[exchanges[l].next];
+                int length = buildRequest(raw.data() + kMbapLength, link.slaveId, req,
+                                          latest.bits.data() + link.outputOffset,
+                                          latest.registers.data() + link.outputRegisterOffset);
+                bool ok;
+                if (bus.rtu) {
+                    // The unit whose response libmodbus accepts
+                    modbus_set_slave(bus.ctx, link.slaveId);
+                    ok = modbus_send_raw_request(bus.ctx, raw.data() + kMbapLength, length) != -1;
+                } else {
+                    ok = sendTcpRequest(modbus_get_socket(bus.ctx), ++ch.tid, raw.data(), length);
+                }
+                if (!ok) {
+                    completed |= finish(l, false, modbus_strerror(errno));
+                    continue;
                 }
+                sent(link, req);
+                ch.link = l;
+                ch.deadline = now + ch.responseTimeout;
+                responses.arm(static_cast<int>(b));
+            }
+            if (ch.link != -1) {
+                wakeAt = std::min(wakeAt, ch.deadline);
+                inFlight = true;
+            }
+            for (int l : bus.links) {
+                const Exchange& ex = exchanges[l];
+                if (ex.next == ex.requests.size()) {
+                    wakeAt = std::min(wakeAt, ex.cycleAt);
+                } else if (ch.link == -1) {
+                    wakeAt = std::min(wakeAt, ch.sendAt);
+                }
+            }
+        }
+        if (completed) {
+            InputImage& in = inputs_.back();
+            in.bits = current.bits;
+            in.registers = current.registers;
+            in.bitsValid = current.bitsValid;
+            in.registersValid = current.registersValid;
+            inputs_.publish();
+            completed = false;
+        }
+        if (std::all_of(channels.begin(), channels.end(), [](const Channel& ch) { return ch.lost; })) {
+            // Nothing left to poll
+            running_ = false;
+            break;
+        }
+
+        if (!inFlight) {
+            // Nothing to wait for but time; disconnect() ends this early
+            std::unique_lock<std::mutex> lock(stopMutex_);
+            stopCv_.wait_until(lock, wakeAt, [this] { return stop_.load(); });
+            continue;
+        }
+        auto wait = std::chrono::ceil<std::chrono::milliseconds>(wakeAt - now).count();
+        ready.clear();
+        lost.clear();
+        responses.wait(static_cast<int>(std::max<int64_t>(wait, 0)), ready, lost);
+        for (int b : lost) {
+            drop(b);
+            completed = true;
+        }
+        for (int b : ready) {
+            const Bus& bus = buses_[b];
+            int l = channels[b].link;
+            if (l == -1) continue;
+            const Link& link = links_[l];
+            const Request& req = exchanges[l].requests[exchanges[l].next];
+            int headerLength = modbus_get_header_length(bus.ctx);
+            int rc = modbus_receive_confirmation(bus.ctx, rsp.data());
+            if (rc != -1 && !isAnswer(rsp.data(), rc, headerLength, bus.rtu, channels[b].tid, link.slaveId, req)) {
+                // Late, for a request that timed out; wait on for the answer
+                responses.arm(b);
+                continue;
+            }
+            std::string error = rc == -1 ? modbus_strerror(errno) : "";
+            bool ok = rc != -1 && parseResponse(rsp.data(), rc, headerLength, req, current.bits.data() + link.inputOffset,
+                                                current.registers.data() + link.inputRegisterOffset, error);
+            completed |= finish(l, ok, error);
+        }
+    }
+    connected_ = false;
+}
+
+// A Modbus TCP request arrives in one or a few segments; the gaps between
+// them are far below this on any network the server is used on
+static constexpr uint32_t kServerByteTimeoutUs = 20000;
+// How long the server waits for requests before looking at stop_ again;
+// disconnect() runs on the render thread and waits that long at most
+static constexpr int kServerWakeMs = 20;
+
+static bool isWriteRequest(int function) {
+    return function == 0x05 || function == 0x06 || function == 0x0F || function == 0x10 || function == 0x16 ||
+           function == 0x17;
+}
+
+void ModbusManager::serve_() {
+    modbus_t* ctx = buses_[0].ctx;
+    int listenFd = modbus_tcp_listen(ctx, 16);
+    // Coils = IN, discrete inputs = OUT, holding registers = AIN, input
+    // registers = AOUT
+    modbus_mapping_t* map = listenFd == -1 ? nullptr
+        : modbus_mapping_new(layout_.inputs, layout_.outputs, layout_.inputRegisters, layout_.outputRegisters);
+    if (!map) {
+        setError_(std::string("Listen failed: ") + modbus_strerror(errno));
+        if (listenFd != -1) closeSocket(listenFd);
+        running_ = false;
+        return;
+    }
+    connected_ = true;
+    // modbus_receive() holds up this loop, and with it every other client
+    // and disconnect(), until a request is complete. A client that stops
+    // mid-frame gets this long per byte and is then dropped (rc == -1)
+    modbus_set_byte_timeout(ctx, 0, kServerByteTimeoutUs);
+
+    std::vector<int> clients;
+    std::vector<uint8_t> query(MODBUS_TCP_MAX_ADU_LENGTH);
+    int headerLength = modbus_get_header_length(ctx);
+    uint64_t seq = 0; // last client write handed to the simulator
+    while (!stop_) {
+        // Wait for requests, briefly so that disconnect() is noticed
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(listenFd, &readable);
+        int maxFd = listenFd;
+        for (int fd : clients) {
+            FD_SET(fd, &readable);
+            maxFd = std::max(maxFd, fd);
+        }
+        timeval timeout{0, kServerWakeMs * 1000};
+        if (select(maxFd + 1, &readable, nullptr, nullptr, &timeout) <= 0) continue;
+
+        // Serve the newest simulator state; the inputs only once the
+        // simulator has seen the last client write, so a client does not
+        // read back its old value
+        if (outputs_.take()) {
+            const OutputImage& out = outputs_.front();
+            std::copy(out.bits.begin(), out.bits.end(), map->tab_input_bits);
+            std::copy(out.registers.begin(), out.registers.end(), map->tab_input_registers);
+            if (out.applied >= seq) {
+                std::copy(out.inputBits.begin(), out.inputBits.end(), map->tab_bits);
+                std::copy(out.inputRegisters.begin(), out.inputRegisters.end(), map->tab_registers);
             }
-            
-            if (analogChanged) {
-                rc = modbus_write_registers(ctx_, 0, numAnalogOutputs_, holdingRegisters_.data());
-                if (rc == -1) {
-                    lastError_ = std::string("Analog write error: ") + modbus_strerror(errno);
+        }
+
+        if (FD_ISSET(listenFd, &readable)) {
+            int fd = modbus_tcp_accept(ctx, &listenFd);
+            // The listening socket plus the clients
+            if (fd != -1 && fitsSelect(fd, clients.size() + 2)) {
+                clients.push_back(fd);
+            } else if (fd != -1) {
+                closeSocket(fd);
+            }
+        }
+        for (size_t i = 0; i < clients.size();) {
+            int fd = clients[i];
+            if (!FD_ISSET(fd, &readable)) {
+                ++i;
+                continue;
+            }
+            modbus_set_socket(ctx, fd);
+            int rc = modbus_receive(ctx, query.data());
+            if (rc > 0) {
+                modbus_reply(ctx, query.data(), rc, map);
+                if (isWriteRequest(query[headerLength])) {
+                    InputImage& in = inputs_.back();
+                    std::copy(map->tab_bits, map->tab_bits + layout_.inputs, in.bits.begin());
+                    std::copy(map->tab_registers, map->tab_registers + layout_.inputRegisters, in.registers.begin());
+                    in.bitsValid[0] = in.registersValid[0] = true;
+                    in.seq = ++seq;
+                    inputs_.publish();
                 }
+            } else if (rc == -1) {
+                // Closed by the client, a broken request or a stalled one
+                closeSocket(fd);
+                clients.erase(clients.begin() + i);
+                continue;
             }
+            ++i;
         }
+        clients_ = static_cast<int>(clients.size());
+    }
+
+    for (int fd : clients) {
+        closeSocket(fd);
     }
+    closeSocket(listenFd);
+    // ctx still refers to one of the sockets closed above
+    modbus_set_socket(ctx, -1);
+    modbus_mapping_free(map);
+    connected_ = false;
 }
 
+void ModbusManager::bind(const Program& prog) {
+    prog_ = &prog;
+    resolve_();
+}
 
+void ModbusManager::resolve_() {
+    inputIds_.assign(layout_.inputs, -1);
+    outputIds_.assign(layout_.outputs, -1);
+    analogInputIds_.assign(numSignals(layout_.inputRegisters, layout_.wide), -1);
+    analogOutputIds_.assign(numSignals(layout_.outputRegisters, layout_.wide), -1);
+    if (!prog_) return;
+    auto find = [this](std::vector<int>& ids, size_t i, const std::string& name) {
+        auto it = prog_->symbolToSignal.find(name);
+        if (it != prog_->symbolToSignal.end()) ids[i] = it->second;
+    };
+    if (!layout_.server) {
+        // Each link's block is numbered from its first index
+        auto lookup = [&](std::vector<int>& ids, int offset, const char* prefix, int first, int count) {
+            for (int i = 0; i < count; ++i) {
+                find(ids, offset + i, prefix + std::to_string(first + i));
+            }
+        };
+        for (const Link& link : links_) {
+            lookup(inputIds_, link.inputOffset, "INPUT_", link.firstInput, link.inputs);
+            lookup(outputIds_, link.outputOffset, "OUTPUT_", link.firstOutput, link.outputs);
+            lookup(analogInputIds_, numSignals(link.inputRegisterOffset, layout_.wide), "AINPUT_",
+                   link.firstAnalogInput, numSignals(link.inputRegisters, layout_.wide));
+            lookup(analogOutputIds_, numSignals(link.outputRegisterOffset, layout_.wide), "AOUTPUT_",
+                   link.firstAnalogOutput, numSignals(link.outputRegisters, layout_.wide));
+        }
+        return;
+    }
+    // The server exposes the declared signals in order
+    auto declared = [&](std::vector<int>& ids, const std::vector<std::string>& names) {
+        for (size_t i = 0; i < std::min(ids.size(), names.size()); ++i) {
+            find(ids, i, names[i]);
+        }
+    };
+    declared(inputIds_, prog_->inputNames);
+    declared(outputIds_, prog_->outputNames);
+    declared(analogInputIds_, prog_->analogInputNames);
+    declared(analogOutputIds_, prog_->analogOutputNames);
+}
+
+void ModbusManager::sync(Simulator& sim) {
+    if (!connected_) return;
+
+    if (inputs_.take()) {
+        const InputImage& in = inputs_.front();
+        applied_ = in.seq;
+        for (size_t l = 0; l < links_.size(); ++l) {
+            const Link& link = links_[l];
+            if (in.bitsValid[l]) {
+                for (int i = link.inputOffset; i < link.inputOffset + link.inputs; ++i) {
+                    sim.setSignalById(inputIds_[i], in.bits[i] != 0);
+                }
+            }
+            if (in.registersValid[l]) {
+                int first = numSignals(link.inputRegisterOffset, layout_.wide);
+                for (int i = first; i < first + numSignals(link.inputRegisters, layout_.wide); ++i) {
+                    uint64_t val = in.registers[i];
+                    if (layout_.wide) {
+                        // Combine 2 x 16-bit registers into 1 x 32-bit value (big-endian)
+                        val = (static_cast<uint32_t>(in.registers[i * 2]) << 16) |
+                              static_cast<uint32_t>(in.registers[i * 2 + 1]);
+                    }
+                    sim.setSignalById(analogInputIds_[i], val);
+                }
+            }
+        }
+    }
+
+    auto toRegisters = [this](uint64_t val, uint16_t* registers, size_t i) {
+        if (layout_.wide) {
+            // Split 32-bit value into 2 x 16-bit registers (big-endian)
+            registers[i * 2] = static_cast<uint16_t>((val >> 16) & 0xFFFF);
+            registers[i * 2 + 1] = static_cast<uint16_t>(val & 0xFFFF);
+        } else {
+            registers[i] = static_cast<uint16_t>(val & 0xFFFF);
+        }
+    };
+    OutputImage& out = outputs_.back();
+    for (size_t i = 0; i < outputIds_.size(); ++i) {
+        out.bits[i] = sim.getSignalValueById(outputIds_[i]) != 0 ? 1 : 0;
+    }
+    for (size_t i = 0; i < analogOutputIds_.size(); ++i) {
+        toRegisters(sim.getSignalValueById(analogOutputIds_[i]), out.registers.data(), i);
+    }
+    if (layout_.server) {
+        for (size_t i = 0; i < inputIds_.size(); ++i) {
+            out.inputBits[i] = sim.getSignalValueById(inputIds_[i]) != 0 ? 1 : 0;
+        }
+        for (size_t i = 0; i < analogInputIds_.size(); ++i) {
+            toRegisters(sim.getSignalValueById(analogInputIds_[i]), out.inputRegisters.data(), i);
+        }
+        out.applied = applied_;
+    }
+    outputs_.publish();
+}
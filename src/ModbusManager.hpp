@@ -5,43 +5,137 @@
 #include <mutex>
 #include <thread>
 #include <atomic>
+#include <condition_variable>
 #include "Sim.hpp"
+#include "TripleBuffer.hpp"
 
+// Modbus TCP/RTU client or TCP server. All device I/O runs on an I/O thread
+// that trades process images (inputs, outputs) with the render thread
+// through lock-free triple buffers, so a slow or unresponsive peer never
+// stalls rendering or the simulation.
+//
+// Client: polls one or more endpoints (devices) every poll period, reading
+// discrete inputs and input registers into INPUT_N/AINPUT_N and writing
+// OUTPUT_N/AOUTPUT_N to their coils and holding registers. Over TCP or a
+// serial line (RTU); only outputs that changed are written, as the smallest
+// request covering them. The endpoints are served concurrently from one
+// event loop: each TCP endpoint has one request in flight at a time, all
+// of them wait for their responses together. RTU endpoints on the same
+// serial device are units on one bus and take turns on it.
+// Server: listens on ip:port of the first endpoint and serves any number of
+// clients from one select() loop. The declared IN signals are coils and the
+// AIN signals holding registers (clients write them), OUT signals are
+// discrete inputs and AOUT signals input registers, each in declaration
+// order from address 0.
 class ModbusManager {
 public:
     ModbusManager();
     ~ModbusManager();
 
-    // Connection settings
-    void setIp(const std::string& ip) { ip_ = ip; }
-    void setPort(int port) { port_ = port; }
-    void setSlaveId(int id) { slaveId_ = id; }
+    enum class Mode {
+        Client,
+        Server
+    };
+
+    enum class Transport {
+        Tcp,
+        Rtu
+    };
+
+    // One device (or, in server mode, the address to listen on) and the
+    // signals mapped to it. Parity is 'N', 'E' or 'O'; the frame delay is
+    // the silence kept between two requests, 0 for the 3.5 character times
+    // of the standard (1750 us above 19200 baud).
+    struct Endpoint {
+        Transport transport = Transport::Tcp;
+        std::string ip = "127.0.0.1";
+        int port = 502;
+        int slaveId = 1;
+
+        std::string serialDevice = "/dev/ttyUSB0";
+        int baudRate = 19200;
+        char parity = 'E';
+        int dataBits = 8;
+        int stopBits = 1;
+        int frameDelayUs = 0;
+        bool rs485 = false;
+
+        int numInputs = 8;
+        int numOutputs = 8;
+        int numAnalogInputs = 0;
+        int numAnalogOutputs = 0;
+        // First INPUT_N/OUTPUT_N/AINPUT_N/AOUTPUT_N mapped to address 0;
+        // -1 continues the numbering after the previous endpoint
+        int firstInput = -1, firstOutput = -1, firstAnalogInput = -1, firstAnalogOutput = -1;
+    };
 
-    const std::string& getIp() const { return ip_; }
-    int getPort() const { return port_; }
-    int getSlaveId() const { return slaveId_; }
+    // All endpoints, at least one. The setters below edit the first one;
+    // further endpoints come from modbus_config.txt
+    const std::vector<Endpoint>& getEndpoints() const { return endpoints_; }
 
+    // Connection settings; in server mode ip is the address to listen on
+    void setMode(Mode mode) { mode_ = mode; }
+    Mode getMode() const { return mode_; }
+    void setTransport(Transport transport) { endpoints_[0].transport = transport; }
+    Transport getTransport() const { return endpoints_[0].transport; }
+    void setIp(const std::string& ip) { endpoints_[0].ip = ip; }
+    void setPort(int port) { endpoints_[0].port = port; }
+    void setSlaveId(int id) { endpoints_[0].slaveId = id; }
+    void setPollPeriodMs(int ms);
+
+    const std::string& getIp() const { return endpoints_[0].ip; }
+    int getPort() const { return endpoints_[0].port; }
+    int getSlaveId() const { return endpoints_[0].slaveId; }
+    int getPollPeriodMs() const { return pollPeriodMs_; }
+
+    // Serial line settings for RTU
+    void setSerialDevice(const std::string& device) { endpoints_[0].serialDevice = device; }
+    void setBaudRate(int baud);
+    void setParity(char parity);
+    void setDataBits(int bits) { endpoints_[0].dataBits = bits == 7 ? 7 : 8; }
+    void setStopBits(int bits) { endpoints_[0].stopBits = bits == 2 ? 2 : 1; }
+    void setFrameDelayUs(int us);
+    void setRs485(bool rs485) { endpoints_[0].rs485 = rs485; }
+
+    const std::string& getSerialDevice() const { return endpoints_[0].serialDevice; }
+    int getBaudRate() const { return endpoints_[0].baudRate; }
+    char getParity() const { return endpoints_[0].parity; }
+    int getDataBits() const { return endpoints_[0].dataBits; }
+    int getStopBits() const { return endpoints_[0].stopBits; }
+    int getFrameDelayUs() const { return endpoints_[0].frameDelayUs; }
+    bool getRs485() const { return endpoints_[0].rs485; }
+
+    // Starts the I/O thread, which connects (or starts listening) in the
+    // background; settings changed afterwards apply from the next connect()
     bool connect();
     void disconnect();
+    // Connected to at least one endpoint (the others report errors), or
+    // listening in server mode
     bool isConnected() const { return connected_; }
-    const std::string& getLastError() const { return lastError_; }
+    bool isConnecting() const { return running_ && !connected_; }
+    int getClientCount() const { return clients_; }
+    std::string getLastError() const;
+
+    // Look the mapped signals of `prog` up once; call on load and after
+    // every hot reload, before the next sync()
+    void bind(const Program& prog);
 
-    // Synchronize simulator with Modbus
-    // Reads inputs from Modbus and sets them in Simulator
-    // Reads outputs from Simulator and writes them to Modbus Coils
+    // Synchronize simulator with Modbus, on the render thread. Never blocks:
+    // applies the newest inputs from the I/O thread and hands it the current
+    // outputs.
     void sync(Simulator& sim);
 
     // Helpers for digital I/O
     void setNumInputs(int n);
     void setNumOutputs(int n);
-    int getNumInputs() const { return numInputs_; }
-    int getNumOutputs() const { return numOutputs_; }
-    
+    int getNumInputs() const { return endpoints_[0].numInputs; }
+    int getNumOutputs() const { return endpoints_[0].numOutputs; }
+
     // Helpers for analog I/O (registers)
     void setNumAnalogInputs(int n);
     void setNumAnalogOutputs(int n);
-    int getNumAnalogInputs() const { return numAnalogInputs_; }
-    int getNumAnalogOutputs() const { return numAnalogOutputs_; }
+    int getNumAnalogInputs() const { return endpoints_[0].numAnalogInputs; }
+    int getNumAnalogOutputs() const { return endpoints_[0].numAnalogOutputs; }
 
     enum class AnalogRegisterMode {
         BITS_16,
@@ -54,26 +148,88 @@ public:
     void saveConfig();
 
 private:
-    std::string ip_ = "127.0.0.1";
-    int port_ = 502;
-    int slaveId_ = 1;
+    Mode mode_ = Mode::Client;
+    std::vector<Endpoint> endpoints_{1};
+    int pollPeriodMs_ = 10;
+    AnalogRegisterMode analogRegisterMode_ = AnalogRegisterMode::BITS_16;
 
-    modbus_t* ctx_ = nullptr;
     std::atomic<bool> connected_{false};
+    std::atomic<bool> running_{false};
+    std::atomic<int> clients_{0};
+    mutable std::mutex errorMutex_;
     std::string lastError_;
-    
-    // Buffers for digital I/O (bits)
-    int numInputs_ = 8;
-    int numOutputs_ = 8;
-    std::vector<uint8_t> inputBits_;
-    std::vector<uint8_t> coilBits_;
-
-    // Buffer for analog I/O
-    int numAnalogInputs_ = 0;
-    int numAnalogOutputs_ = 0;
-    std::vector<uint16_t> inputRegisters_;
-    std::vector<uint16_t> holdingRegisters_;
-    AnalogRegisterMode analogRegisterMode_ = AnalogRegisterMode::BITS_16;
-};
+    void setError_(const std::string& error);
 
+    // A connection of the running I/O thread, carrying one request at a
+    // time: a TCP connection per endpoint, one serial line shared by the
+    // RTU endpoints on the same device (whose first one sets it up)
+    struct Bus {
+        modbus_t* ctx = nullptr;
+        std::string name; // ip:port or serial device, for messages
+        std::vector<int> links; // indices into links_
+        int frameDelayUs = 0; // silence between two requests, RTU only
+        bool rtu = false;
+        bool rs485 = false;
+    };
+    std::vector<Bus> buses_;
 
+    // An endpoint the running I/O thread was started with. Its values sit
+    // at the offsets in the process images, its signals are numbered from
+    // the first* indices (client mode)
+    struct Link {
+        int bus = 0;
+        std::string name; // ip:port or serial device and unit, for messages
+        int slaveId = 1;
+        int inputs = 0, outputs = 0;
+        int inputRegisters = 0, outputRegisters = 0; // 2 per signal in 32-bit mode
+        int inputOffset = 0, outputOffset = 0;
+        int inputRegisterOffset = 0, outputRegisterOffset = 0;
+        int firstInput = 0, firstOutput = 0, firstAnalogInput = 0, firstAnalogOutput = 0;
+    };
+    std::vector<Link> links_;
+
+    // Totals over all links and settings the running I/O thread was
+    // started with
+    struct Layout {
+        int inputs = 0, outputs = 0;
+        int inputRegisters = 0, outputRegisters = 0;
+        bool wide = false;
+        bool server = false;
+        int pollPeriodMs = 10;
+    };
+    Layout layout_;
+
+    // Signal ids per process image index, -1 where the program has no such
+    // signal; resolved by bind() and on connect() for links_
+    const Program* prog_ = nullptr;
+    std::vector<int> inputIds_, outputIds_, analogInputIds_, analogOutputIds_;
+    void resolve_();
+
+    // Process images of all links; registers are raw 16-bit words
+    struct InputImage {
+        std::vector<uint8_t> bits;
+        std::vector<uint16_t> registers;
+        std::vector<uint8_t> bitsValid, registersValid; // by link
+        uint64_t seq = 0; // server: numbers the client writes
+    };
+    struct OutputImage {
+        std::vector<uint8_t> bits;
+        std::vector<uint16_t> registers;
+        // Server: the current inputs, for clients reading them back, and
+        // the last client write already applied to them
+        std::vector<uint8_t> inputBits;
+        std::vector<uint16_t> inputRegisters;
+        uint64_t applied = 0;
+    };
+    uint64_t applied_ = 0;
+    TripleBuffer<InputImage> inputs_;   // I/O thread -> render thread
+    TripleBuffer<OutputImage> outputs_; // render thread -> I/O thread
+
+    std::thread thread_;
+    std::mutex stopMutex_;
+    std::condition_variable stopCv_;
+    std::atomic<bool> stop_{false};
+    void run_();
+    void poll_();
+    void serve_();
+};
@@ -0,0 +1,669 @@
+#include "Optimizer.hpp"
+#include "Bdd.hpp"
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+#include <regex>
+#include <unordered_set>
+#include <vector>
+
+using Node = Program::Node;
+
+namespace {
+
+// Who writes and who reads each signal, by node position (= scan order)
+struct SignalUse {
+  std::vector<std::vector<int>> drivers;
+  std::vector<std::vector<int>> readers;
+};
+
+bool hasInvertMask(Node::Type t) {
+  return t == Node::AND_ || t == Node::OR_ || t == Node::XOR_ || t == Node::SR_ || t == Node::RS_;
+}
+
+bool isCombinational(Node::Type t) {
+  return t == Node::AND_ || t == Node::OR_ || t == Node::XOR_ || t == Node::NOT_ ||
+         t == Node::LT_ || t == Node::GT_ || t == Node::EQ_;
+}
+
+template <typename Fn>
+void forEachWrittenSignal(const Node& n, Fn fn) {
+  for (int s : n.outputs) fn(s);
+  if (n.cvOutputSignal >= 0) fn(n.cvOutputSignal);
+}
+
+template <typename Fn>
+void forEachReadSignal(const Node& n, Fn fn) {
+  for (int s : n.inputs) fn(s);
+  // Latches read back their own output to hold state
+  if ((n.type == Node::SR_ || n.type == Node::RS_) && !n.outputs.empty()) fn(n.outputs[0]);
+}
+
+SignalUse collectUse(const Program& prog, size_t signalCount) {
+  SignalUse use;
+  use.drivers.resize(signalCount);
+  use.readers.resize(signalCount);
+  for (size_t i = 0; i < prog.nodes.size(); ++i) {
+    int pos = static_cast<int>(i);
+    forEachWrittenSignal(prog.nodes[i], [&](int s) { use.drivers[s].push_back(pos); });
+    forEachReadSignal(prog.nodes[i], [&](int s) {
+      if (use.readers[s].empty() || use.readers[s].back() != pos) use.readers[s].push_back(pos);
+    });
+  }
+  return use;
+}
+
+// Any entry of the sorted list strictly between lo and hi?
+bool anyBetween(const std::vector<int>& sorted, int lo, int hi) {
+  auto it = std::upper_bound(sorted.begin(), sorted.end(), lo);
+  return it != sorted.end() && *it < hi;
+}
+
+void compact(Program& prog, const std::vector<bool>& dead) {
+  size_t w = 0;
+  for (size_t r = 0; r < prog.nodes.size(); ++r) {
+    if (dead[r]) continue;
+    if (w != r) prog.nodes[w] = std::move(prog.nodes[r]);
+    w++;
+  }
+  prog.nodes.resize(w);
+}
+
+// Lookup tables are indexed by the packed input values, so 12 inputs already
+// need 4096 bits per table
+constexpr size_t kMaxTableInputs = 12;
+
+bool isGate(Node::Type t) {
+  return t == Node::AND_ || t == Node::OR_ || t == Node::XOR_ || t == Node::NOT_;
+}
+
+// Value of a cone node for one input pattern, with the same semantics as
+// Simulator::evaluateNode_. `driver` maps the cone's internal signals to the
+// node writing them, `leafBit` maps its inputs to their bit in `pattern`.
+bool evalCone(const Program& prog, int pos, const std::unordered_map<int, int>& driver,
+              const std::unordered_map<int, int>& leafBit, size_t pattern) {
+  const Node& n = prog.nodes[pos];
+  auto input = [&](size_t k) {
+    int s = n.inputs[k];
+    auto leaf = leafBit.find(s);
+    bool v = leaf != leafBit.end() ? ((pattern >> leaf->second) & 1) != 0
+                                   : evalCone(prog, driver.at(s), driver, leafBit, pattern);
+    return v != n.invertedInput(k);
+  };
+  switch (n.type) {
+  case Node::AND_:
+    for (size_t k = 0; k < n.inputs.size(); ++k) {
+      if (!input(k)) return false;
+    }
+    return true;
+  case Node::OR_:
+    for (size_t k = 0; k < n.inputs.size(); ++k) {
+      if (input(k)) return true;
+    }
+    return false;
+  case Node::XOR_: {
+    bool out = false;
+    for (size_t k = 0; k < n.inputs.size(); ++k) {
+      if (input(k)) {
+        if (out) return false;
+        out = true;
+      }
+    }
+    return out;
+  }
+  case Node::NOT_:
+    return !n.inputs.empty() && !input(0);
+  default:
+    return false;
+  }
+}
+
+// A fanout-free cone of AND/OR/XOR/NOT gates: the root plus inner gates
+// whose single output is read by exactly one later gate of the cone. The
+// cone's inputs do not change between its first gate and the root, so the
+// root's value is a pure function of the leaves sampled at the root.
+struct Cone {
+  int root;
+  std::vector<int> gates;  // root first
+  std::vector<int> leaves; // distinct input signals
+};
+
+std::vector<Cone> findCones(const Program& prog, const SignalUse& use, const std::vector<bool>& external,
+                            const std::vector<bool>& observable, size_t maxLeaves) {
+  auto absorbable = [&](int pos) {
+    const Node& n = prog.nodes[pos];
+    if (!isGate(n.type) || n.outputs.size() != 1 || n.cvOutputSignal >= 0) return false;
+    int s = n.outputs[0];
+    if (external[s] || observable[s] || use.drivers[s].size() != 1 || use.readers[s].size() != 1) return false;
+    int reader = use.readers[s][0];
+    return reader > pos && isGate(prog.nodes[reader].type);
+  };
+
+  std::vector<Cone> cones;
+  std::vector<bool> taken(prog.nodes.size(), false);
+  // Readers come after their absorbed drivers, so walking backwards grows
+  // every cone from its root before its inner gates are considered as roots
+  for (int root = static_cast<int>(prog.nodes.size()) - 1; root >= 0; --root) {
+    if (taken[root] || !isGate(prog.nodes[root].type)) continue;
+    taken[root] = true;
+
+    Cone cone{root, {root}, {}};
+    for (int s : prog.nodes[root].inputs) {
+      if (std::find(cone.leaves.begin(), cone.leaves.end(), s) == cone.leaves.end()) cone.leaves.push_back(s);
+    }
+    if (cone.leaves.size() > maxLeaves) continue;
+    int first = root;
+
+    bool grown = true;
+    while (grown) {
+      grown = false;
+      for (size_t li = 0; li < cone.leaves.size() && !grown; ++li) {
+        int s = cone.leaves[li];
+        if (use.drivers[s].size() != 1) continue;
+        int d = use.drivers[s][0];
+        if (taken[d] || !absorbable(d)) continue;
+        if (std::find(cone.gates.begin(), cone.gates.end(), use.readers[s][0]) == cone.gates.end()) continue;
+
+        std::vector<int> next = cone.leaves;
+        next.erase(next.begin() + li);
+        for (int in : prog.nodes[d].inputs) {
+          if (std::find(next.begin(), next.end(), in) == next.end()) next.push_back(in);
+        }
+        if (next.size() > maxLeaves) continue;
+        int nextFirst = std::min(first, d);
+        bool stable = true;
+        for (int in : next) {
+          if (anyBetween(use.drivers[in], nextFirst, root)) stable = false;
+        }
+        if (!stable) continue;
+
+        cone.gates.push_back(d);
+        taken[d] = true;
+        cone.leaves = std::move(next);
+        first = nextFirst;
+        grown = true;
+      }
+    }
+    cones.push_back(std::move(cone));
+  }
+  return cones;
+}
+
+// Replace every cone of at least two gates with at most kMaxTableInputs
+// leaves by one LUT_ node at the cone's root
+void compileLookupTables(Program& prog, const std::vector<bool>& external, const std::vector<bool>& observable,
+                         OptimizeStats& stats) {
+  SignalUse use = collectUse(prog, external.size());
+  std::vector<bool> dead(prog.nodes.size(), false);
+  for (Cone& cone : findCones(prog, use, external, observable, kMaxTableInputs)) {
+    if (cone.gates.size() < 2) continue;
+
+    std::unordered_map<int, int> driver, leafBit;
+    for (size_t c = 1; c < cone.gates.size(); ++c) driver[prog.nodes[cone.gates[c]].outputs[0]] = cone.gates[c];
+    for (size_t b = 0; b < cone.leaves.size(); ++b) leafBit[cone.leaves[b]] = static_cast<int>(b);
+    size_t patterns = size_t{1} << cone.leaves.size();
+    std::vector<uint64_t> table((patterns + 63) / 64, 0);
+    for (size_t p = 0; p < patterns; ++p) {
+      if (evalCone(prog, cone.root, driver, leafBit, p)) table[p >> 6] |= uint64_t{1} << (p & 63);
+    }
+
+    std::vector<int> lines;
+    for (int c : cone.gates) lines.push_back(prog.nodes[c].sourceLine);
+    std::sort(lines.begin(), lines.end());
+    lines.erase(std::unique(lines.begin(), lines.end()), lines.end());
+
+    Node& n = prog.nodes[cone.root];
+    n.type = Node::LUT_;
+    n.inputs = std::move(cone.leaves);
+    n.invertMask = 0;
+    n.lookupTable = std::move(table);
+    n.coveredLines = std::move(lines);
+    for (size_t c = 1; c < cone.gates.size(); ++c) dead[cone.gates[c]] = true;
+    stats.tables++;
+  }
+  compact(prog, dead);
+}
+
+// Cones with more leaves are left alone by the BDD stage; the diagrams of
+// typical interlock logic stay small, but the two-level covers do not
+constexpr size_t kMaxBddInputs = 24;
+
+size_t countGates(const Program& prog) {
+  size_t count = 0;
+  for (const Node& n : prog.nodes) {
+    if (isGate(n.type)) count++;
+  }
+  return count;
+}
+
+// BDD of a cone node over the cone's leaf signals; the variable of a leaf is
+// its signal id, so cones over the same signals share one variable order
+BddManager::Ref coneBdd(BddManager& bdd, const Program& prog, int pos, const std::unordered_map<int, int>& driver,
+                        std::unordered_map<int, BddManager::Ref>& memo) {
+  auto done = memo.find(pos);
+  if (done != memo.end()) return done->second;
+  const Node& n = prog.nodes[pos];
+  auto input = [&](size_t k) {
+    int s = n.inputs[k];
+    auto d = driver.find(s);
+    BddManager::Ref v = d != driver.end() ? coneBdd(bdd, prog, d->second, driver, memo) : bdd.var(s);
+    return n.invertedInput(k) ? bdd.negate(v) : v;
+  };
+  BddManager::Ref r = BddManager::False;
+  switch (n.type) {
+  case Node::AND_:
+    r = BddManager::True;
+    for (size_t k = 0; k < n.inputs.size(); ++k) r = bdd.andOf(r, input(k));
+    break;
+  case Node::OR_:
+    for (size_t k = 0; k < n.inputs.size(); ++k) r = bdd.orOf(r, input(k));
+    break;
+  case Node::XOR_: {
+    // Exactly one input true
+    BddManager::Ref none = BddManager::True;
+    for (size_t k = 0; k < n.inputs.size(); ++k) {
+      BddManager::Ref v = input(k);
+      r = bdd.orOf(bdd.andOf(r, bdd.negate(v)), bdd.andOf(none, v));
+      none = bdd.andOf(none, bdd.negate(v));
+    }
+    break;
+  }
+  case Node::NOT_:
+    if (!n.inputs.empty()) r = bdd.negate(input(0));
+    break;
+  default:
+    break;
+  }
+  memo[pos] = r;
+  return r;
+}
+
+// Rebuild every cone from its BDD: constant cones become constant signals
+// (or an empty gate), cones computing the same function as an earlier cone
+// are merged into it, and other cones are re-emitted as a sum of products
+// when that needs fewer gates. New AND terms are placed right in front of
+// the cone's root so they sample the leaves at the same time.
+void minimizeWithBdd(Program& prog, const std::vector<bool>& external, const std::vector<bool>& observable,
+                     OptimizeStats& stats) {
+  stats.bddGatesBefore = countGates(prog);
+  SignalUse use = collectUse(prog, external.size());
+  std::vector<Cone> cones = findCones(prog, use, external, observable, kMaxBddInputs);
+  std::sort(cones.begin(), cones.end(), [](const Cone& a, const Cone& b) { return a.root < b.root; });
+
+  BddManager bdd;
+  std::vector<bool> dead(prog.nodes.size(), false);
+  std::vector<bool> touched(external.size(), false);
+  std::unordered_map<BddManager::Ref, int> firstRoot;
+  std::unordered_map<int, std::vector<Node>> emitBefore;
+  int termIndex = 0;
+
+  for (Cone& cone : cones) {
+    std::unordered_map<int, int> driver;
+    std::unordered_map<int, BddManager::Ref> memo;
+    for (size_t c = 1; c < cone.gates.size(); ++c) driver[prog.nodes[cone.gates[c]].outputs[0]] = cone.gates[c];
+    bdd.clearOverflow();
+    BddManager::Ref f = coneBdd(bdd, prog, cone.root, driver, memo);
+    if (bdd.overflow()) continue;
+
+    Node& root = prog.nodes[cone.root];
+    auto dropInner = [&] {
+      for (size_t c = 1; c < cone.gates.size(); ++c) dead[cone.gates[c]] = true;
+    };
+
+    if (bdd.isConstant(f)) {
+      int value = f == BddManager::True ? 1 : 0;
+      bool replaceable = true;
+      for (int s : root.outputs) {
+        if (external[s] || observable[s] || use.drivers[s].size() != 1) replaceable = false;
+        if (value != 0 && !use.readers[s].empty() && use.readers[s].front() <= cone.root) replaceable = false;
+      }
+      if (replaceable) {
+        for (int s : root.outputs) prog.constantSignalValues[s] = value;
+        dead[cone.root] = true;
+        dropInner();
+        stats.folded++;
+      } else if (cone.gates.size() > 1) {
+        // An empty AND is always true, an empty OR always false
+        root.type = value ? Node::AND_ : Node::OR_;
+        root.inputs.clear();
+        root.invertMask = 0;
+        dropInner();
+        stats.bddRewritten++;
+      }
+      continue;
+    }
+
+    // Same function of the same signals as an earlier cone: let that root
+    // write our outputs too (same conditions as merging identical gates)
+    auto [it, inserted] = firstRoot.emplace(f, cone.root);
+    if (!inserted) {
+      int posA = it->second;
+      std::vector<int> vars = bdd.support(f);
+      bool ok = true;
+      for (int v : vars) {
+        if (touched[v] || anyBetween(use.drivers[v], posA - 1, cone.root)) ok = false;
+      }
+      for (int s : root.outputs) {
+        if (touched[s] || use.drivers[s].size() != 1 || anyBetween(use.readers[s], posA, cone.root)) ok = false;
+        if (std::binary_search(vars.begin(), vars.end(), s)) ok = false;
+      }
+      if (ok) {
+        Node& a = prog.nodes[posA];
+        for (int s : root.outputs) a.outputs.push_back(s);
+        for (int s : a.outputs) touched[s] = true;
+        dead[cone.root] = true;
+        dropInner();
+        stats.bddMerged++;
+        continue;
+      }
+      it->second = cone.root;
+    }
+
+    if (cone.gates.size() < 2) continue;
+    std::vector<BddManager::Cube> cover;
+    if (!bdd.isop(f, std::min<size_t>(cone.gates.size(), 64), cover)) continue;
+    size_t terms = 0;
+    for (const auto& cube : cover) {
+      if (cube.size() > 1) terms++;
+    }
+    size_t gates = cover.size() == 1 ? 1 : terms + 1;
+    if (gates >= cone.gates.size()) continue;
+
+    auto setLiterals = [](Node& n, const BddManager::Cube& cube) {
+      n.inputs.clear();
+      n.invertMask = 0;
+      for (const auto& [v, positive] : cube) {
+        if (!positive) n.invertMask |= uint64_t{1} << n.inputs.size();
+        n.inputs.push_back(v);
+      }
+    };
+    if (cover.size() == 1) {
+      root.type = Node::AND_;
+      setLiterals(root, cover[0]);
+    } else {
+      root.type = Node::OR_;
+      root.inputs.clear();
+      root.invertMask = 0;
+      for (const auto& cube : cover) {
+        if (cube.size() == 1) {
+          if (!cube[0].second) root.invertMask |= uint64_t{1} << root.inputs.size();
+          root.inputs.push_back(cube[0].first);
+          continue;
+        }
+        Node term;
+        do {
+          term.name = "_bdd_" + std::to_string(termIndex++);
+        } while (prog.symbolToSignal.count(term.name + "_out"));
+        term.type = Node::AND_;
+        setLiterals(term, cube);
+        int sigId = static_cast<int>(prog.symbolToSignal.size());
+        prog.symbolToSignal[term.name + "_out"] = sigId;
+        term.outputs.push_back(sigId);
+        term.sourceLine = root.sourceLine;
+        root.inputs.push_back(sigId);
+        emitBefore[cone.root].push_back(std::move(term));
+      }
+    }
+    dropInner();
+    stats.bddRewritten++;
+  }
+
+  std::vector<Node> nodes;
+  for (size_t i = 0; i < prog.nodes.size(); ++i) {
+    auto terms = emitBefore.find(static_cast<int>(i));
+    if (terms != emitBefore.end()) {
+      for (Node& n : terms->second) nodes.push_back(std::move(n));
+    }
+    if (!dead[i]) nodes.push_back(std::move(prog.nodes[i]));
+  }
+  prog.nodes = std::move(nodes);
+  stats.bddGatesAfter = countGates(prog);
+}
+
+}  // namespace
+
+OptimizeStats optimizeProgram(Program& prog, bool bddMinimize) {
+  OptimizeStats stats;
+  stats.nodesBefore = prog.nodes.size();
+  size_t signalCount = prog.symbolToSignal.size();
+
+  // Signals that are visible or driven from outside: declared I/O and
+  // everything the Modbus mapping picks up by name.
+  std::vector<bool> external(signalCount, false);
+  std::vector<bool> observable(signalCount, false);
+  for (const auto& name : prog.inputNames) external[prog.symbolToSignal.at(name)] = true;
+  for (const auto& name : prog.analogInputNames) external[prog.symbolToSignal.at(name)] = true;
+  for (const auto& name : prog.outputNames) observable[prog.symbolToSignal.at(name)] = true;
+  for (const auto& name : prog.analogOutputNames) observable[prog.symbolToSignal.at(name)] = true;
+  static const std::regex modbusIn("A?INPUT_[0-9]+"), modbusOut("A?OUTPUT_[0-9]+");
+  for (const auto& [name, sigId] : prog.symbolToSignal) {
+    if (std::regex_match(name, modbusIn)) external[sigId] = true;
+    if (std::regex_match(name, modbusOut)) observable[sigId] = true;
+  }
+
+  std::vector<bool> isConst(signalCount, false);
+  std::vector<uint64_t> constValue(signalCount, 0);
+  for (const auto& [sigId, value] : prog.constantSignalValues) {
+    isConst[sigId] = true;
+    constValue[sigId] = static_cast<uint64_t>(value);
+  }
+
+  bool bddPending = bddMinimize;
+  bool changed = true;
+  while (changed) {
+    changed = false;
+
+    // --- Constant propagation ---
+    SignalUse use = collectUse(prog, signalCount);
+    std::vector<bool> dead(prog.nodes.size(), false);
+    for (size_t i = 0; i < prog.nodes.size(); ++i) {
+      Node& n = prog.nodes[i];
+      if (!isCombinational(n.type)) continue;
+
+      int result = -1; // -1 = not constant
+      auto value = [&](int s) { return constValue[s]; };
+      auto literal = [&](const Node& g, size_t k) { return (value(g.inputs[k]) != 0) != g.invertedInput(k); };
+      switch (n.type) {
+      case Node::AND_:
+      case Node::OR_: {
+        bool isAnd = n.type == Node::AND_;
+        std::vector<int> kept;
+        uint64_t keptMask = 0;
+        for (size_t k = 0; k < n.inputs.size(); ++k) {
+          int s = n.inputs[k];
+          if (!isConst[s]) {
+            if (n.invertedInput(k)) keptMask |= uint64_t{1} << kept.size();
+            kept.push_back(s);
+          } else if (literal(n, k) != isAnd) {
+            result = isAnd ? 0 : 1; // absorbing input
+          }
+        }
+        if (result < 0 && kept.empty()) result = isAnd ? 1 : 0;
+        if (result < 0 && kept.size() != n.inputs.size()) {
+          n.inputs = kept;
+          n.invertMask = keptMask;
+          changed = true;
+        }
+        break;
+      }
+      case Node::XOR_: {
+        // Exactly-one-true semantics (see Simulator::evaluateNode_)
+        int trueConsts = 0;
+        std::vector<int> kept;
+        uint64_t keptMask = 0;
+        for (size_t k = 0; k < n.inputs.size(); ++k) {
+          int s = n.inputs[k];
+          if (!isConst[s]) {
+            if (n.invertedInput(k)) keptMask |= uint64_t{1} << kept.size();
+            kept.push_back(s);
+          } else if (literal(n, k)) {
+            trueConsts++;
+          }
+        }
+        if (trueConsts >= 2) result = 0;
+        else if (kept.empty()) result = trueConsts;
+        else if (trueConsts == 0 && kept.size() != n.inputs.size()) {
+          n.inputs = kept;
+          n.invertMask = keptMask;
+          changed = true;
+        }
+        break;
+      }
+      case Node::NOT_:
+        if (!n.inputs.empty() && isConst[n.inputs[0]]) result = value(n.inputs[0]) == 0;
+        break;
+      case Node::LT_:
+      case Node::GT_:
+      case Node::EQ_:
+        if (n.inputs.size() >= 2 && isConst[n.inputs[0]] && isConst[n.inputs[1]]) {
+          int a = static_cast<int>(value(n.inputs[0]));
+          int b = static_cast<int>(value(n.inputs[1]));
+          result = n.type == Node::LT_ ? a < b : n.type == Node::GT_ ? a > b : a == b;
+        } else if (n.inputs.size() < 2) {
+          result = 0;
+        }
+        break;
+      default:
+        break;
+      }
+      if (result < 0) continue;
+
+      // Replace the node by constant outputs only where that is invisible:
+      // sole driver, not I/O, and no earlier reader that would have seen the
+      // initial 0 during the first scan.
+      int pos = static_cast<int>(i);
+      bool replaceable = true;
+      forEachWrittenSignal(n, [&](int s) {
+        if (external[s] || observable[s] || use.drivers[s].size() != 1) replaceable = false;
+        if (result != 0 && !use.readers[s].empty() && use.readers[s].front() <= pos) replaceable = false;
+      });
+      if (!replaceable) continue;
+      forEachWrittenSignal(n, [&](int s) {
+        isConst[s] = true;
+        constValue[s] = static_cast<uint64_t>(result);
+        prog.constantSignalValues[s] = result;
+      });
+      dead[i] = true;
+      stats.folded++;
+      changed = true;
+    }
+    compact(prog, dead);
+
+    // --- Absorb NOT gates into inverted inputs ---
+    // A gate reading y = NOT(x) can read x inverted instead, provided the NOT
+    // runs earlier in the same scan and x does not change in between. The NOT
+    // node is then removed below once nothing else reads y.
+    use = collectUse(prog, signalCount);
+    for (size_t r = 0; r < prog.nodes.size(); ++r) {
+      Node& g = prog.nodes[r];
+      if (!hasInvertMask(g.type)) continue;
+      int posR = static_cast<int>(r);
+      for (size_t k = 0; k < g.inputs.size() && k < 64; ++k) {
+        int y = g.inputs[k];
+        if (use.drivers[y].size() != 1) continue;
+        int posP = use.drivers[y][0];
+        const Node& inv = prog.nodes[posP];
+        if (posP >= posR || inv.type != Node::NOT_ || inv.inputs.empty()) continue;
+        int x = inv.inputs[0];
+        if (x == y || anyBetween(use.drivers[x], posP, posR)) continue;
+        g.inputs[k] = x;
+        g.invertMask ^= uint64_t{1} << k;
+        stats.absorbed++;
+        changed = true;
+      }
+    }
+
+    // --- Dead node removal ---
+    use = collectUse(prog, signalCount);
+    dead.assign(prog.nodes.size(), false);
+    for (size_t i = 0; i < prog.nodes.size(); ++i) {
+      const Node& n = prog.nodes[i];
+      if (n.type == Node::BTN) continue;
+      int pos = static_cast<int>(i);
+      bool live = false;
+      forEachWrittenSignal(n, [&](int s) {
+        if (observable[s] || external[s]) live = true;
+        for (int r : use.readers[s]) {
+          if (r != pos) live = true;
+        }
+      });
+      if (!live) {
+        dead[i] = true;
+        stats.removed++;
+        changed = true;
+      }
+    }
+    compact(prog, dead);
+
+    // --- Merge identical gates ---
+    // B merges into an earlier A by letting A write B's outputs. This is
+    // exact as long as no input of A changes between A and B and nothing
+    // between A and B reads B's outputs.
+    use = collectUse(prog, signalCount);
+    dead.assign(prog.nodes.size(), false);
+    std::vector<bool> touched(signalCount, false);
+    std::map<std::pair<int, std::vector<int>>, int> firstSeen;
+    for (size_t i = 0; i < prog.nodes.size(); ++i) {
+      Node& b = prog.nodes[i];
+      if (!isCombinational(b.type)) continue;
+      // Inverted inputs are distinct operands: key on (signal, inverted)
+      std::vector<int> key;
+      for (size_t k = 0; k < b.inputs.size(); ++k) key.push_back(b.inputs[k] * 2 + (b.invertedInput(k) ? 1 : 0));
+      if (b.type == Node::AND_ || b.type == Node::OR_) {
+        std::sort(key.begin(), key.end());
+        key.erase(std::unique(key.begin(), key.end()), key.end());
+      } else if (b.type == Node::XOR_) {
+        std::sort(key.begin(), key.end());
+      }
+      auto [it, inserted] = firstSeen.emplace(std::make_pair(static_cast<int>(b.type), key), static_cast<int>(i));
+      if (inserted) continue;
+
+      int posA = it->second;
+      int posB = static_cast<int>(i);
+      Node& a = prog.nodes[posA];
+      bool ok = true;
+      for (int s : a.inputs) {
+        if (touched[s] || anyBetween(use.drivers[s], posA - 1, posB + 1)) ok = false;
+      }
+      forEachWrittenSignal(b, [&](int s) {
+        if (touched[s] || use.drivers[s].size() != 1 || anyBetween(use.readers[s], posA, posB)) ok = false;
+        if (std::find(b.inputs.begin(), b.inputs.end(), s) != b.inputs.end()) ok = false;
+      });
+      if (!ok) {
+        // B may still serve as the merge target for later duplicates
+        it->second = posB;
+        continue;
+      }
+      for (int s : b.outputs) {
+        a.outputs.push_back(s);
+        touched[s] = true;
+      }
+      for (int s : a.outputs) touched[s] = true;
+      dead[i] = true;
+      stats.merged++;
+      changed = true;
+    }
+    compact(prog, dead);
+
+    // --- BDD minimization, once the cheap rewrites have settled ---
+    if (!changed && bddPending) {
+      bddPending = false;
+      minimizeWithBdd(prog, external, observable, stats);
+      signalCount = prog.symbolToSignal.size();
+      external.resize(signalCount, false);
+      observable.resize(signalCount, false);
+      isConst.resize(signalCount, false);
+      constValue.resize(signalCount, 0);
+      for (const auto& [sigId, value] : prog.constantSignalValues) {
+        isConst[sigId] = true;
+        constValue[sigId] = static_cast<uint64_t>(value);
+      }
+      changed = true;
+    }
+  }
+
+  compileLookupTables(prog, external, observable, stats);
+
+  stats.nodesAfter = prog.nodes.size();
+  return stats;
+}
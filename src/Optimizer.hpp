@@ -0,0 +1,29 @@
+#pragma once
+#include "AST.hpp"
+#include <cstddef>
+
+struct OptimizeStats {
+  size_t nodesBefore = 0;
+  size_t nodesAfter = 0;
+  size_t folded = 0;   // nodes replaced by a constant signal
+  size_t removed = 0;  // nodes whose outputs were never read
+  size_t merged = 0;   // structurally identical nodes merged into an earlier one
+  size_t absorbed = 0; // gate inputs that now read a NOT gate's input inverted
+  size_t tables = 0;   // gate cones compiled into one lookup-table node
+  // BDD minimization (only with bddMinimize)
+  size_t bddGatesBefore = 0;
+  size_t bddGatesAfter = 0;
+  size_t bddRewritten = 0; // cones re-emitted as a smaller gate network
+  size_t bddMerged = 0;    // cones equivalent to an earlier cone
+};
+
+// Simplify prog.nodes before simulation: constant propagation through gates
+// and comparators, NOT gates absorbed into inverted gate inputs, dead node
+// removal and merging of identical gates; finally small combinational cones
+// are compiled into lookup-table nodes. With bddMinimize, gate cones are
+// also rebuilt from reduced ordered BDDs: constant cones are folded, cones
+// equivalent to an earlier one are merged into it and the rest is re-emitted
+// as a smaller sum of products where possible. Existing signal ids are kept.
+// OUT/AOUT values and the one-scan lag of forward references are preserved;
+// values of internal signals that nothing reads any more are not.
+OptimizeStats optimizeProgram(Program& prog, bool bddMinimize = false);
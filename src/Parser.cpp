@@ -5,6 +5,8 @@
 #include <algorithm>
 #include <cctype>
 #include <filesystem>
+#include <cstring>
+#include <thread>
 
 static void trim(std::string& s) {
   s.erase(s.begin(), std::find_if(s.begin(), s.end(), [](unsigned char ch) {
@@ -28,16 +30,60 @@ static std::vector<std::string> split(const std::string& s, char delim) {
   return result;
 }
 
-static int getOrCreateSignal(Program& prog, const std::string& symbol) {
+// Prefix for an inline NOT(x) argument that is read through the node's
+// invertMask. Not a whitespace character, so split() keeps it.
+static constexpr char kInvertedArg = '\x01';
+
+// Is s[begin..end] (inclusive) a complete comma-separated argument?
+static bool isWholeArgument(const std::string& s, size_t begin, size_t end) {
+  if (begin > 0) {
+    size_t before = s.find_last_not_of(" \t", begin - 1);
+    if (before != std::string::npos && s[before] != ',') return false;
+  }
+  size_t after = s.find_first_not_of(" \t", end + 1);
+  return after == std::string::npos || s[after] == ',';
+}
+
+// Chunk-local symbol table journal. Worker threads parse with their own
+// Program, so every insertion into its symbolToSignal is recorded here in
+// source order. Replaying the journal against the global table reproduces the
+// exact ids the sequential parser would hand out.
+struct SymbolLog {
+  struct Entry {
+    std::string symbol;
+    int localId;
+    bool alias;
+  };
+  std::vector<Entry> entries;
+};
+
+// Internal node names depend on the global node count, which a chunk worker
+// does not know yet. Chunk-local names carry a '\n' marker (never part of a
+// source line) in front of the local index so the merge can renumber them.
+static std::string internalName(const char* prefix, const Program& prog, const SymbolLog* log) {
+  return std::string(prefix) + (log ? "\n" : "") + std::to_string(prog.nodes.size());
+}
+
+static int getOrCreateSignal(Program& prog, SymbolLog* log, const std::string& symbol) {
   auto it = prog.symbolToSignal.find(symbol);
   if (it != prog.symbolToSignal.end()) {
     return it->second;
   }
   int id = static_cast<int>(prog.symbolToSignal.size());
   prog.symbolToSignal[symbol] = id;
+  if (log) {
+    log->entries.push_back({symbol, id, false});
+  }
   return id;
 }
 
+static void aliasSignal(Program& prog, SymbolLog* log, const std::string& alias, int sigId) {
+  prog.symbolToSignal[alias] = sigId;
+  if (log) {
+    log->entries.push_back({alias, sigId, true});
+  }
+}
+
 static void addTokenSpan(Program& prog, int line, int col0, int col1, const std::string& symbol) {
   Program::TokenSpan span;
   span.line = line;
@@ -72,34 +118,19 @@ static int parseHexOrDecimal(const std::string& str) {
 }
 
 // Create a constant signal with a fixed value
-static int getOrCreateConstantSignal(Program& prog, int value) {
+static int getOrCreateConstantSignal(Program& prog, SymbolLog* log, int value) {
   // Create a unique name for the constant
   std::string constName = "_const_" + std::to_string(value);
   auto it = prog.symbolToSignal.find(constName);
   if (it != prog.symbolToSignal.end()) {
     return it->second;
   }
-  int id = static_cast<int>(prog.symbolToSignal.size());
-  prog.symbolToSignal[constName] = id;
+  int id = getOrCreateSignal(prog, log, constName);
   prog.analogSignals.insert(id);  // Constants are analog signals
   return id;
 }
-bool fileWatcher(const std::string& path, Program& out) {
-  if (std::filesystem::last_write_time(path) != out.lastModifiedAt) {
-    return true;
-    printf("File changed: %s\n", path.c_str());
-  } else {
-    return false;
-    printf("File unchanged: %s\n", path.c_str());
-  }
-}
-
-ParseResult parseFile(const std::string& path, Program& out) {
-  std::ifstream file(path);
-  if (!file.is_open()) {
-    return {false, "Could not open file: " + path};
-  }
 
+static void clearProgram(Program& out) {
   out.inputNames.clear();
   out.outputNames.clear();
   out.analogInputNames.clear();
@@ -110,529 +141,885 @@ ParseResult parseFile(const std::string& path, Program& out) {
   out.nodes.clear();
   out.sourceLines.clear();
   out.tokens.clear();
+}
 
-  std::string line;
-  int lineNum = 0;
-  bool inDeclarations = true;
-
-  while (std::getline(file, line)) {
-    out.sourceLines.push_back(line);
-    trim(line);
-    
-    if (line.empty() || line[0] == '#') {
-      lineNum++;
-      continue;
-    }
+static ParseResult parseLine(std::string line, int lineNum, Program& out, SymbolLog* log) {
+  trim(line);
+  
+  if (line.empty() || line[0] == '#') {
+    return {true, ""};
+  }
 
-    // Parse IN declaration
-    if (line.substr(0, 3) == "IN ") {
-      std::string rest = line.substr(3);
-      auto items = split(rest, ',');
-      size_t searchStart = 3; // Start after "IN "
-      for (const auto& item : items) {
-        // Check for alias: name(alias)
-        size_t parenOpen = item.find('(');
-        size_t parenClose = item.find(')');
-        
-        std::string name = item;
-        std::string alias = "";
-        
-        if (parenOpen != std::string::npos && parenClose != std::string::npos && parenClose > parenOpen) {
-          name = item.substr(0, parenOpen);
-          alias = item.substr(parenOpen + 1, parenClose - parenOpen - 1);
-          trim(name);
-          trim(alias);
-        }
+  // Parse IN declaration
+  if (line.substr(0, 3) == "IN ") {
+    std::string rest = line.substr(3);
+    auto items = split(rest, ',');
+    size_t searchStart = 3; // Start after "IN "
+    for (const auto& item : items) {
+      // Check for alias: name(alias)
+      size_t parenOpen = item.find('(');
+      size_t parenClose = item.find(')');
+      
+      std::string name = item;
+      std::string alias = "";
+      
+      if (parenOpen != std::string::npos && parenClose != std::string::npos && parenClose > parenOpen) {
+        name = item.substr(0, parenOpen);
+        alias = item.substr(parenOpen + 1, parenClose - parenOpen - 1);
+        trim(name);
+        trim(alias);
+      }
 
-        int sigId = getOrCreateSignal(out, name);
-        if (!alias.empty()) {
-          out.symbolToSignal[alias] = sigId;
-          out.inputNames.push_back(alias);
-        } else {
-          out.inputNames.push_back(name);
-        }
+      int sigId = getOrCreateSignal(out, log, name);
+      if (!alias.empty()) {
+        aliasSignal(out, log, alias, sigId);
+        out.inputNames.push_back(alias);
+      } else {
+        out.inputNames.push_back(name);
+      }
 
-        // Find with word boundary check
-        size_t pos = line.find(item, searchStart);
-        if (pos != std::string::npos) {
-          addTokenSpan(out, lineNum, static_cast<int>(pos), 
-                       static_cast<int>(pos + item.length()), item);
-          searchStart = pos + item.length();
-        }
+      // Find with word boundary check
+      size_t pos = line.find(item, searchStart);
+      if (pos != std::string::npos) {
+        addTokenSpan(out, lineNum, static_cast<int>(pos), 
+                     static_cast<int>(pos + item.length()), item);
+        searchStart = pos + item.length();
       }
-      lineNum++;
-      continue;
     }
+    return {true, ""};
+  }
 
-    // Parse OUT declaration
-    if (line.substr(0, 4) == "OUT ") {
-      std::string rest = line.substr(4);
-      auto items = split(rest, ',');
-      size_t searchStart = 4; // Start after "OUT "
-      for (const auto& item : items) {
-        // Check for alias: name(alias)
-        size_t parenOpen = item.find('(');
-        size_t parenClose = item.find(')');
-        
-        std::string name = item;
-        std::string alias = "";
-        
-        if (parenOpen != std::string::npos && parenClose != std::string::npos && parenClose > parenOpen) {
-          name = item.substr(0, parenOpen);
-          alias = item.substr(parenOpen + 1, parenClose - parenOpen - 1);
-          trim(name);
-          trim(alias);
-        }
+  // Parse OUT declaration
+  if (line.substr(0, 4) == "OUT ") {
+    std::string rest = line.substr(4);
+    auto items = split(rest, ',');
+    size_t searchStart = 4; // Start after "OUT "
+    for (const auto& item : items) {
+      // Check for alias: name(alias)
+      size_t parenOpen = item.find('(');
+      size_t parenClose = item.find(')');
+      
+      std::string name = item;
+      std::string alias = "";
+      
+      if (parenOpen != std::string::npos && parenClose != std::string::npos && parenClose > parenOpen) {
+        name = item.substr(0, parenOpen);
+        alias = item.substr(parenOpen + 1, parenClose - parenOpen - 1);
+        trim(name);
+        trim(alias);
+      }
 
-        int sigId = getOrCreateSignal(out, name);
-        if (!alias.empty()) {
-          out.symbolToSignal[alias] = sigId;
-          out.outputNames.push_back(alias);
-        } else {
-          out.outputNames.push_back(name);
-        }
+      int sigId = getOrCreateSignal(out, log, name);
+      if (!alias.empty()) {
+        aliasSignal(out, log, alias, sigId);
+        out.outputNames.push_back(alias);
+      } else {
+        out.outputNames.push_back(name);
+      }
 
-        // Find with word boundary check
-        size_t pos = line.find(item, searchStart);
-        if (pos != std::string::npos) {
-          addTokenSpan(out, lineNum, static_cast<int>(pos), 
-                       static_cast<int>(pos + item.length()), item);
-          searchStart = pos + item.length();
-        }
+      // Find with word boundary check
+      size_t pos = line.find(item, searchStart);
+      if (pos != std::string::npos) {
+        addTokenSpan(out, lineNum, static_cast<int>(pos), 
+                     static_cast<int>(pos + item.length()), item);
+        searchStart = pos + item.length();
       }
-      lineNum++;
-      continue;
     }
+    return {true, ""};
+  }
 
-    // Parse AIN (Analog Input) declaration
-    if (line.substr(0, 4) == "AIN ") {
-      std::string rest = line.substr(4);
-      auto items = split(rest, ',');
-      size_t searchStart = 4; // Start after "AIN "
-      for (const auto& item : items) {
-        // Check for alias: name(alias)
-        size_t parenOpen = item.find('(');
-        size_t parenClose = item.find(')');
-        
-        std::string name = item;
-        std::string alias = "";
-        
-        if (parenOpen != std::string::npos && parenClose != std::string::npos && parenClose > parenOpen) {
-          name = item.substr(0, parenOpen);
-          alias = item.substr(parenOpen + 1, parenClose - parenOpen - 1);
-          trim(name);
-          trim(alias);
-        }
+  // Parse AIN (Analog Input) declaration
+  if (line.substr(0, 4) == "AIN ") {
+    std::string rest = line.substr(4);
+    auto items = split(rest, ',');
+    size_t searchStart = 4; // Start after "AIN "
+    for (const auto& item : items) {
+      // Check for alias: name(alias)
+      size_t parenOpen = item.find('(');
+      size_t parenClose = item.find(')');
+      
+      std::string name = item;
+      std::string alias = "";
+      
+      if (parenOpen != std::string::npos && parenClose != std::string::npos && parenClose > parenOpen) {
+        name = item.substr(0, parenOpen);
+        alias = item.substr(parenOpen + 1, parenClose - parenOpen - 1);
+        trim(name);
+        trim(alias);
+      }
 
-        int sigId = getOrCreateSignal(out, name);
-        out.analogSignals.insert(sigId);  // Mark as analog signal
-        if (!alias.empty()) {
-          out.symbolToSignal[alias] = sigId;
-          out.analogInputNames.push_back(alias);
-        } else {
-          out.analogInputNames.push_back(name);
-        }
+      int sigId = getOrCreateSignal(out, log, name);
+      out.analogSignals.insert(sigId);  // Mark as analog signal
+      if (!alias.empty()) {
+        aliasSignal(out, log, alias, sigId);
+        out.analogInputNames.push_back(alias);
+      } else {
+        out.analogInputNames.push_back(name);
+      }
 
-        // Find with word boundary check
-        size_t pos = line.find(item, searchStart);
-        if (pos != std::string::npos) {
-          addTokenSpan(out, lineNum, static_cast<int>(pos), 
-                       static_cast<int>(pos + item.length()), item);
-          searchStart = pos + item.length();
-        }
+      // Find with word boundary check
+      size_t pos = line.find(item, searchStart);
+      if (pos != std::string::npos) {
+        addTokenSpan(out, lineNum, static_cast<int>(pos), 
+                     static_cast<int>(pos + item.length()), item);
+        searchStart = pos + item.length();
       }
-      lineNum++;
-      continue;
     }
+    return {true, ""};
+  }
 
-    // Parse AOUT (Analog Output) declaration
-    if (line.substr(0, 5) == "AOUT ") {
-      std::string rest = line.substr(5);
-      auto items = split(rest, ',');
-      size_t searchStart = 5; // Start after "AOUT "
-      for (const auto& item : items) {
-        // Check for alias: name(alias)
-        size_t parenOpen = item.find('(');
-        size_t parenClose = item.find(')');
-        
-        std::string name = item;
-        std::string alias = "";
-        
-        if (parenOpen != std::string::npos && parenClose != std::string::npos && parenClose > parenOpen) {
-          name = item.substr(0, parenOpen);
-          alias = item.substr(parenOpen + 1, parenClose - parenOpen - 1);
-          trim(name);
-          trim(alias);
-        }
+  // Parse AOUT (Analog Output) declaration
+  if (line.substr(0, 5) == "AOUT ") {
+    std::string rest = line.substr(5);
+    auto items = split(rest, ',');
+    size_t searchStart = 5; // Start after "AOUT "
+    for (const auto& item : items) {
+      // Check for alias: name(alias)
+      size_t parenOpen = item.find('(');
+      size_t parenClose = item.find(')');
+      
+      std::string name = item;
+      std::string alias = "";
+      
+      if (parenOpen != std::string::npos && parenClose != std::string::npos && parenClose > parenOpen) {
+        name = item.substr(0, parenOpen);
+        alias = item.substr(parenOpen + 1, parenClose - parenOpen - 1);
+        trim(name);
+        trim(alias);
+      }
 
-        int sigId = getOrCreateSignal(out, name);
-        out.analogSignals.insert(sigId);  // Mark as analog signal
-        if (!alias.empty()) {
-          out.symbolToSignal[alias] = sigId;
-          out.analogOutputNames.push_back(alias);
-        } else {
-          out.analogOutputNames.push_back(name);
-        }
+      int sigId = getOrCreateSignal(out, log, name);
+      out.analogSignals.insert(sigId);  // Mark as analog signal
+      if (!alias.empty()) {
+        aliasSignal(out, log, alias, sigId);
+        out.analogOutputNames.push_back(alias);
+      } else {
+        out.analogOutputNames.push_back(name);
+      }
 
-        // Find with word boundary check
-        size_t pos = line.find(item, searchStart);
-        if (pos != std::string::npos) {
-          addTokenSpan(out, lineNum, static_cast<int>(pos), 
-                       static_cast<int>(pos + item.length()), item);
-          searchStart = pos + item.length();
-        }
+      // Find with word boundary check
+      size_t pos = line.find(item, searchStart);
+      if (pos != std::string::npos) {
+        addTokenSpan(out, lineNum, static_cast<int>(pos), 
+                     static_cast<int>(pos + item.length()), item);
+        searchStart = pos + item.length();
       }
-      lineNum++;
-      continue;
     }
+    return {true, ""};
+  }
 
-    // Parse gate: <GATETYPE> <name>(args...) -> output
-    size_t arrowPos = line.find("->");
-    if (arrowPos == std::string::npos) {
-      lineNum++;
-      continue;
-    }
+  // Parse gate: <GATETYPE> <name>(args...) -> output
+  size_t arrowPos = line.find("->");
+  if (arrowPos == std::string::npos) {
+    return {true, ""};
+  }
 
-    std::string beforeArrow = line.substr(0, arrowPos);
-    std::string afterArrow = line.substr(arrowPos + 2);
-    trim(beforeArrow);
-    trim(afterArrow);
+  std::string beforeArrow = line.substr(0, arrowPos);
+  std::string afterArrow = line.substr(arrowPos + 2);
+  trim(beforeArrow);
+  trim(afterArrow);
 
-    // Extract gate type and name
-    size_t spacePos = beforeArrow.find(' ');
-    if (spacePos == std::string::npos) {
-      return {false, "Line " + std::to_string(lineNum + 1) + ": Invalid gate syntax"};
-    }
+  // Extract gate type and name
+  size_t spacePos = beforeArrow.find(' ');
+  if (spacePos == std::string::npos) {
+    return {false, "Line " + std::to_string(lineNum + 1) + ": Invalid gate syntax"};
+  }
 
-    std::string gateType = beforeArrow.substr(0, spacePos);
-    std::string gateName = beforeArrow.substr(spacePos + 1);
-    
-    size_t parenPos = gateName.find('(');
-    if (parenPos == std::string::npos) {
-      return {false, "Line " + std::to_string(lineNum + 1) + ": Missing '(' in gate definition"};
-    }
+  std::string gateType = beforeArrow.substr(0, spacePos);
+  std::string gateName = beforeArrow.substr(spacePos + 1);
+  
+  size_t parenPos = gateName.find('(');
+  if (parenPos == std::string::npos) {
+    return {false, "Line " + std::to_string(lineNum + 1) + ": Missing '(' in gate definition"};
+  }
 
-    std::string name = gateName.substr(0, parenPos);
-    std::string argsStr = gateName.substr(parenPos + 1);
-    
-    // Find matching closing paren (handle nested parens from NOT())
-    int depth = 1;
-    size_t closeParen = 0;
-    while (closeParen < argsStr.size() && depth > 0) {
-      if (argsStr[closeParen] == '(') depth++;
-      else if (argsStr[closeParen] == ')') depth--;
-      if (depth > 0) closeParen++;
-    }
-    if (depth != 0) {
-      return {false, "Line " + std::to_string(lineNum + 1) + ": Missing ')' in gate definition"};
-    }
-    argsStr = argsStr.substr(0, closeParen);
-
-    // Parse gate type
-    Program::Node::Type type;
-    if (gateType == "AND") {
-      type = Program::Node::AND_;
-    } else if (gateType == "OR") {
-      type = Program::Node::OR_;
-    } else if (gateType == "XOR") {
-      type = Program::Node::XOR_;
-    } else if (gateType == "NOT") {
-      type = Program::Node::NOT_;
-    } else if (gateType == "PS") {
-      type = Program::Node::PS_;
-    } else if (gateType == "NS") {
-      type = Program::Node::NS_;
-    } else if (gateType == "SR") {
-      type = Program::Node::SR_;
-    } else if (gateType == "RS") {
-      type = Program::Node::RS_;
-    } else if (gateType == "TON") {
-      type = Program::Node::TON_;
-    } else if (gateType == "TOF") {
-      type = Program::Node::TOF_;
-    } else if (gateType == "CTU") {
-      type = Program::Node::CTU_;
-    } else if (gateType == "CTD") {
-      type = Program::Node::CTD_;
-    } else if (gateType == "LT") {
-      type = Program::Node::LT_;
-    } else if (gateType == "GT") {
-      type = Program::Node::GT_;
-    } else if (gateType == "EQ") {
-      type = Program::Node::EQ_;
-    } else if (gateType == "BTN") {
-      type = Program::Node::BTN;
-    } else {
-      return {false, "Line " + std::to_string(lineNum + 1) + ": Unknown gate type: " + gateType};
-    }
+  std::string name = gateName.substr(0, parenPos);
+  std::string argsStr = gateName.substr(parenPos + 1);
+  
+  // Find matching closing paren (handle nested parens from NOT())
+  int depth = 1;
+  size_t closeParen = 0;
+  while (closeParen < argsStr.size() && depth > 0) {
+    if (argsStr[closeParen] == '(') depth++;
+    else if (argsStr[closeParen] == ')') depth--;
+    if (depth > 0) closeParen++;
+  }
+  if (depth != 0) {
+    return {false, "Line " + std::to_string(lineNum + 1) + ": Missing ')' in gate definition"};
+  }
+  argsStr = argsStr.substr(0, closeParen);
+
+  // Parse gate type
+  Program::Node::Type type;
+  if (gateType == "AND") {
+    type = Program::Node::AND_;
+  } else if (gateType == "OR") {
+    type = Program::Node::OR_;
+  } else if (gateType == "XOR") {
+    type = Program::Node::XOR_;
+  } else if (gateType == "NOT") {
+    type = Program::Node::NOT_;
+  } else if (gateType == "PS") {
+    type = Program::Node::PS_;
+  } else if (gateType == "NS") {
+    type = Program::Node::NS_;
+  } else if (gateType == "SR") {
+    type = Program::Node::SR_;
+  } else if (gateType == "RS") {
+    type = Program::Node::RS_;
+  } else if (gateType == "TON") {
+    type = Program::Node::TON_;
+  } else if (gateType == "TOF") {
+    type = Program::Node::TOF_;
+  } else if (gateType == "CTU") {
+    type = Program::Node::CTU_;
+  } else if (gateType == "CTD") {
+    type = Program::Node::CTD_;
+  } else if (gateType == "LT") {
+    type = Program::Node::LT_;
+  } else if (gateType == "GT") {
+    type = Program::Node::GT_;
+  } else if (gateType == "EQ") {
+    type = Program::Node::EQ_;
+  } else if (gateType == "BTN") {
+    type = Program::Node::BTN;
+  } else {
+    return {false, "Line " + std::to_string(lineNum + 1) + ": Unknown gate type: " + gateType};
+  }
 
-    // Create node
-    Program::Node node;
+  // Create node
+  Program::Node node;
 
-    // Parse inputs (handle NOT(...) syntax)
-    std::vector<int> inputs;
-    std::vector<std::string> inputSymbols;
-    
-    // First, find original token positions in the source line BEFORE processing
-    // We need to find the arguments section in the original line
-    size_t argsStartInLine = line.find('(') + 1;
-    
-    if (!argsStr.empty()) {
-      // Handle NOT(...) in arguments - find matching parenthesis properly
-      std::string processed = argsStr;
-      size_t notPos = processed.find("NOT(");
-      while (notPos != std::string::npos) {
-        // Find the matching closing paren by counting depth
-        int depth = 1;
-        size_t notEnd = notPos + 4; // Start after "NOT("
-        while (notEnd < processed.size() && depth > 0) {
-          if (processed[notEnd] == '(') depth++;
-          else if (processed[notEnd] == ')') depth--;
-          if (depth > 0) notEnd++;
-        }
-        
-        if (depth != 0) {
-          return {false, "Line " + std::to_string(lineNum + 1) + ": Unmatched NOT("};
-        }
-        
-        std::string notArg = processed.substr(notPos + 4, notEnd - notPos - 4);
-        trim(notArg);
-        
-        // Add token span for the argument inside NOT() - find it in original line
-        size_t notInOriginal = argsStr.find("NOT(");
-        if (notInOriginal != std::string::npos) {
-          size_t argInOriginal = argsStr.find(notArg, notInOriginal + 4);
-          if (argInOriginal != std::string::npos) {
-            int col0 = static_cast<int>(argsStartInLine + argInOriginal);
-            addTokenSpan(out, lineNum, col0, col0 + static_cast<int>(notArg.length()), notArg);
-          }
+  // Parse inputs (handle NOT(...) syntax)
+  std::vector<int> inputs;
+  std::vector<std::string> inputSymbols;
+  
+  // First, find original token positions in the source line BEFORE processing
+  // We need to find the arguments section in the original line
+  size_t argsStartInLine = line.find('(') + 1;
+  
+  if (!argsStr.empty()) {
+    bool maskable = type == Program::Node::AND_ || type == Program::Node::OR_ || type == Program::Node::XOR_ ||
+                    type == Program::Node::SR_ || type == Program::Node::RS_;
+    auto addNotNode = [&](const std::string& notArg) {
+      Program::Node notNode;
+      notNode.type = Program::Node::NOT_;
+      notNode.name = internalName("_not_", out, log);
+      int notInputSig = getOrCreateSignal(out, log, notArg);
+      notNode.inputs.push_back(notInputSig);
+      std::string notOutputName = internalName("_not_", out, log) + "_out";
+      int notOutputSig = getOrCreateSignal(out, log, notOutputName);
+      notNode.outputs.push_back(notOutputSig);
+      notNode.sourceLine = lineNum;
+      out.nodes.push_back(notNode);
+      return notOutputName;
+    };
+
+    // Handle NOT(...) in arguments - find matching parenthesis properly
+    std::string processed = argsStr;
+    size_t notPos = processed.find("NOT(");
+    while (notPos != std::string::npos) {
+      // Find the matching closing paren by counting depth
+      int depth = 1;
+      size_t notEnd = notPos + 4; // Start after "NOT("
+      while (notEnd < processed.size() && depth > 0) {
+        if (processed[notEnd] == '(') depth++;
+        else if (processed[notEnd] == ')') depth--;
+        if (depth > 0) notEnd++;
+      }
+      
+      if (depth != 0) {
+        return {false, "Line " + std::to_string(lineNum + 1) + ": Unmatched NOT("};
+      }
+      
+      std::string notArg = processed.substr(notPos + 4, notEnd - notPos - 4);
+      trim(notArg);
+      
+      // Add token span for the argument inside NOT() - find it in original line
+      size_t notInOriginal = argsStr.find("NOT(");
+      if (notInOriginal != std::string::npos) {
+        size_t argInOriginal = argsStr.find(notArg, notInOriginal + 4);
+        if (argInOriginal != std::string::npos) {
+          int col0 = static_cast<int>(argsStartInLine + argInOriginal);
+          addTokenSpan(out, lineNum, col0, col0 + static_cast<int>(notArg.length()), notArg);
         }
-        
-        // Create a NOT node for this
-        Program::Node notNode;
-        notNode.type = Program::Node::NOT_;
-        notNode.name = "_not_" + std::to_string(out.nodes.size());
-        int notInputSig = getOrCreateSignal(out, notArg);
-        notNode.inputs.push_back(notInputSig);
-        std::string notOutputName = "_not_" + std::to_string(out.nodes.size()) + "_out";
-        int notOutputSig = getOrCreateSignal(out, notOutputName);
-        notNode.outputs.push_back(notOutputSig);
-        notNode.sourceLine = lineNum;
-        out.nodes.push_back(notNode);
-        
-        // Replace NOT(...) with the output signal name in processed string
-        processed.replace(notPos, notEnd - notPos + 1, notOutputName);
-        notPos = processed.find("NOT(");
       }
+      
+      // AND/OR/XOR/SR/RS read a plain NOT(x) argument through the node's
+      // inversion mask; everything else gets a separate NOT node
+      if (maskable && isWholeArgument(processed, notPos, notEnd) && notArg.find('(') == std::string::npos) {
+        processed.replace(notPos, notEnd - notPos + 1, kInvertedArg + notArg);
+      } else {
+        processed.replace(notPos, notEnd - notPos + 1, addNotNode(notArg));
+      }
+      notPos = processed.find("NOT(");
+    }
 
-      // Handle PS(...) in arguments - Positive Signal (Rising Edge) inline
-      size_t psPos = processed.find("PS(");
-      while (psPos != std::string::npos) {
-        // Find the matching closing paren by counting depth
-        int depth = 1;
-        size_t psEnd = psPos + 3; // Start after "PS("
-        while (psEnd < processed.size() && depth > 0) {
-          if (processed[psEnd] == '(') depth++;
-          else if (processed[psEnd] == ')') depth--;
-          if (depth > 0) psEnd++;
-        }
-        
-        if (depth != 0) {
-          return {false, "Line " + std::to_string(lineNum + 1) + ": Unmatched PS("};
-        }
-        
-        std::string psArg = processed.substr(psPos + 3, psEnd - psPos - 3);
-        trim(psArg);
-        
-        // Add token span for the argument inside PS() - find it in original line
-        size_t psInOriginal = argsStr.find("PS(");
-        if (psInOriginal != std::string::npos) {
-          size_t argInOriginal = argsStr.find(psArg, psInOriginal + 3);
-          if (argInOriginal != std::string::npos) {
-            int col0 = static_cast<int>(argsStartInLine + argInOriginal);
-            addTokenSpan(out, lineNum, col0, col0 + static_cast<int>(psArg.length()), psArg);
-          }
+    // Handle PS(...) in arguments - Positive Signal (Rising Edge) inline
+    size_t psPos = processed.find("PS(");
+    while (psPos != std::string::npos) {
+      // Find the matching closing paren by counting depth
+      int depth = 1;
+      size_t psEnd = psPos + 3; // Start after "PS("
+      while (psEnd < processed.size() && depth > 0) {
+        if (processed[psEnd] == '(') depth++;
+        else if (processed[psEnd] == ')') depth--;
+        if (depth > 0) psEnd++;
+      }
+      
+      if (depth != 0) {
+        return {false, "Line " + std::to_string(lineNum + 1) + ": Unmatched PS("};
+      }
+      
+      std::string psArg = processed.substr(psPos + 3, psEnd - psPos - 3);
+      trim(psArg);
+      
+      // Add token span for the argument inside PS() - find it in original line
+      size_t psInOriginal = argsStr.find("PS(");
+      if (psInOriginal != std::string::npos) {
+        size_t argInOriginal = argsStr.find(psArg, psInOriginal + 3);
+        if (argInOriginal != std::string::npos) {
+          int col0 = static_cast<int>(argsStartInLine + argInOriginal);
+          addTokenSpan(out, lineNum, col0, col0 + static_cast<int>(psArg.length()), psArg);
         }
-        
-        // Create a PS node for this (rising edge detector)
-        Program::Node psNode;
-        psNode.type = Program::Node::PS_;
-        psNode.name = "_ps_" + std::to_string(out.nodes.size());
-        int psInputSig = getOrCreateSignal(out, psArg);
-        psNode.inputs.push_back(psInputSig);
-        std::string psOutputName = "_ps_" + std::to_string(out.nodes.size()) + "_out";
-        int psOutputSig = getOrCreateSignal(out, psOutputName);
-        psNode.outputs.push_back(psOutputSig);
-        psNode.sourceLine = lineNum;
-        out.nodes.push_back(psNode);
-        
-        // Replace PS(...) with the output signal name in processed string
-        processed.replace(psPos, psEnd - psPos + 1, psOutputName);
-        psPos = processed.find("PS(");
       }
+      
+      // Create a PS node for this (rising edge detector)
+      Program::Node psNode;
+      psNode.type = Program::Node::PS_;
+      psNode.name = internalName("_ps_", out, log);
+      int psInputSig = getOrCreateSignal(out, log, psArg);
+      psNode.inputs.push_back(psInputSig);
+      std::string psOutputName = internalName("_ps_", out, log) + "_out";
+      int psOutputSig = getOrCreateSignal(out, log, psOutputName);
+      psNode.outputs.push_back(psOutputSig);
+      psNode.sourceLine = lineNum;
+      out.nodes.push_back(psNode);
+      
+      // Replace PS(...) with the output signal name in processed string
+      processed.replace(psPos, psEnd - psPos + 1, psOutputName);
+      psPos = processed.find("PS(");
+    }
 
-      // Handle NS(...) in arguments - Negative Signal (Falling Edge) inline
-      size_t nsPos = processed.find("NS(");
-      while (nsPos != std::string::npos) {
-        // Find the matching closing paren by counting depth
-        int depth = 1;
-        size_t nsEnd = nsPos + 3; // Start after "NS("
-        while (nsEnd < processed.size() && depth > 0) {
-          if (processed[nsEnd] == '(') depth++;
-          else if (processed[nsEnd] == ')') depth--;
-          if (depth > 0) nsEnd++;
-        }
-        
-        if (depth != 0) {
-          return {false, "Line " + std::to_string(lineNum + 1) + ": Unmatched NS("};
-        }
-        
-        std::string nsArg = processed.substr(nsPos + 3, nsEnd - nsPos - 3);
-        trim(nsArg);
-        
-        // Add token span for the argument inside NS() - find it in original line
-        size_t nsInOriginal = argsStr.find("NS(");
-        if (nsInOriginal != std::string::npos) {
-          size_t argInOriginal = argsStr.find(nsArg, nsInOriginal + 3);
-          if (argInOriginal != std::string::npos) {
-            int col0 = static_cast<int>(argsStartInLine + argInOriginal);
-            addTokenSpan(out, lineNum, col0, col0 + static_cast<int>(nsArg.length()), nsArg);
-          }
+    // Handle NS(...) in arguments - Negative Signal (Falling Edge) inline
+    size_t nsPos = processed.find("NS(");
+    while (nsPos != std::string::npos) {
+      // Find the matching closing paren by counting depth
+      int depth = 1;
+      size_t nsEnd = nsPos + 3; // Start after "NS("
+      while (nsEnd < processed.size() && depth > 0) {
+        if (processed[nsEnd] == '(') depth++;
+        else if (processed[nsEnd] == ')') depth--;
+        if (depth > 0) nsEnd++;
+      }
+      
+      if (depth != 0) {
+        return {false, "Line " + std::to_string(lineNum + 1) + ": Unmatched NS("};
+      }
+      
+      std::string nsArg = processed.substr(nsPos + 3, nsEnd - nsPos - 3);
+      trim(nsArg);
+      
+      // Add token span for the argument inside NS() - find it in original line
+      size_t nsInOriginal = argsStr.find("NS(");
+      if (nsInOriginal != std::string::npos) {
+        size_t argInOriginal = argsStr.find(nsArg, nsInOriginal + 3);
+        if (argInOriginal != std::string::npos) {
+          int col0 = static_cast<int>(argsStartInLine + argInOriginal);
+          addTokenSpan(out, lineNum, col0, col0 + static_cast<int>(nsArg.length()), nsArg);
         }
-        
-        // Create a NS node for this (falling edge detector)
-        Program::Node nsNode;
-        nsNode.type = Program::Node::NS_;
-        nsNode.name = "_ns_" + std::to_string(out.nodes.size());
-        int nsInputSig = getOrCreateSignal(out, nsArg);
-        nsNode.inputs.push_back(nsInputSig);
-        std::string nsOutputName = "_ns_" + std::to_string(out.nodes.size()) + "_out";
-        int nsOutputSig = getOrCreateSignal(out, nsOutputName);
-        nsNode.outputs.push_back(nsOutputSig);
-        nsNode.sourceLine = lineNum;
-        out.nodes.push_back(nsNode);
-        
-        // Replace NS(...) with the output signal name in processed string
-        processed.replace(nsPos, nsEnd - nsPos + 1, nsOutputName);
-        nsPos = processed.find("NS(");
       }
       
-      // Now split by comma and add non-internal signals
-      auto argList = split(processed, ',');
-      int argIdx = 0;
-      for (const auto& arg : argList) {
-        // Special handling for TON/TOF first argument as hardcoded time
-        if (argIdx == 0 && (type == Program::Node::TON_ || type == Program::Node::TOF_)) {
-          // Check if it's a quoted string or looks like a time (starts with digit or dot)
-          if (!arg.empty() && ((arg.front() == '"' && arg.back() == '"') || (std::isdigit(arg.front())) || (arg.front() == '.'))) {
-            std::string timeStr = arg;
-            if (timeStr.front() == '"') {
-                timeStr = timeStr.substr(1, timeStr.length() - 2);
-            }
-            node.hardcodedPresetTime = parseTimeStringToFloat(timeStr);
-            argIdx++;
-            continue; // Skip adding this as a signal input
-          }
+      // Create a NS node for this (falling edge detector)
+      Program::Node nsNode;
+      nsNode.type = Program::Node::NS_;
+      nsNode.name = internalName("_ns_", out, log);
+      int nsInputSig = getOrCreateSignal(out, log, nsArg);
+      nsNode.inputs.push_back(nsInputSig);
+      std::string nsOutputName = internalName("_ns_", out, log) + "_out";
+      int nsOutputSig = getOrCreateSignal(out, log, nsOutputName);
+      nsNode.outputs.push_back(nsOutputSig);
+      nsNode.sourceLine = lineNum;
+      out.nodes.push_back(nsNode);
+      
+      // Replace NS(...) with the output signal name in processed string
+      processed.replace(nsPos, nsEnd - nsPos + 1, nsOutputName);
+      nsPos = processed.find("NS(");
+    }
+    
+    // Now split by comma and add non-internal signals
+    auto argList = split(processed, ',');
+    int argIdx = 0;
+    for (auto arg : argList) {
+      bool inverted = !arg.empty() && arg.front() == kInvertedArg;
+      if (inverted) {
+        arg.erase(0, 1);
+        if (inputs.size() >= 64) {
+          // The mask has no bit left for this input
+          arg = addNotNode(arg);
+          inverted = false;
+        } else {
+          node.invertMask |= uint64_t{1} << inputs.size();
         }
+      }
 
-        // Special handling for CTU/CTD arguments (PV)
-        if (argIdx == 0 && (type == Program::Node::CTU_ || type == Program::Node::CTD_)) {
-          if (!arg.empty() && ((arg.front() == '"' && arg.back() == '"') || (std::isdigit(arg.front())) || (arg.size() > 1 && arg.front() == '-'))) {
-            std::string valStr = arg;
-            if (valStr.front() == '"') valStr = valStr.substr(1, valStr.length() - 2);
-            try {
-              // Try to parse as int
-              int val = std::stoi(valStr);
-              node.hardcodedPresetValue = val;
-              argIdx++;
-              continue;
-            } catch (...) {
-              // If not a number, fall through to signal handling
-            }
+      // Special handling for TON/TOF first argument as hardcoded time
+      if (argIdx == 0 && (type == Program::Node::TON_ || type == Program::Node::TOF_)) {
+        // Check if it's a quoted string or looks like a time (starts with digit or dot)
+        if (!arg.empty() && ((arg.front() == '"' && arg.back() == '"') || (std::isdigit(arg.front())) || (arg.front() == '.'))) {
+          std::string timeStr = arg;
+          if (timeStr.front() == '"') {
+              timeStr = timeStr.substr(1, timeStr.length() - 2);
           }
+          node.hardcodedPresetTime = parseTimeStringToFloat(timeStr);
+          argIdx++;
+          continue; // Skip adding this as a signal input
         }
+      }
 
-        argIdx++;
-        
-        // For comparators (LT, GT, EQ), check if this argument is a hex/decimal literal
-        bool isLiteral = false;
-        if (type == Program::Node::LT_ || type == Program::Node::GT_ || type == Program::Node::EQ_) {
-          int constVal = parseHexOrDecimal(arg);
-          if (constVal >= 0 && constVal <= 255) {
-            isLiteral = true;
-            int sigId = getOrCreateConstantSignal(out, constVal);
-            out.constantSignalValues[sigId] = constVal;
-            inputs.push_back(sigId);
-            // Don't add to inputSymbols for literals
+      // Special handling for CTU/CTD arguments (PV)
+      if (argIdx == 0 && (type == Program::Node::CTU_ || type == Program::Node::CTD_)) {
+        if (!arg.empty() && ((arg.front() == '"' && arg.back() == '"') || (std::isdigit(arg.front())) || (arg.size() > 1 && arg.front() == '-'))) {
+          std::string valStr = arg;
+          if (valStr.front() == '"') valStr = valStr.substr(1, valStr.length() - 2);
+          try {
+            // Try to parse as int
+            int val = std::stoi(valStr);
+            node.hardcodedPresetValue = val;
+            argIdx++;
+            continue;
+          } catch (...) {
+            // If not a number, fall through to signal handling
           }
         }
-        
-        if (!isLiteral) {
-          inputSymbols.push_back(arg);
-          int sigId = getOrCreateSignal(out, arg);
+      }
+
+      argIdx++;
+      
+      // For comparators (LT, GT, EQ), check if this argument is a hex/decimal literal
+      bool isLiteral = false;
+      if (type == Program::Node::LT_ || type == Program::Node::GT_ || type == Program::Node::EQ_) {
+        int constVal = parseHexOrDecimal(arg);
+        if (constVal >= 0 && constVal <= 255) {
+          isLiteral = true;
+          int sigId = getOrCreateConstantSignal(out, log, constVal);
+          out.constantSignalValues[sigId] = constVal;
           inputs.push_back(sigId);
+          // Don't add to inputSymbols for literals
         }
-        
-        // Only add token span for non-internal signals (not _not_X_out, _ps_X_out, _ns_X_out, or _const_X)
-        if (arg.find("_not_") != 0 && arg.find("_ps_") != 0 && arg.find("_ns_") != 0 && arg.find("_const_") != 0 && !isLiteral) {
-          // Find this exact token in original argsStr using word boundaries
-          size_t pos = 0;
-          while (pos < argsStr.size()) {
-            size_t found = argsStr.find(arg, pos);
-            if (found == std::string::npos) break;
-            
-            // Check word boundaries
-            bool startOk = (found == 0 || !std::isalnum(argsStr[found - 1]));
-            bool endOk = (found + arg.size() >= argsStr.size() || 
-                         !std::isalnum(argsStr[found + arg.size()]));
-            
-            if (startOk && endOk) {
-              int col0 = static_cast<int>(argsStartInLine + found);
-              addTokenSpan(out, lineNum, col0, col0 + static_cast<int>(arg.length()), arg);
-              break;
-            }
-            pos = found + 1;
+      }
+      
+      if (!isLiteral) {
+        inputSymbols.push_back(arg);
+        int sigId = getOrCreateSignal(out, log, arg);
+        inputs.push_back(sigId);
+      }
+      
+      // Only add token span for non-internal signals (not _not_X_out, _ps_X_out, _ns_X_out, or _const_X)
+      if (arg.find("_not_") != 0 && arg.find("_ps_") != 0 && arg.find("_ns_") != 0 && arg.find("_const_") != 0 && !isLiteral && !inverted) {
+        // Find this exact token in original argsStr using word boundaries
+        size_t pos = 0;
+        while (pos < argsStr.size()) {
+          size_t found = argsStr.find(arg, pos);
+          if (found == std::string::npos) break;
+          
+          // Check word boundaries
+          bool startOk = (found == 0 || !std::isalnum(argsStr[found - 1]));
+          bool endOk = (found + arg.size() >= argsStr.size() || 
+                       !std::isalnum(argsStr[found + arg.size()]));
+          
+          if (startOk && endOk) {
+            int col0 = static_cast<int>(argsStartInLine + found);
+            addTokenSpan(out, lineNum, col0, col0 + static_cast<int>(arg.length()), arg);
+            break;
           }
+          pos = found + 1;
         }
       }
     }
+  }
 
-    // Parse outputs (comma-separated) - find with word boundaries
-    std::vector<int> outputSigs;
-    auto outputNames = split(afterArrow, ',');
-    size_t searchStart = arrowPos + 2; // Start after "->"
-    int outputIdx = 0;
-    for (const auto& outputName : outputNames) {
-      int outputSig = getOrCreateSignal(out, outputName);
-      
-      // For CTU/CTD: second output is CV (counter value) output
-      if ((type == Program::Node::CTU_ || type == Program::Node::CTD_) && outputIdx == 1) {
-        node.cvOutputSignal = outputSig;
-      } else {
-        outputSigs.push_back(outputSig);
+  // Parse outputs (comma-separated) - find with word boundaries
+  std::vector<int> outputSigs;
+  auto outputNames = split(afterArrow, ',');
+  size_t searchStart = arrowPos + 2; // Start after "->"
+  int outputIdx = 0;
+  for (const auto& outputName : outputNames) {
+    int outputSig = getOrCreateSignal(out, log, outputName);
+    
+    // For CTU/CTD: second output is CV (counter value) output
+    if ((type == Program::Node::CTU_ || type == Program::Node::CTD_) && outputIdx == 1) {
+      node.cvOutputSignal = outputSig;
+    } else {
+      outputSigs.push_back(outputSig);
+    }
+    
+    // Find this output name in the original line
+    size_t outPos = line.find(outputName, searchStart);
+    if (outPos != std::string::npos) {
+      addTokenSpan(out, lineNum, static_cast<int>(outPos), 
+                   static_cast<int>(outPos + outputName.length()), outputName);
+      searchStart = outPos + outputName.length();
+    }
+    outputIdx++;
+  }
+
+  // Create node
+  node.type = type;
+  node.name = name;
+  node.inputs = inputs;
+  node.outputs = outputSigs;
+  node.sourceLine = lineNum;
+  out.nodes.push_back(node);
+
+  return {true, ""};
+}
+
+ParseResult parseFile(const std::string& path, Program& out) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    return {false, "Could not open file: " + path};
+  }
+
+  clearProgram(out);
+
+  std::string line;
+  int lineNum = 0;
+
+  while (std::getline(file, line)) {
+    out.sourceLines.push_back(line);
+    auto res = parseLine(line, lineNum, out, nullptr);
+    if (!res.ok) {
+      return res;
+    }
+    lineNum++;
+  }
+
+  return {true, ""};
+}
+
+// Split [begin, end) into lines with the same rules as std::getline:
+// '\n' terminates a line and a trailing unterminated line is kept. The file
+// is read in binary mode, so a '\r' before the '\n' (CRLF) is dropped here.
+static void splitLines(const char* begin, const char* end, std::vector<std::string>& lines) {
+  while (begin < end) {
+    const char* nl = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+    const char* lineEnd = nl ? nl : end;
+    if (lineEnd > begin && lineEnd[-1] == '\r') {
+      lineEnd--;
+    }
+    lines.emplace_back(begin, lineEnd);
+    if (!nl) {
+      return;
+    }
+    begin = nl + 1;
+  }
+}
+
+// Turn a chunk-local internal name ("_not_\n3_out") into its global form
+// ("_not_<nodeBase + 3>_out"). Names without the marker are returned as-is.
+static std::string globalInternalName(const std::string& symbol, size_t nodeBase) {
+  size_t marker = symbol.find('\n');
+  if (marker == std::string::npos) {
+    return symbol;
+  }
+  size_t digitsEnd = marker + 1;
+  while (digitsEnd < symbol.size() && std::isdigit(static_cast<unsigned char>(symbol[digitsEnd]))) {
+    digitsEnd++;
+  }
+  size_t localIdx = std::stoul(symbol.substr(marker + 1, digitsEnd - marker - 1));
+  return symbol.substr(0, marker) + std::to_string(nodeBase + localIdx) + symbol.substr(digitsEnd);
+}
+
+template <typename Fn>
+static void runOnWorkers(size_t count, Fn fn) {
+  std::vector<std::thread> workers;
+  workers.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    workers.emplace_back(fn, i);
+  }
+  for (auto& w : workers) {
+    w.join();
+  }
+}
+
+namespace {
+struct ParseChunk {
+  const char* begin = nullptr;
+  const char* end = nullptr;
+  int firstLine = 0;
+  std::vector<std::string> lines;
+  Program prog;
+  SymbolLog log;
+  ParseResult result{true, ""};
+  size_t nodeBase = 0;
+  std::vector<int> remap;  // chunk-local signal id -> global signal id
+};
+}
+
+ParseResult parseFileParallel(const std::string& path, Program& out, unsigned numThreads) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return {false, "Could not open file: " + path};
+  }
+  std::string text;
+  file.seekg(0, std::ios::end);
+  std::streamoff size = file.tellg();
+  if (size >= 0) {
+    text.resize(static_cast<size_t>(size));
+    file.seekg(0, std::ios::beg);
+    file.read(text.data(), static_cast<std::streamsize>(text.size()));
+  } else {
+    // Not seekable (a pipe): read it as a stream
+    file.clear();
+    text.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  }
+
+  // Small files are not worth the thread start-up; below ~1 MiB per chunk
+  // the merge costs more than the parse it saves.
+  constexpr size_t kMinChunkBytes = 1 << 20;
+  size_t chunkCount = numThreads;
+  if (chunkCount == 0) {
+    chunkCount = std::max(1u, std::thread::hardware_concurrency());
+    chunkCount = std::min(chunkCount, text.size() / kMinChunkBytes);
+  }
+  chunkCount = std::max<size_t>(1, std::min(chunkCount, text.size()));
+
+  clearProgram(out);
+
+  if (chunkCount == 1) {
+    splitLines(text.data(), text.data() + text.size(), out.sourceLines);
+    for (size_t i = 0; i < out.sourceLines.size(); ++i) {
+      auto res = parseLine(out.sourceLines[i], static_cast<int>(i), out, nullptr);
+      if (!res.ok) {
+        return res;
       }
-      
-      // Find this output name in the original line
-      size_t outPos = line.find(outputName, searchStart);
-      if (outPos != std::string::npos) {
-        addTokenSpan(out, lineNum, static_cast<int>(outPos), 
-                     static_cast<int>(outPos + outputName.length()), outputName);
-        searchStart = outPos + outputName.length();
+    }
+    return {true, ""};
+  }
+
+  // Cut the buffer into chunks that each start right after a '\n'
+  std::vector<ParseChunk> chunks(chunkCount);
+  const char* cursor = text.data();
+  const char* textEnd = text.data() + text.size();
+  for (size_t i = 0; i < chunkCount; ++i) {
+    chunks[i].begin = cursor;
+    const char* target = text.data() + text.size() * (i + 1) / chunkCount;
+    if (i + 1 == chunkCount || target >= textEnd) {
+      cursor = textEnd;
+    } else {
+      cursor = std::max(cursor, target);
+      const char* nl = static_cast<const char*>(std::memchr(cursor, '\n', textEnd - cursor));
+      cursor = nl ? nl + 1 : textEnd;
+    }
+    chunks[i].end = cursor;
+  }
+
+  runOnWorkers(chunkCount, [&](size_t i) {
+    splitLines(chunks[i].begin, chunks[i].end, chunks[i].lines);
+  });
+
+  int lineBase = 0;
+  for (auto& chunk : chunks) {
+    chunk.firstLine = lineBase;
+    lineBase += static_cast<int>(chunk.lines.size());
+  }
+
+  runOnWorkers(chunkCount, [&](size_t i) {
+    auto& chunk = chunks[i];
+    for (size_t l = 0; l < chunk.lines.size(); ++l) {
+      chunk.result = parseLine(chunk.lines[l], chunk.firstLine + static_cast<int>(l), chunk.prog, &chunk.log);
+      if (!chunk.result.ok) {
+        break;
       }
-      outputIdx++;
     }
+  });
 
-    // Create node
-    node.type = type;
-    node.name = name;
-    node.inputs = inputs;
-    node.outputs = outputSigs;
-    node.sourceLine = lineNum;
-    out.nodes.push_back(node);
+  for (const auto& chunk : chunks) {
+    if (!chunk.result.ok) {
+      return chunk.result;
+    }
+  }
 
-    lineNum++;
+  // Replay every chunk's symbol journal in source order. This is the only
+  // sequential part of the merge and it touches each distinct symbol of a
+  // chunk once, not every occurrence.
+  size_t nodeBase = 0;
+  for (auto& chunk : chunks) {
+    chunk.nodeBase = nodeBase;
+    nodeBase += chunk.prog.nodes.size();
+    chunk.remap.assign(chunk.prog.symbolToSignal.size(), -1);
+    for (const auto& entry : chunk.log.entries) {
+      std::string symbol = globalInternalName(entry.symbol, chunk.nodeBase);
+      if (entry.alias) {
+        aliasSignal(out, nullptr, symbol, chunk.remap[entry.localId]);
+      } else {
+        chunk.remap[entry.localId] = getOrCreateSignal(out, nullptr, symbol);
+      }
+    }
+    for (int sigId : chunk.prog.analogSignals) {
+      out.analogSignals.insert(chunk.remap[sigId]);
+    }
+    for (const auto& [sigId, value] : chunk.prog.constantSignalValues) {
+      out.constantSignalValues[chunk.remap[sigId]] = value;
+    }
+    auto append = [](std::vector<std::string>& dst, std::vector<std::string>& src) {
+      dst.insert(dst.end(), std::make_move_iterator(src.begin()), std::make_move_iterator(src.end()));
+    };
+    append(out.inputNames, chunk.prog.inputNames);
+    append(out.outputNames, chunk.prog.outputNames);
+    append(out.analogInputNames, chunk.prog.analogInputNames);
+    append(out.analogOutputNames, chunk.prog.analogOutputNames);
+  }
+
+  runOnWorkers(chunkCount, [&](size_t i) {
+    auto& chunk = chunks[i];
+    for (auto& node : chunk.prog.nodes) {
+      for (int& s : node.inputs) s = chunk.remap[s];
+      for (int& s : node.outputs) s = chunk.remap[s];
+      if (node.cvOutputSignal >= 0) node.cvOutputSignal = chunk.remap[node.cvOutputSignal];
+      node.name = globalInternalName(node.name, chunk.nodeBase);
+    }
+  });
+
+  out.nodes.reserve(nodeBase);
+  out.sourceLines.reserve(static_cast<size_t>(lineBase));
+  for (auto& chunk : chunks) {
+    out.nodes.insert(out.nodes.end(), std::make_move_iterator(chunk.prog.nodes.begin()),
+                     std::make_move_iterator(chunk.prog.nodes.end()));
+    out.tokens.insert(out.tokens.end(), std::make_move_iterator(chunk.prog.tokens.begin()),
+                      std::make_move_iterator(chunk.prog.tokens.end()));
+    out.sourceLines.insert(out.sourceLines.end(), std::make_move_iterator(chunk.lines.begin()),
+                           std::make_move_iterator(chunk.lines.end()));
   }
 
   return {true, ""};
 }
 
+static bool isDeclarationLine(std::string line) {
+  trim(line);
+  return line.substr(0, 3) == "IN " || line.substr(0, 4) == "OUT " ||
+         line.substr(0, 4) == "AIN " || line.substr(0, 5) == "AOUT ";
+}
+
+// First index that is free for internal _not_/_ps_/_ns_ node names. After
+// incremental edits these no longer line up with node positions.
+static size_t nextInternalIndex(const Program& prog) {
+  size_t next = prog.nodes.size();
+  for (const auto& node : prog.nodes) {
+    if (node.name.empty() || node.name[0] != '_') continue;
+    if (node.name.find("_not_") != 0 && node.name.find("_ps_") != 0 && node.name.find("_ns_") != 0) continue;
+    size_t digits = node.name.find_last_not_of("0123456789");
+    if (digits == std::string::npos || digits + 1 >= node.name.size()) continue;
+    next = std::max(next, std::stoul(node.name.substr(digits + 1)) + 1);
+  }
+  return next;
+}
+
+ParseResult reparseFile(const std::string& path, Program& prog) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return {false, "Could not open file: " + path};
+  }
+  std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  std::vector<std::string> lines;
+  splitLines(text.data(), text.data() + text.size(), lines);
+
+  // Diff against the previous text: one changed window between a common
+  // prefix and a common suffix covers the usual single edit in an editor.
+  const auto& oldLines = prog.sourceLines;
+  size_t prefix = 0;
+  size_t maxCommon = std::min(oldLines.size(), lines.size());
+  while (prefix < maxCommon && oldLines[prefix] == lines[prefix]) {
+    prefix++;
+  }
+  size_t suffix = 0;
+  while (suffix < maxCommon - prefix &&
+         oldLines[oldLines.size() - 1 - suffix] == lines[lines.size() - 1 - suffix]) {
+    suffix++;
+  }
+  size_t oldEnd = oldLines.size() - suffix;
+  size_t newEnd = lines.size() - suffix;
+  if (prefix == oldEnd && prefix == newEnd) {
+    return {true, ""};
+  }
+
+  // Declarations define the I/O name lists, which are ordered and cannot be
+  // patched line by line - fall back to a full parse for those edits.
+  bool needsFullParse = false;
+  for (size_t i = prefix; i < oldEnd && !needsFullParse; ++i) needsFullParse = isDeclarationLine(oldLines[i]);
+  for (size_t i = prefix; i < newEnd && !needsFullParse; ++i) needsFullParse = isDeclarationLine(lines[i]);
+  if (needsFullParse) {
+    Program full;
+    auto res = parseFileParallel(path, full);
+    if (res.ok) {
+      prog = std::move(full);
+    }
+    return res;
+  }
+
+  Program patch;
+  SymbolLog log;
+  for (size_t i = prefix; i < newEnd; ++i) {
+    auto res = parseLine(lines[i], static_cast<int>(i), patch, &log);
+    if (!res.ok) {
+      return res;
+    }
+  }
+
+  // Resolve the patch against the live symbol table. Known symbols keep
+  // their ids, new ones are appended; symbols that are no longer referenced
+  // keep their slot until the next full parse.
+  size_t internalBase = nextInternalIndex(prog);
+  std::vector<int> remap(patch.symbolToSignal.size(), -1);
+  for (const auto& entry : log.entries) {
+    std::string symbol = globalInternalName(entry.symbol, internalBase);
+    if (entry.alias) {
+      aliasSignal(prog, nullptr, symbol, remap[entry.localId]);
+    } else {
+      remap[entry.localId] = getOrCreateSignal(prog, nullptr, symbol);
+    }
+  }
+  for (int sigId : patch.analogSignals) {
+    prog.analogSignals.insert(remap[sigId]);
+  }
+  for (const auto& [sigId, value] : patch.constantSignalValues) {
+    prog.constantSignalValues[remap[sigId]] = value;
+  }
+  for (auto& node : patch.nodes) {
+    for (int& s : node.inputs) s = remap[s];
+    for (int& s : node.outputs) s = remap[s];
+    if (node.cvOutputSignal >= 0) node.cvOutputSignal = remap[node.cvOutputSignal];
+    node.name = globalInternalName(node.name, internalBase);
+  }
+
+  // Splice nodes and tokens; both are stored in source line order
+  int lineDelta = static_cast<int>(newEnd) - static_cast<int>(oldEnd);
+  auto nodeFirst = std::lower_bound(prog.nodes.begin(), prog.nodes.end(), static_cast<int>(prefix),
+                                    [](const Program::Node& n, int line) { return n.sourceLine < line; });
+  auto nodeLast = std::lower_bound(nodeFirst, prog.nodes.end(), static_cast<int>(oldEnd),
+                                   [](const Program::Node& n, int line) { return n.sourceLine < line; });
+  for (auto it = nodeLast; it != prog.nodes.end(); ++it) {
+    it->sourceLine += lineDelta;
+  }
+  nodeFirst = prog.nodes.erase(nodeFirst, nodeLast);
+  prog.nodes.insert(nodeFirst, std::make_move_iterator(patch.nodes.begin()),
+                    std::make_move_iterator(patch.nodes.end()));
+
+  auto tokFirst = std::lower_bound(prog.tokens.begin(), prog.tokens.end(), static_cast<int>(prefix),
+                                   [](const Program::TokenSpan& t, int line) { return t.line < line; });
+  auto tokLast = std::lower_bound(tokFirst, prog.tokens.end(), static_cast<int>(oldEnd),
+                                  [](const Program::TokenSpan& t, int line) { return t.line < line; });
+  for (auto it = tokLast; it != prog.tokens.end(); ++it) {
+    it->line += lineDelta;
+  }
+  tokFirst = prog.tokens.erase(tokFirst, tokLast);
+  prog.tokens.insert(tokFirst, std::make_move_iterator(patch.tokens.begin()),
+                     std::make_move_iterator(patch.tokens.end()));
+
+  auto lineFirst = prog.sourceLines.erase(prog.sourceLines.begin() + prefix, prog.sourceLines.begin() + oldEnd);
+  prog.sourceLines.insert(lineFirst, std::make_move_iterator(lines.begin() + prefix),
+                          std::make_move_iterator(lines.begin() + newEnd));
+
+  return {true, ""};
+}
@@ -8,5 +8,13 @@ struct ParseResult {
 };
 
 ParseResult parseFile(const std::string& path, Program& out);
-bool fileWatcher(const std::string& path, Program& out);
+// Same result as parseFile (including signal ids), but the file is split into
+// line chunks that are parsed on worker threads and merged afterwards.
+// numThreads = 0 picks a chunk count from the file size and core count.
+ParseResult parseFileParallel(const std::string& path, Program& out, unsigned numThreads = 0);
+// Hot-reload variant: diffs the file against prog.sourceLines and re-parses
+// only the changed lines, patching nodes and signals in place. Unchanged
+// signals keep their ids. Edits to IN/OUT/AIN/AOUT lines fall back to a full
+// parse. On error prog is left untouched.
+ParseResult reparseFile(const std::string& path, Program& prog);
 
@@ -0,0 +1,185 @@
+#include "Replay.hpp"
+#include <cinttypes>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+// Log format, one event per line:
+//   GLLREC 1 <program path>
+//   N <id> <name>                   name table entry
+//   A <scan> <step> <seconds>       timers advanced
+//   S|M|L <scan> <step> <id> <v>    signal value, BTN momentary, BTN latch
+//   T <scan> <step> <id> <seconds>  TON/TOF preset
+//   C <scan> <step> <id> <v>        CTU/CTD preset
+//   X <scan> <step> <reason>        discontinuity, replay stops
+//   E <scan> <step>                 end of recording
+static constexpr const char* kLogMagic = "GLLREC";
+
+InputRecorder::~InputRecorder() {
+  if (file_) {
+    std::fclose(file_);
+  }
+}
+
+bool InputRecorder::open(const std::string& path, const std::string& programPath, std::string& err) {
+  file_ = std::fopen(path.c_str(), "w");
+  if (!file_) {
+    err = "cannot open '" + path + "' for writing";
+    return false;
+  }
+  nameIds_.clear();
+  std::fprintf(file_, "%s 1 %s\n", kLogMagic, programPath.c_str());
+  return true;
+}
+
+int InputRecorder::nameId_(const std::string& name) {
+  auto [it, inserted] = nameIds_.emplace(name, static_cast<int>(nameIds_.size()));
+  if (inserted) {
+    std::fprintf(file_, "N %d %s\n", it->second, name.c_str());
+  }
+  return it->second;
+}
+
+void InputRecorder::record(const Simulator& sim, const InputEvent& event) {
+  if (!file_) {
+    return;
+  }
+  unsigned long long scan = sim.scanCount();
+  unsigned steps = sim.scanSteps();
+  switch (event.kind) {
+  case InputEvent::Advance:
+    std::fprintf(file_, "A %llu %u %a\n", scan, steps, event.seconds);
+    break;
+  case InputEvent::Signal:
+  case InputEvent::Momentary:
+  case InputEvent::Latch:
+  case InputEvent::PresetCounter: {
+    char tag = event.kind == InputEvent::Signal      ? 'S'
+               : event.kind == InputEvent::Momentary ? 'M'
+               : event.kind == InputEvent::Latch     ? 'L'
+                                                     : 'C';
+    int id = nameId_(event.name);
+    std::fprintf(file_, "%c %llu %u %d %" PRIu64 "\n", tag, scan, steps, id, event.value);
+    break;
+  }
+  case InputEvent::PresetTime: {
+    int id = nameId_(event.name);
+    std::fprintf(file_, "T %llu %u %d %a\n", scan, steps, id, event.seconds);
+    break;
+  }
+  case InputEvent::Rewind:
+    std::fprintf(file_, "X %llu %u rewound to this scan\n", scan, steps);
+    break;
+  }
+}
+
+void InputRecorder::markDiscontinuity(const Simulator& sim, const std::string& reason) {
+  if (!file_) {
+    return;
+  }
+  std::fprintf(file_, "X %llu %u %s\n", static_cast<unsigned long long>(sim.scanCount()), sim.scanSteps(),
+               reason.c_str());
+}
+
+void InputRecorder::close(const Simulator& sim) {
+  if (!file_) {
+    return;
+  }
+  std::fprintf(file_, "E %llu %u\n", static_cast<unsigned long long>(sim.scanCount()), sim.scanSteps());
+  std::fclose(file_);
+  file_ = nullptr;
+}
+
+ReplayResult replayInputLog(const std::string& path, Simulator& sim) {
+  ReplayResult res{{true, ""}};
+  std::ifstream in(path);
+  if (!in.is_open()) {
+    res.result = {false, "cannot open '" + path + "'"};
+    return res;
+  }
+  std::string line;
+  if (!std::getline(in, line) || line.rfind(kLogMagic, 0) != 0) {
+    res.result = {false, "'" + path + "' is not an input recording"};
+    return res;
+  }
+
+  std::vector<std::string> names;
+  int lineNo = 1;
+  auto fail = [&](const std::string& what) {
+    res.result = {false, path + ":" + std::to_string(lineNo) + ": " + what};
+    return res;
+  };
+  auto nameOf = [&](int id) -> const std::string* {
+    return id >= 0 && id < static_cast<int>(names.size()) ? &names[id] : nullptr;
+  };
+
+  while (std::getline(in, line)) {
+    ++lineNo;
+    if (line.empty()) continue;
+    std::istringstream ls(line);
+    char tag = 0;
+    ls >> tag;
+    if (tag == 'N') {
+      int id = -1;
+      std::string name;
+      ls >> id >> name;
+      if (id != static_cast<int>(names.size()) || name.empty()) return fail("bad name entry");
+      names.push_back(name);
+      continue;
+    }
+
+    unsigned long long scan = 0;
+    unsigned steps = 0;
+    if (!(ls >> scan >> steps)) return fail("missing scan position");
+    if (scan < sim.scanCount() || (scan == sim.scanCount() && steps < sim.scanSteps())) {
+      return fail("events out of order");
+    }
+    sim.runTo(scan, steps);
+
+    if (tag == 'E') {
+      res.complete = true;
+      break;
+    }
+    if (tag == 'X') {
+      std::string reason;
+      std::getline(ls >> std::ws, reason);
+      fprintf(stderr, "Replay stops at scan %llu: %s\n", scan, reason.c_str());
+      break;
+    }
+    if (tag == 'A') {
+      std::string seconds;
+      ls >> seconds;
+      sim.advanceTime(static_cast<float>(std::strtod(seconds.c_str(), nullptr)));
+      ++res.events;
+      continue;
+    }
+
+    int id = -1;
+    std::string value;
+    ls >> id >> value;
+    const std::string* name = nameOf(id);
+    if (!name || value.empty()) return fail("bad event");
+    switch (tag) {
+    case 'S':
+      sim.setAnalogSignal(*name, std::strtoull(value.c_str(), nullptr, 10));
+      break;
+    case 'M':
+      sim.setMomentary(*name, value != "0");
+      break;
+    case 'L':
+      sim.setLatch(*name, value != "0");
+      break;
+    case 'T':
+      sim.setPresetTime(*name, static_cast<float>(std::strtod(value.c_str(), nullptr)));
+      break;
+    case 'C':
+      sim.setPresetCounterValue(*name, static_cast<int>(std::strtoll(value.c_str(), nullptr, 10)));
+      break;
+    default:
+      return fail(std::string("unknown event '") + tag + "'");
+    }
+    ++res.events;
+  }
+  return res;
+}
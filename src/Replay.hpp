@@ -0,0 +1,47 @@
+#pragma once
+#include "Parser.hpp"
+#include "Sim.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+
+// Writes every external input of a run (see InputEvent) to a text log, one
+// line per event, stamped with the scan count and the node step inside the
+// scan at which it took effect. Names are written once and then referred to
+// by number; times are hex floats so they read back bit for bit.
+class InputRecorder {
+public:
+  InputRecorder() = default;
+  ~InputRecorder();
+  InputRecorder(const InputRecorder&) = delete;
+  InputRecorder& operator=(const InputRecorder&) = delete;
+
+  bool open(const std::string& path, const std::string& programPath, std::string& err);
+  // Input observer
+  void record(const Simulator& sim, const InputEvent& event);
+  // Something replay cannot reproduce happened (e.g. a hot reload); replay
+  // stops there
+  void markDiscontinuity(const Simulator& sim, const std::string& reason);
+  // Write the final position so replay runs the trailing scans as well
+  void close(const Simulator& sim);
+
+  bool isOpen() const { return file_ != nullptr; }
+
+private:
+  FILE* file_ = nullptr;
+  std::unordered_map<std::string, int> nameIds_;
+
+  int nameId_(const std::string& name);
+};
+
+struct ReplayResult {
+  ParseResult result;
+  size_t events = 0;
+  bool complete = false; // reached the end marker, not a discontinuity
+};
+
+// Feed a log written by InputRecorder into a Simulator freshly built from the
+// same program, running scans as fast as possible. The result is the state
+// the recorded run had at the end of the log.
+ReplayResult replayInputLog(const std::string& path, Simulator& sim);
@@ -1,8 +1,9 @@
 #include "Sim.hpp"
 #include "Graph.hpp"
 #include <algorithm>
+#include <cstdio>
 
-Simulator::Simulator(const Program &p) : prog_(p)
+Simulator::Simulator(const Program &p, ScanOrder order) : prog_(p)
 {
   size_t n = prog_.symbolToSignal.size();
   cur_.assign(n, 0);
@@ -20,7 +21,12 @@ Simulator::Simulator(const Program &p) : prog_(p)
   }
 
   // Compute topological order - cycles are now handled by including all nodes
-  bool allNodesIncluded = computeTopologicalOrder(prog_, topo_);
+  bool allNodesIncluded = order != ScanOrder::Source ? computeDependencyOrder(prog_, topo_, &loops_)
+                                                     : computeTopologicalOrder(prog_, topo_);
+  if (order == ScanOrder::Settle)
+  {
+    buildSettleLoops_();
+  }
   hasCycles_ = !allNodesIncluded || topo_.size() < prog_.nodes.size();
 
   // If not all nodes included, try to include them anyway
@@ -69,14 +75,21 @@ Simulator::Simulator(const Program &p) : prog_(p)
 
 void Simulator::commitPendingInputs_()
 {
+  // Only inputs that change something are reported, so a Modbus poll
+  // writing the same values every frame does not show up
+  bool report = !inputObservers_.empty();
   for (auto const &[idx, val] : pendingMomentary_)
   {
+    if (report && momentary_[idx] != val)
+      notifyInput_({InputEvent::Momentary, prog_.nodes[idx].name, val ? 1u : 0u});
     momentary_[idx] = val;
   }
   // We don't clear pendingMomentary because UI sets it every frame while button is held
 
   for (auto const &[idx, val] : pendingLatch_)
   {
+    if (report && latch_[idx] != val)
+      notifyInput_({InputEvent::Latch, prog_.nodes[idx].name, val ? 1u : 0u});
     latch_[idx] = val;
   }
   pendingLatch_.clear();
@@ -85,12 +98,36 @@ void Simulator::commitPendingInputs_()
   {
     if (idx >= 0 && idx < static_cast<int>(cur_.size()))
     {
+      if (report && cur_[idx] != val)
+        notifyInput_({InputEvent::Signal, signalName_(idx), val});
       cur_[idx] = val;
     }
   }
   pendingSignals_.clear();
 }
 
+void Simulator::notifyInput_(const InputEvent &event)
+{
+  for (auto &observer : inputObservers_)
+  {
+    observer(*this, event);
+  }
+}
+
+const std::string &Simulator::signalName_(int sigId)
+{
+  if (signalNames_.empty())
+  {
+    signalNames_.resize(cur_.size());
+    for (const auto &[name, id] : prog_.symbolToSignal)
+    {
+      if (id >= 0 && id < static_cast<int>(signalNames_.size()))
+        signalNames_[id] = name;
+    }
+  }
+  return signalNames_[sigId];
+}
+
 void Simulator::update(float dt, float simHz, bool running, bool stepOnce)
 {
   if (topo_.empty() || topo_.size() != prog_.nodes.size())
@@ -101,68 +138,7 @@ void Simulator::update(float dt, float simHz, bool running, bool stepOnce)
   // Update timer elapsed times if running
   if (running && dt > 0.0f)
   {
-    for (const auto &node : prog_.nodes)
-    {
-      if (node.type == Program::Node::TON_)
-      {
-        // Check if input is active
-        bool inputActive = false;
-        if (!node.inputs.empty())
-        {
-          int inputSig = node.inputs[0];
-          if (inputSig >= 0 && inputSig < static_cast<int>(cur_.size()))
-          {
-            inputActive = (cur_[inputSig] != 0);
-          }
-        }
-        // TON
-        if (inputActive)
-        {
-          timerElapsedTime[node.name] += dt;
-        }
-        float epTime = timerElapsedTime[node.name];
-        if (epTime >= getPresetTime(node.name))
-        {
-          timerElapsedTime[node.name] = 0.0f;
-          setTGateStatus(node.name, true);
-        }
-        if (!inputActive && getTGateStatus(node.name))
-        {
-          // Reset
-          timerElapsedTime[node.name] = 0.0f;
-          setTGateStatus(node.name, false);
-        }
-      }
-      if (node.type == Program::Node::TOF_)
-      {
-        // Check if input is active
-        bool inputActive = false;
-        if (!node.inputs.empty())
-        {
-          int inputSig = node.inputs[0];
-          if (inputSig >= 0 && inputSig < static_cast<int>(cur_.size()))
-          {
-            inputActive = (cur_[inputSig] != 0);
-          }
-        }
-        if (inputActive)
-        {
-          timerElapsedTime[node.name] = 0.0f;
-        }
-        else if (!inputActive && getTGateStatus(node.name))
-        {
-          // TOF: input is low, status is true, timer is counting down
-          timerElapsedTime[node.name] += dt;
-        }
-        float epTime = timerElapsedTime[node.name];
-        if (epTime >= getPresetTime(node.name))
-        {
-          // TOF: timer elapsed, reset
-          timerElapsedTime[node.name] = 0.0f;
-          setTGateStatus(node.name, false);
-        }
-      }
-    }
+    advanceTimers_(dt);
   }
 
   // Manual step button - step one node at a time for visibility
@@ -170,17 +146,7 @@ void Simulator::update(float dt, float simHz, bool running, bool stepOnce)
   {
     if (!stepping_)
     {
-      // Apply pending inputs before starting new cycle
-      commitPendingInputs_();
-
-      // Start a new step cycle
-      stepping_ = true;
-      stepIdx_ = 0;
-      next_ = cur_;
-      lastVisibleLine_ = -1;
-      lastVisibleNodeIdx_ = -1;
-      curLine_ = -1; // Reset so first node sets it properly
-      prevStateAtCycleStart_ = next_;
+      beginScan_();
     }
     stepOneNode_();
     return;
@@ -204,22 +170,160 @@ void Simulator::update(float dt, float simHz, bool running, bool stepOnce)
   {
     if (!stepping_)
     {
-      // Apply pending inputs before starting new cycle
-      commitPendingInputs_();
-
-      stepping_ = true;
-      stepIdx_ = 0;
-      next_ = cur_; // Start new cycle with current state
-      lastVisibleLine_ = -1;
-      lastVisibleNodeIdx_ = -1;
-      curLine_ = -1;                  // Reset to ensure first node sets it properly
-      prevStateAtCycleStart_ = next_; // Store state at iteration start
+      beginScan_();
     }
     stepOneNode_();
     acc_ -= stepTime;
   }
 }
 
+// Start a new scan cycle: apply buffered inputs and copy the current state
+void Simulator::beginScan_()
+{
+  commitPendingInputs_();
+
+  stepping_ = true;
+  stepIdx_ = 0;
+  scanSteps_ = 0;
+  next_ = cur_; // Start new cycle with current state
+  lastVisibleLine_ = -1;
+  lastVisibleNodeIdx_ = -1;
+  curLine_ = -1;                  // Reset to ensure first node sets it properly
+  prevStateAtCycleStart_ = next_; // Store state at iteration start
+}
+
+// Advance TON/TOF elapsed times by dt seconds of virtual time
+void Simulator::advanceTimers_(float dt)
+{
+  if (!inputObservers_.empty())
+    notifyInput_({InputEvent::Advance, std::string(), 0, dt});
+  simTime_ += dt;
+  for (const auto &node : prog_.nodes)
+  {
+    int nodeIdx = static_cast<int>(&node - prog_.nodes.data());
+    if (node.type == Program::Node::TON_)
+    {
+      // Check if input is active
+      bool inputActive = false;
+      if (!node.inputs.empty())
+      {
+        int inputSig = node.inputs[0];
+        if (inputSig >= 0 && inputSig < static_cast<int>(cur_.size()))
+        {
+          inputActive = (cur_[inputSig] != 0);
+        }
+      }
+      // TON
+      if (inputActive)
+      {
+        timerElapsedTime[node.name] += dt;
+      }
+      float epTime = timerElapsedTime[node.name];
+      if (epTime >= getPresetTime(node.name))
+      {
+        timerElapsedTime[node.name] = 0.0f;
+        setTGateStatus(node.name, true);
+        if (coverage_)
+          coverage_->recordPreset(nodeIdx);
+      }
+      if (!inputActive && getTGateStatus(node.name))
+      {
+        // Reset
+        timerElapsedTime[node.name] = 0.0f;
+        setTGateStatus(node.name, false);
+      }
+    }
+    if (node.type == Program::Node::TOF_)
+    {
+      // Check if input is active
+      bool inputActive = false;
+      if (!node.inputs.empty())
+      {
+        int inputSig = node.inputs[0];
+        if (inputSig >= 0 && inputSig < static_cast<int>(cur_.size()))
+        {
+          inputActive = (cur_[inputSig] != 0);
+        }
+      }
+      if (inputActive)
+      {
+        timerElapsedTime[node.name] = 0.0f;
+      }
+      else if (!inputActive && getTGateStatus(node.name))
+      {
+        // TOF: input is low, status is true, timer is counting down
+        timerElapsedTime[node.name] += dt;
+      }
+      float epTime = timerElapsedTime[node.name];
+      if (epTime >= getPresetTime(node.name))
+      {
+        // TOF: timer elapsed, reset
+        if (coverage_ && getTGateStatus(node.name))
+          coverage_->recordPreset(nodeIdx);
+        timerElapsedTime[node.name] = 0.0f;
+        setTGateStatus(node.name, false);
+      }
+    }
+  }
+}
+
+void Simulator::runScan(float dt)
+{
+  if (!isValidTopology())
+  {
+    return;
+  }
+  // Finish a scan a previous update() left half done before starting ours
+  completeScan();
+  if (dt > 0.0f)
+  {
+    advanceTimers_(dt);
+  }
+  beginScan_();
+  completeScan();
+}
+
+void Simulator::runTo(uint64_t scan, uint32_t steps)
+{
+  if (!isValidTopology())
+  {
+    return;
+  }
+  while (scanCount_ < scan || (scanCount_ == scan && scanSteps_ < steps))
+  {
+    if (!stepping_)
+    {
+      beginScan_();
+    }
+    stepOneNode_();
+  }
+}
+
+void Simulator::advanceTime(float dt)
+{
+  if (dt > 0.0f)
+  {
+    advanceTimers_(dt);
+  }
+}
+
+void Simulator::addInputObserver(std::function<void(const Simulator &, const InputEvent &)> observer)
+{
+  inputObservers_.push_back(std::move(observer));
+}
+
+void Simulator::setCoverage(Coverage *coverage)
+{
+  coverage_ = coverage;
+  if (coverage_)
+    coverage_->begin(cur_);
+}
+
+void Simulator::addScanObserver(std::function<void(const Simulator &)> observer)
+{
+  scanObservers_.push_back(std::move(observer));
+}
+
 int Simulator::findBtnIndex(const std::string &btnName) const
 {
   for (size_t i = 0; i < prog_.nodes.size(); ++i)
@@ -255,6 +359,15 @@ void Simulator::toggleLatch(const std::string &btnName)
   }
 }
 
+void Simulator::setLatch(const std::string &btnName, bool latched)
+{
+  int idx = findBtnIndex(btnName);
+  if (idx >= 0)
+  {
+    pendingLatch_[idx] = latched;
+  }
+}
+
 bool Simulator::isButtonPressed(const std::string &btnName) const
 {
   int idx = findBtnIndex(btnName);
@@ -290,6 +403,8 @@ bool Simulator::isButtonLatched(const std::string &btnName) const
 void Simulator::setPresetTime(const std::string &gateName, float seconds)
 {
   presentTimeSeconds[gateName] = seconds;
+  if (!inputObservers_.empty())
+    notifyInput_({InputEvent::PresetTime, gateName, 0, seconds});
 }
 float Simulator::getPresetTime(const std::string &gateName)
 {
@@ -318,6 +433,8 @@ void Simulator::setTGateStatus(const std::string &gateName, bool status)
 void Simulator::setPresetCounterValue(const std::string &gateName, int value)
 {
   presetCounterValue[gateName] = value;
+  if (!inputObservers_.empty())
+    notifyInput_({InputEvent::PresetCounter, gateName, static_cast<uint64_t>(static_cast<int64_t>(value))});
 }
 
 int Simulator::getPresetCounterValue(const std::string &gateName)
@@ -391,32 +508,32 @@ void Simulator::setAnalogSignal(const std::string &signalName, uint64_t value)
 {
   auto it = prog_.symbolToSignal.find(signalName);
   if (it != prog_.symbolToSignal.end())
-  {
-    int sigId = it->second;
-    if (sigId >= 0 && sigId < static_cast<int>(cur_.size()))
-    {
-      pendingSignals_[sigId] = value;
-    }
-  }
+    setSignalById(it->second, value);
 }
 
 uint64_t Simulator::getAnalogSignalValue(const std::string &signalName) const
 {
   auto it = prog_.symbolToSignal.find(signalName);
-  if (it != prog_.symbolToSignal.end())
-  {
-    int sigId = it->second;
-    if (sigId >= 0 && sigId < static_cast<int>(cur_.size()))
-    {
-      // Return pending value if available for immediate UI feedback
-      auto itP = pendingSignals_.find(sigId);
-      if (itP != pendingSignals_.end())
-        return itP->second;
+  return it != prog_.symbolToSignal.end() ? getSignalValueById(it->second) : 0;
+}
 
-      return cur_[sigId];
-    }
+void Simulator::setSignalById(int sigId, uint64_t value)
+{
+  if (sigId >= 0 && sigId < static_cast<int>(cur_.size()))
+  {
+    pendingSignals_[sigId] = value;
   }
-  return 0;
+}
+
+uint64_t Simulator::getSignalValueById(int sigId) const
+{
+  if (sigId < 0 || sigId >= static_cast<int>(cur_.size()))
+    return 0;
+  // Return pending value if available for immediate UI feedback
+  auto itP = pendingSignals_.find(sigId);
+  if (itP != pendingSignals_.end())
+    return itP->second;
+  return cur_[sigId];
 }
 
 bool Simulator::isAnalogSignal(const std::string &signalName) const
@@ -440,9 +557,9 @@ bool Simulator::evaluateNode_(int nodeIdx)
   case Program::Node::AND_:
   {
     out = true;
-    for (int s : n.inputs)
+    for (size_t i = 0; i < n.inputs.size(); ++i)
     {
-      bool sigVal = (next_[s] != 0);
+      bool sigVal = (next_[n.inputs[i]] != 0) != n.invertedInput(i);
       out = out && sigVal;
     }
     break;
@@ -450,9 +567,9 @@ bool Simulator::evaluateNode_(int nodeIdx)
   case Program::Node::OR_:
   {
     out = false;
-    for (int s : n.inputs)
+    for (size_t i = 0; i < n.inputs.size(); ++i)
     {
-      bool sigVal = (next_[s] != 0);
+      bool sigVal = (next_[n.inputs[i]] != 0) != n.invertedInput(i);
       out = out || sigVal;
     }
     break;
@@ -460,9 +577,9 @@ bool Simulator::evaluateNode_(int nodeIdx)
   case Program::Node::XOR_:
   {
     out = false;
-    for (int s : n.inputs)
+    for (size_t i = 0; i < n.inputs.size(); ++i)
     {
-      bool sigVal = (next_[s] != 0);
+      bool sigVal = (next_[n.inputs[i]] != 0) != n.invertedInput(i);
       if (out && sigVal)
       {
         out = false;
@@ -522,8 +639,8 @@ bool Simulator::evaluateNode_(int nodeIdx)
   {
     for (int s : n.inputs)
     {
-      bool S = (next_[n.inputs[0]] != 0);
-      bool R = (next_[n.inputs[1]] != 0);
+      bool S = (next_[n.inputs[0]] != 0) != n.invertedInput(0);
+      bool R = (next_[n.inputs[1]] != 0) != n.invertedInput(1);
 
       if (S && !R)
         out = true;
@@ -535,6 +652,8 @@ bool Simulator::evaluateNode_(int nodeIdx)
       }
       else if (S && R)
         out = true;
+      if (coverage_)
+        coverage_->recordBranch(nodeIdx, S ? Coverage::Set : R ? Coverage::Reset : Coverage::Hold);
     }
     break;
   }
@@ -543,8 +662,8 @@ bool Simulator::evaluateNode_(int nodeIdx)
   {
     for (int s : n.inputs)
     {
-      bool S = (next_[n.inputs[0]] != 0);
-      bool R = (next_[n.inputs[1]] != 0);
+      bool S = (next_[n.inputs[0]] != 0) != n.invertedInput(0);
+      bool R = (next_[n.inputs[1]] != 0) != n.invertedInput(1);
 
       if (S && !R)
         out = true;
@@ -554,6 +673,8 @@ bool Simulator::evaluateNode_(int nodeIdx)
       {
         out = !n.outputs.empty() ? (next_[n.outputs[0]] != 0) : false;
       }
+      if (coverage_)
+        coverage_->recordBranch(nodeIdx, R ? Coverage::Reset : S ? Coverage::Set : Coverage::Hold);
     }
     break;
   }
@@ -680,6 +801,8 @@ bool Simulator::evaluateNode_(int nodeIdx)
     setCurrentCounterValue(n.name, cv);
     counterPrevInput[n.name] = cu;
     out = (cv >= pv);
+    if (coverage_ && out)
+      coverage_->recordPreset(nodeIdx);
     
     // If CV output signal is defined, write the counter value to it
     if (n.cvOutputSignal >= 0 && n.cvOutputSignal < static_cast<int>(next_.size()))
@@ -719,6 +842,8 @@ bool Simulator::evaluateNode_(int nodeIdx)
     setCurrentCounterValue(n.name, cv);
     counterPrevInput[n.name] = cd;
     out = (cv <= 0);
+    if (coverage_ && out)
+      coverage_->recordPreset(nodeIdx);
     
     // If CV output signal is defined, write the counter value to it
     if (n.cvOutputSignal >= 0 && n.cvOutputSignal < static_cast<int>(next_.size()))
@@ -775,6 +900,17 @@ bool Simulator::evaluateNode_(int nodeIdx)
     }
     break;
   }
+  case Program::Node::LUT_:
+  {
+    size_t index = 0;
+    for (size_t i = 0; i < n.inputs.size(); ++i)
+    {
+      if (next_[n.inputs[i]] != 0)
+        index |= size_t{1} << i;
+    }
+    out = ((n.lookupTable[index >> 6] >> (index & 63)) & 1) != 0;
+    break;
+  }
   case Program::Node::BTN:
   {
     bool m = momentary_[nodeIdx];
@@ -785,6 +921,8 @@ bool Simulator::evaluateNode_(int nodeIdx)
   default:
     break;
   }
+    if (coverage_)
+      coverage_->recordOutput(nodeIdx, out);
     for (int outputSig : n.outputs)
     {
       next_[outputSig] = out ? 1 : 0;
@@ -821,9 +959,11 @@ bool Simulator::evaluateNode_(int nodeIdx)
       // This prevents the highlight from jumping to internal nodes
     }
 
+    enterSettleLoop_(stepIdx_);
     evaluateNode_(nodeIdx);
+    ++scanSteps_;
 
-    stepIdx_++;
+    stepIdx_ = nextSettleIndex_(stepIdx_ + 1);
 
     // If we've processed all nodes, finish the step
     if (stepIdx_ >= topo_.size())
@@ -837,10 +977,18 @@ bool Simulator::evaluateNode_(int nodeIdx)
   {
     // Always commit results after one pass (standard PLC scan behavior)
     std::swap(cur_, next_);
+    if (coverage_)
+      coverage_->recordScan(cur_);
     stepping_ = false;
     stepIdx_ = 0;
+    scanSteps_ = 0;
     curLine_ = lastVisibleLine_;
     curNodeIdx_ = lastVisibleNodeIdx_;
+    ++scanCount_;
+    for (auto &observer : scanObservers_)
+    {
+      observer(*this);
+    }
   }
 
   // Full step - evaluate all nodes at once (for fast simulation)
@@ -853,9 +1001,10 @@ bool Simulator::evaluateNode_(int nodeIdx)
     lastVisibleNodeIdx_ = -1;
     next_ = cur_;
 
-    // Execute every node exactly once in program order
-    for (int nodeIdx : topo_)
+    // Execute every node once in scan order (loops may repeat in Settle mode)
+    for (size_t idx = 0; idx < topo_.size(); idx = nextSettleIndex_(idx + 1))
     {
+      int nodeIdx = topo_[idx];
       curNodeIdx_ = nodeIdx;
       const auto &node = prog_.nodes[nodeIdx];
       if (node.name.find("_not_") != 0 && node.name.find("_ps_") != 0 && node.name.find("_ns_") != 0)
@@ -864,10 +1013,446 @@ bool Simulator::evaluateNode_(int nodeIdx)
         lastVisibleLine_ = node.sourceLine;
         lastVisibleNodeIdx_ = nodeIdx;
       }
+      enterSettleLoop_(idx);
       evaluateNode_(nodeIdx);
     }
 
     std::swap(cur_, next_);
+    if (coverage_)
+      coverage_->recordScan(cur_);
     curLine_ = lastVisibleLine_;
     curNodeIdx_ = lastVisibleNodeIdx_;
+    ++scanCount_;
+    for (auto &observer : scanObservers_)
+    {
+      observer(*this);
+    }
+  }
+
+  void Simulator::completeScan()
+  {
+    while (stepping_)
+    {
+      stepOneNode_();
+    }
+  }
+
+  static bool isInternalNodeName(const std::string &name)
+  {
+    return name.rfind("_ps_", 0) == 0 || name.rfind("_ns_", 0) == 0 || name.rfind("_not_", 0) == 0;
+  }
+
+  // The parser names inline PS/NS/NOT nodes by position (_ps_3), so a reparse
+  // can give the same name to a different detector. Identify them by type and
+  // inputs instead: the user's signal names, or for the output of another
+  // internal node, that node's key.
+  static std::unordered_map<std::string, std::string> internalNodeKeys(const Program &prog)
+  {
+    std::unordered_map<std::string, std::string> keys;
+    // Alias names of a signal: the smallest one, for determinism
+    std::vector<std::string> signalNames(prog.symbolToSignal.size());
+    for (const auto &[name, sigId] : prog.symbolToSignal)
+    {
+      if (sigId < 0 || sigId >= static_cast<int>(signalNames.size()) || isInternalNodeName(name))
+        continue;
+      if (signalNames[sigId].empty() || name < signalNames[sigId])
+        signalNames[sigId] = name;
+    }
+    std::unordered_map<int, size_t> producer; // internal output signal -> node
+    for (size_t i = 0; i < prog.nodes.size(); ++i)
+    {
+      if (isInternalNodeName(prog.nodes[i].name) && !prog.nodes[i].outputs.empty())
+        producer[prog.nodes[i].outputs[0]] = i;
+    }
+    std::function<const std::string &(size_t)> key = [&](size_t i) -> const std::string &
+    {
+      const auto &node = prog.nodes[i];
+      auto [it, added] = keys.try_emplace(node.name);
+      if (!added)
+        return it->second;
+      std::string k = std::to_string(node.type) + "(";
+      for (size_t j = 0; j < node.inputs.size(); ++j)
+      {
+        int sigId = node.inputs[j];
+        auto itP = producer.find(sigId);
+        k += j ? "," : "";
+        k += itP != producer.end() ? key(itP->second)
+             : sigId >= 0 && sigId < static_cast<int>(signalNames.size()) ? signalNames[sigId]
+                                                                          : std::string("?");
+      }
+      k += ")";
+      // try_emplace's iterator may be invalidated by the recursion
+      return keys[node.name] = std::move(k);
+    };
+    for (size_t i = 0; i < prog.nodes.size(); ++i)
+    {
+      if (isInternalNodeName(prog.nodes[i].name))
+        key(i);
+    }
+    return keys;
+  }
+
+  Simulator::State Simulator::saveState() const
+  {
+    State state;
+    for (const auto &[name, sigId] : prog_.symbolToSignal)
+    {
+      if (sigId < 0 || sigId >= static_cast<int>(cur_.size()) || prog_.constantSignalValues.count(sigId))
+        continue;
+      // Buffered inputs have not been committed yet but belong to the state
+      auto itP = pendingSignals_.find(sigId);
+      state.signals[name] = itP != pendingSignals_.end() ? itP->second : cur_[sigId];
+    }
+    for (size_t i = 0; i < prog_.nodes.size(); ++i)
+    {
+      const auto &node = prog_.nodes[i];
+      state.nodeTypes[node.name] = node.type;
+      if (node.type != Program::Node::BTN)
+        continue;
+      int idx = static_cast<int>(i);
+      auto itL = pendingLatch_.find(idx);
+      if (itL != pendingLatch_.end())
+        state.latch[node.name] = itL->second;
+      else if (auto it = latch_.find(idx); it != latch_.end())
+        state.latch[node.name] = it->second;
+    }
+    state.presetTimes = presentTimeSeconds;
+    state.timerElapsed = timerElapsedTime;
+    state.timerStatus = nodeStatus;
+    state.presetCounter = presetCounterValue;
+    state.currentCounter = currentCounterValue;
+    state.counterPrevInput = counterPrevInput;
+    state.psPrevInput = psPrevInput;
+    state.nsPrevInput = nsPrevInput;
+    state.internalKeys = internalNodeKeys(prog_);
+    state.scanCount = scanCount_;
+    state.simTime = simTime_;
+    return state;
+  }
+
+  void Simulator::restoreState(const State &state)
+  {
+    // Internal nodes whose name now belongs to a different detector, and
+    // their output signals: nothing is carried over for them
+    std::unordered_map<std::string, bool> moved;
+    std::vector<bool> movedSignal(cur_.size(), false);
+    for (const auto &[name, key] : internalNodeKeys(prog_))
+    {
+      auto it = state.internalKeys.find(name);
+      if (it == state.internalKeys.end() || it->second != key)
+        moved[name] = true;
+    }
+    for (const auto &node : prog_.nodes)
+    {
+      if (!moved.count(node.name))
+        continue;
+      for (int sigId : node.outputs)
+      {
+        if (sigId >= 0 && sigId < static_cast<int>(movedSignal.size()))
+          movedSignal[sigId] = true;
+      }
+    }
+
+    for (const auto &[name, sigId] : prog_.symbolToSignal)
+    {
+      if (sigId < 0 || sigId >= static_cast<int>(cur_.size()) || prog_.constantSignalValues.count(sigId) ||
+          movedSignal[sigId])
+        continue;
+      auto it = state.signals.find(name);
+      if (it != state.signals.end())
+      {
+        cur_[sigId] = it->second;
+        next_[sigId] = it->second;
+      }
+    }
+    scanCount_ = state.scanCount;
+    simTime_ = state.simTime;
+
+    // Copies the entry for `name` if the node existed before with the same type
+    auto carry = [&](const Program::Node &node, const auto &from, auto &to)
+    {
+      if (moved.count(node.name))
+        return;
+      auto itType = state.nodeTypes.find(node.name);
+      if (itType == state.nodeTypes.end() || itType->second != node.type)
+        return;
+      auto it = from.find(node.name);
+      if (it != from.end())
+        to[node.name] = it->second;
+    };
+
+    for (size_t i = 0; i < prog_.nodes.size(); ++i)
+    {
+      const auto &node = prog_.nodes[i];
+      switch (node.type)
+      {
+      case Program::Node::TON_:
+      case Program::Node::TOF_:
+        if (node.hardcodedPresetTime <= 0.0f)
+          carry(node, state.presetTimes, presentTimeSeconds);
+        carry(node, state.timerElapsed, timerElapsedTime);
+        carry(node, state.timerStatus, nodeStatus);
+        break;
+      case Program::Node::CTU_:
+      case Program::Node::CTD_:
+        if (node.hardcodedPresetValue < 0)
+          carry(node, state.presetCounter, presetCounterValue);
+        carry(node, state.currentCounter, currentCounterValue);
+        carry(node, state.counterPrevInput, counterPrevInput);
+        break;
+      case Program::Node::PS_:
+        carry(node, state.psPrevInput, psPrevInput);
+        // No edge on the first scan for a detector that is new at this name
+        if (moved.count(node.name) && !node.inputs.empty())
+          psPrevInput[node.name] = castSignalToBool_(node.inputs[0]);
+        break;
+      case Program::Node::NS_:
+        carry(node, state.nsPrevInput, nsPrevInput);
+        if (moved.count(node.name) && !node.inputs.empty())
+          nsPrevInput[node.name] = castSignalToBool_(node.inputs[0]);
+        break;
+      case Program::Node::NOT_:
+        // A moved inline NOT's output feeds the detectors after it; give it
+        // its value now (internal nodes come before the nodes reading them)
+        if (moved.count(node.name) && !node.inputs.empty() && !node.outputs.empty())
+          cur_[node.outputs[0]] = next_[node.outputs[0]] = castSignalToBool_(node.inputs[0]) ? 0 : 1;
+        break;
+      case Program::Node::BTN:
+      {
+        // Momentary presses belong to the mouse state of the old UI and are
+        // released on reload; latches are kept.
+        std::unordered_map<std::string, bool> latched;
+        carry(node, state.latch, latched);
+        if (latched.count(node.name))
+          latch_[static_cast<int>(i)] = latched[node.name];
+        break;
+      }
+      default:
+        break;
+      }
+    }
+    prevStateAtCycleStart_ = cur_;
+  }
+
+  void Simulator::captureMemory(std::vector<double> &out) const
+  {
+    out.clear();
+    auto valueOr = [](const auto &map, const std::string &name, double fallback) -> double
+    {
+      auto it = map.find(name);
+      return it != map.end() ? static_cast<double>(it->second) : fallback;
+    };
+    for (size_t i = 0; i < prog_.nodes.size(); ++i)
+    {
+      const auto &node = prog_.nodes[i];
+      switch (node.type)
+      {
+      case Program::Node::TON_:
+      case Program::Node::TOF_:
+        out.push_back(valueOr(timerElapsedTime, node.name, 0.0));
+        out.push_back(valueOr(nodeStatus, node.name, 0.0));
+        out.push_back(valueOr(presentTimeSeconds, node.name, 3.0));
+        break;
+      case Program::Node::CTU_:
+      case Program::Node::CTD_:
+        out.push_back(valueOr(currentCounterValue, node.name, 0.0));
+        out.push_back(valueOr(counterPrevInput, node.name, 0.0));
+        out.push_back(valueOr(presetCounterValue, node.name, 0.0));
+        break;
+      case Program::Node::PS_:
+        out.push_back(valueOr(psPrevInput, node.name, 0.0));
+        break;
+      case Program::Node::NS_:
+        out.push_back(valueOr(nsPrevInput, node.name, 0.0));
+        break;
+      case Program::Node::BTN:
+      {
+        auto it = latch_.find(static_cast<int>(i));
+        out.push_back(it != latch_.end() && it->second ? 1.0 : 0.0);
+        break;
+      }
+      default:
+        break;
+      }
+    }
+  }
+
+  void Simulator::restoreScan(const std::vector<uint64_t> &signals, const std::vector<double> &memory,
+                              uint64_t scanCount, double simTime)
+  {
+    if (signals.size() == cur_.size())
+    {
+      cur_ = signals;
+    }
+    next_ = cur_;
+    prevStateAtCycleStart_ = cur_;
+    stepping_ = false;
+    stepIdx_ = 0;
+    acc_ = 0.f;
+    scanCount_ = scanCount;
+    simTime_ = simTime;
+    scanSteps_ = 0;
+    if (coverage_)
+      coverage_->begin(cur_); // a jump, not a toggle
+    if (!inputObservers_.empty())
+      notifyInput_({InputEvent::Rewind});
+
+    // Same walk as captureMemory()
+    size_t slot = 0;
+    auto next = [&]() { return slot < memory.size() ? memory[slot++] : 0.0; };
+    for (size_t i = 0; i < prog_.nodes.size(); ++i)
+    {
+      const auto &node = prog_.nodes[i];
+      switch (node.type)
+      {
+      case Program::Node::TON_:
+      case Program::Node::TOF_:
+        timerElapsedTime[node.name] = static_cast<float>(next());
+        nodeStatus[node.name] = next() != 0.0;
+        presentTimeSeconds[node.name] = static_cast<float>(next());
+        break;
+      case Program::Node::CTU_:
+      case Program::Node::CTD_:
+        currentCounterValue[node.name] = static_cast<int>(next());
+        counterPrevInput[node.name] = next() != 0.0;
+        presetCounterValue[node.name] = static_cast<int>(next());
+        break;
+      case Program::Node::PS_:
+        psPrevInput[node.name] = next() != 0.0;
+        break;
+      case Program::Node::NS_:
+        nsPrevInput[node.name] = next() != 0.0;
+        break;
+      case Program::Node::BTN:
+        latch_[static_cast<int>(i)] = next() != 0.0;
+        break;
+      default:
+        break;
+      }
+    }
+  }
+
+  // Pass limit for ScanOrder::Settle; a loop still changing after this many
+  // passes (e.g. a ring oscillator) is left as is for this scan
+  static constexpr int kMaxSettlePasses = 64;
+
+  void Simulator::buildSettleLoops_()
+  {
+    settleBeginAt_.assign(topo_.size(), -1);
+    settleEndAt_.assign(topo_.size(), -1);
+    std::vector<size_t> position(prog_.nodes.size(), 0);
+    for (size_t i = 0; i < topo_.size(); ++i)
+      position[topo_[i]] = i;
+
+    for (const auto &members : loops_)
+    {
+      SettleLoop loop;
+      loop.begin = position[members.front()];
+      loop.end = loop.begin + members.size();
+      for (int nodeIdx : members)
+      {
+        const auto &n = prog_.nodes[nodeIdx];
+        loop.writes.insert(loop.writes.end(), n.outputs.begin(), n.outputs.end());
+        if (n.cvOutputSignal >= 0)
+          loop.writes.push_back(n.cvOutputSignal);
+        switch (n.type)
+        {
+        case Program::Node::PS_:
+        case Program::Node::NS_:
+        case Program::Node::TON_:
+        case Program::Node::TOF_:
+        case Program::Node::CTU_:
+        case Program::Node::CTD_:
+          loop.stateful.push_back(n.name);
+          break;
+        default:
+          break;
+        }
+      }
+      settleBeginAt_[loop.begin] = static_cast<int>(settleLoops_.size());
+      settleEndAt_[loop.end - 1] = static_cast<int>(settleLoops_.size());
+      settleLoops_.push_back(std::move(loop));
+    }
+  }
+
+  void Simulator::enterSettleLoop_(size_t idx)
+  {
+    if (settleBeginAt_.empty() || settleBeginAt_[idx] < 0 || settlePass_ > 0)
+      return;
+    const SettleLoop &loop = settleLoops_[settleBeginAt_[idx]];
+    settleValues_.clear();
+    for (int s : loop.writes)
+      settleValues_.push_back(next_[s]);
+    settleMemory_ = NodeMemory();
+    for (const auto &name : loop.stateful)
+    {
+      auto keep = [&name](auto &live, auto &saved)
+      {
+        auto it = live.find(name);
+        if (it != live.end())
+          saved[name] = it->second;
+      };
+      keep(nodeStatus, settleMemory_.status);
+      keep(counterPrevInput, settleMemory_.counterPrev);
+      keep(psPrevInput, settleMemory_.psPrev);
+      keep(nsPrevInput, settleMemory_.nsPrev);
+      keep(timerElapsedTime, settleMemory_.elapsed);
+      keep(currentCounterValue, settleMemory_.counter);
+    }
+  }
+
+  size_t Simulator::nextSettleIndex_(size_t nextIdx)
+  {
+    if (settleEndAt_.empty() || settleEndAt_[nextIdx - 1] < 0)
+      return nextIdx;
+    SettleLoop &loop = settleLoops_[settleEndAt_[nextIdx - 1]];
+
+    bool changed = false;
+    for (size_t i = 0; i < loop.writes.size(); ++i)
+    {
+      if (next_[loop.writes[i]] != settleValues_[i])
+      {
+        changed = true;
+        settleValues_[i] = next_[loop.writes[i]];
+      }
+    }
+    if (!changed)
+    {
+      settlePass_ = 0;
+      return nextIdx;
+    }
+    if (settlePass_ + 1 >= kMaxSettlePasses)
+    {
+      settlePass_ = 0;
+      unsettledScans_++;
+      if (!loop.reported)
+      {
+        loop.reported = true;
+        const auto &first = prog_.nodes[topo_[loop.begin]];
+        fprintf(stderr, "Feedback loop at line %d (%zu nodes, starting with %s) does not settle within %d passes\n",
+                first.sourceLine + 1, loop.end - loop.begin, first.name.c_str(), kMaxSettlePasses);
+      }
+      return nextIdx;
+    }
+
+    // Run the loop again from the memory it had when the scan entered it
+    settlePass_++;
+    for (const auto &name : loop.stateful)
+    {
+      auto rollBack = [&name](auto &live, const auto &saved)
+      {
+        auto it = saved.find(name);
+        if (it != saved.end())
+          live[name] = it->second;
+        else
+          live.erase(name);
+      };
+      rollBack(nodeStatus, settleMemory_.status);
+      rollBack(counterPrevInput, settleMemory_.counterPrev);
+      rollBack(psPrevInput, settleMemory_.psPrev);
+      rollBack(nsPrevInput, settleMemory_.nsPrev);
+      rollBack(timerElapsedTime, settleMemory_.elapsed);
+      rollBack(currentCounterValue, settleMemory_.counter);
+    }
+    return loop.begin;
   }
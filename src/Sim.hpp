@@ -1,15 +1,97 @@
 #pragma once
 #include "AST.hpp"
+#include "Coverage.hpp"
+#include <functional>
 #include <vector>
 #include <unordered_map>
+#include <string>
+
+// Source: nodes run in program order and forward references see the
+// previous scan's value (PLC scan semantics, the default).
+// Dependency: nodes run after the nodes they read from, so acyclic logic
+// settles within one scan; feedback loops keep their source order.
+// Settle: like Dependency, and every feedback loop is re-evaluated within the
+// scan until its signals stop changing (bounded, see nextSettleIndex_).
+enum class ScanOrder { Source, Dependency, Settle };
+
+// An external input as it reaches the Simulator, reported to input
+// observers. Signal, Momentary and Latch are reported when a scan starts and
+// applies them; the others when they happen, possibly in the middle of a scan
+// (see Simulator::scanSteps()).
+struct InputEvent {
+  enum Kind {
+    Advance,       // timers advanced by `seconds`
+    Signal,        // signal `name` set to `value`
+    Momentary,     // BTN `name` pressed (1) or released (0)
+    Latch,         // BTN `name` latched (1) or unlatched (0)
+    PresetTime,    // TON/TOF `name` preset set to `seconds`
+    PresetCounter, // CTU/CTD `name` preset set to `value` (as int64)
+    Rewind         // state replaced by restoreScan()
+  } kind = Advance;
+  std::string name{};
+  uint64_t value = 0;
+  double seconds = 0.0;
+};
 
 struct Simulator {
-  explicit Simulator(const Program& p);
+  explicit Simulator(const Program& p, ScanOrder order = ScanOrder::Source);
   void update(float dt, float simHz, bool running, bool stepOnce);
+  // Run the rest of an in-flight slow-step cycle so the state sits on a scan boundary
+  void completeScan();
+  // One complete scan without the UI pacing: advance timers by dt seconds of
+  // virtual time, then evaluate every node (headless runs)
+  void runScan(float dt);
+  // Called after every completed scan, from the thread that runs the scan
+  void addScanObserver(std::function<void(const Simulator&)> observer);
+  // Step until scanCount() == scan and scanSteps() == steps (replay)
+  void runTo(uint64_t scan, uint32_t steps = 0);
+  // Advance timers as update() does while running, without evaluating nodes
+  void advanceTime(float dt);
+  void addInputObserver(std::function<void(const Simulator&, const InputEvent&)> observer);
+  // Collect coverage into `coverage` (built for this program) from the next
+  // scan on; nullptr stops collecting
+  void setCoverage(Coverage* coverage);
+  uint64_t scanCount() const { return scanCount_; }
+  // Nodes evaluated so far in the scan in progress, 0 between scans
+  uint32_t scanSteps() const { return scanSteps_; }
+  double simTime() const { return simTime_; } // virtual seconds the timers have advanced
+
+  // Runtime state keyed by signal and node names, so it survives a hot reload
+  // where signal ids and node indices change.
+  struct State {
+    std::unordered_map<std::string, uint64_t> signals;
+    std::unordered_map<std::string, Program::Node::Type> nodeTypes;
+    std::unordered_map<std::string, bool> latch; // by BTN name
+    std::unordered_map<std::string, float> presetTimes, timerElapsed;
+    std::unordered_map<std::string, bool> timerStatus;
+    std::unordered_map<std::string, int> presetCounter, currentCounter;
+    std::unordered_map<std::string, bool> counterPrevInput, psPrevInput, nsPrevInput;
+    // Internal _ps_N/_ns_N/_not_N node name -> what it detects (see
+    // internalNodeKeys in Sim.cpp); their numbers shift on reparse
+    std::unordered_map<std::string, std::string> internalKeys;
+    uint64_t scanCount = 0;
+    double simTime = 0.0;
+  };
+  State saveState() const;
+  // Take over everything from `state` whose signal or node still exists with
+  // the same node type. Hardcoded presets of the new program win. Internal
+  // PS/NS/NOT nodes must also read the same signals; if they do not, their
+  // edge memory starts at the current input instead.
+  void restoreState(const State& state);
+
+  // Everything besides signal values that one scan hands to the next (timer,
+  // counter and edge memory, presets, BTN latches) as a flat vector in node
+  // order. Cheap to copy and diff, but only meaningful for this Program.
+  void captureMemory(std::vector<double>& out) const;
+  // Jump to a recorded scan boundary of this Program, e.g. from ScanHistory.
+  // An in-flight slow-step cycle is abandoned; buffered inputs stay pending.
+  void restoreScan(const std::vector<uint64_t>& signals, const std::vector<double>& memory, uint64_t scanCount,
+                   double simTime);
 
   // BTN control hooks
   void setMomentary(const std::string& btnName, bool down);
   void toggleLatch(const std::string& btnName);
+  void setLatch(const std::string& btnName, bool latched);
   // Query BTN state
   bool isButtonPressed(const std::string& btnName) const;
   bool isButtonLatched(const std::string& btnName) const;
@@ -34,18 +116,55 @@ struct Simulator {
   void setAnalogSignal(const std::string& signalName, uint64_t value);
   uint64_t getAnalogSignalValue(const std::string& signalName) const;
   bool isAnalogSignal(const std::string& signalName) const;
+  // The same by signal id (Program::symbolToSignal) for callers that look
+  // names up once, like the Modbus mapping; unknown ids are ignored / read 0
+  void setSignalById(int sigId, uint64_t value);
+  uint64_t getSignalValueById(int sigId) const;
   
   const std::vector<uint64_t>& signals() const { return cur_; }
   int currentEvaluatingLine() const { return curLine_; }
   int currentEvaluatingNode() const { return curNodeIdx_; }
   bool isValidTopology() const { return !topo_.empty() && topo_.size() == prog_.nodes.size(); }
   bool isSteppingThrough() const { return stepping_; }
+  // Feedback loops found by ScanOrder::Dependency/Settle (node indices, source order)
+  const std::vector<std::vector<int>>& feedbackLoops() const { return loops_; }
+  // Scans in which a loop hit the iteration limit without settling (Settle)
+  size_t unsettledScans() const { return unsettledScans_; }
 
 private:
   const Program& prog_;
   std::vector<int> topo_;
+  std::vector<std::vector<int>> loops_;
+
+  // ScanOrder::Settle bookkeeping. Each loop occupies a contiguous range of
+  // topo_; its edge, counter and timer memory is rolled back before every
+  // repeated pass so only signal values carry over between passes.
+  struct NodeMemory {
+    std::unordered_map<std::string, bool> status, counterPrev, psPrev, nsPrev;
+    std::unordered_map<std::string, float> elapsed;
+    std::unordered_map<std::string, int> counter;
+  };
+  struct SettleLoop {
+    size_t begin = 0, end = 0;          // [begin, end) in topo_
+    std::vector<int> writes;            // signals written by the loop
+    std::vector<std::string> stateful;  // members with edge/counter/timer memory
+    bool reported = false;
+  };
+  std::vector<SettleLoop> settleLoops_;
+  std::vector<int> settleBeginAt_, settleEndAt_; // topo_ position -> loop or -1
+  int settlePass_ = 0;
+  std::vector<uint64_t> settleValues_;
+  NodeMemory settleMemory_;
+  size_t unsettledScans_ = 0;
   std::vector<uint64_t> cur_, next_;
   float acc_ = 0.f;
+  uint64_t scanCount_ = 0;
+  double simTime_ = 0.0;
+  std::vector<std::function<void(const Simulator&)>> scanObservers_;
+  uint32_t scanSteps_ = 0;
+  std::vector<std::function<void(const Simulator&, const InputEvent&)>> inputObservers_;
+  std::vector<std::string> signalNames_; // by id, built on first use
+  Coverage* coverage_ = nullptr;
   int curLine_ = -1;
   int curNodeIdx_ = -1;       // Current node being evaluated (for visualization)
   int lastVisibleLine_ = -1;  // Last non-internal node line for highlighting
@@ -70,7 +189,14 @@ private:
   void stepOnce_();           // Full step (all nodes at once)
   void stepOneNode_();        // Step single node (for visualization)
   void finishStep_();         // Finish the current step cycle
+  void beginScan_();          // Start a new step cycle
+  void advanceTimers_(float dt);
   void commitPendingInputs_(); // Apply buffered inputs at start of cycle
+  void notifyInput_(const InputEvent& event);
+  const std::string& signalName_(int sigId);
+  void buildSettleLoops_();
+  void enterSettleLoop_(size_t idx);      // before evaluating topo_[idx]
+  size_t nextSettleIndex_(size_t nextIdx); // topo_ position to continue with
   bool castSignalToBool_(int sigIdx){
     if (sigIdx < 0 || sigIdx >= static_cast<int>(next_.size())) {
         return false;
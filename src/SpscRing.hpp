@@ -0,0 +1,67 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+// Bounded lock-free queue for exactly one producer and one consumer thread.
+// push() and pop() never block or allocate; a full ring rejects the push and
+// leaves the decision (drop, retry later) to the producer. The capacity is
+// rounded up to a power of two.
+template <typename T>
+class SpscRing {
+public:
+  explicit SpscRing(size_t capacity) {
+    size_t cap = 1;
+    while (cap < capacity) {
+      cap <<= 1;
+    }
+    mask_ = cap - 1;
+    buf_ = std::make_unique<T[]>(cap);
+  }
+  SpscRing(const SpscRing&) = delete;
+  SpscRing& operator=(const SpscRing&) = delete;
+
+  size_t capacity() const { return mask_ + 1; }
+
+  // Producer side
+  bool push(const T& value) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tailCache_ > mask_) {
+      tailCache_ = tail_.load(std::memory_order_acquire);
+      if (head - tailCache_ > mask_) {
+        return false;
+      }
+    }
+    buf_[head & mask_] = value;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+  // Slots the producer can fill right now without a push failing
+  size_t freeSlots() const {
+    return capacity() - (head_.load(std::memory_order_relaxed) - tail_.load(std::memory_order_acquire));
+  }
+
+  // Consumer side
+  bool pop(T& value) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == headCache_) {
+      headCache_ = head_.load(std::memory_order_acquire);
+      if (tail == headCache_) {
+        return false;
+      }
+    }
+    value = buf_[tail & mask_];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  // Producer and consumer indices on separate cache lines, each next to the
+  // side's cached copy of the other index
+  alignas(64) std::atomic<size_t> head_{0};
+  size_t tailCache_ = 0;
+  alignas(64) std::atomic<size_t> tail_{0};
+  size_t headCache_ = 0;
+  alignas(64) std::unique_ptr<T[]> buf_;
+  size_t mask_ = 0;
+};
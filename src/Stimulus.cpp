@@ -0,0 +1,168 @@
+#include "Stimulus.hpp"
+#include "TimeUtils.hpp"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+static bool parseValue(const std::string& text, uint64_t& value) {
+  if (text.empty()) {
+    return false;
+  }
+  char* end = nullptr;
+  bool hex = text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X');
+  value = std::strtoull(hex ? text.c_str() + 2 : text.c_str(), &end, hex ? 16 : 10);
+  return end && *end == '\0';
+}
+
+// "12" is a scan number, "500ms"/"1.5s" a virtual time
+static bool isTime(const std::string& text) {
+  return !text.empty() && !std::isdigit(static_cast<unsigned char>(text.back()));
+}
+
+ParseResult parseStimulus(const std::string& path, Stimulus& out) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    return {false, "cannot open '" + path + "'"};
+  }
+  out = Stimulus{};
+  out.path = path;
+
+  struct Row {
+    std::string at;
+    Stimulus::Step step;
+  };
+  std::vector<Row> rows;
+  std::string line;
+  int lineNo = 0;
+  auto error = [&](const std::string& msg) -> ParseResult {
+    return {false, path + ":" + std::to_string(lineNo) + ": " + msg};
+  };
+
+  while (std::getline(file, line)) {
+    ++lineNo;
+    line = line.substr(0, line.find('#'));
+    std::istringstream ls(line);
+    std::string word;
+    if (!(ls >> word)) continue;
+
+    if (word == "program") {
+      std::string program;
+      ls >> program;
+      out.programPath = (std::filesystem::path(path).parent_path() / program).string();
+    } else if (word == "scan-time") {
+      std::string time;
+      ls >> time;
+      out.scanTime = parseTimeStringToFloat(time);
+      if (time.empty() || out.scanTime <= 0.0f) return error("bad scan-time");
+    } else if (word == "order") {
+      std::string order;
+      ls >> order;
+      if (order == "source") out.order = ScanOrder::Source;
+      else if (order == "dependency") out.order = ScanOrder::Dependency;
+      else if (order == "settle") out.order = ScanOrder::Settle;
+      else return error("unknown order '" + order + "'");
+    } else if (word[0] == '@') {
+      Row row;
+      row.at = word.substr(1);
+      row.step.line = lineNo;
+      bool expecting = false;
+      while (ls >> word) {
+        if (word == "expect") {
+          expecting = true;
+          continue;
+        }
+        size_t eq = word.find('=');
+        uint64_t value = 0;
+        if (eq == std::string::npos || eq == 0 || !parseValue(word.substr(eq + 1), value)) {
+          return error("expected name=value, got '" + word + "'");
+        }
+        (expecting ? row.step.expects : row.step.inputs).push_back({word.substr(0, eq), value});
+      }
+      if (row.at.empty()) return error("missing scan or time after '@'");
+      rows.push_back(std::move(row));
+    } else {
+      return error("unknown directive '" + word + "'");
+    }
+  }
+
+  if (out.programPath.empty()) {
+    for (const char* ext : {".gll", ".txt"}) {
+      auto candidate = std::filesystem::path(path).replace_extension(ext);
+      if (std::filesystem::exists(candidate)) {
+        out.programPath = candidate.string();
+        break;
+      }
+    }
+    if (out.programPath.empty()) {
+      return {false, path + ": no program with the same name next to it"};
+    }
+  }
+
+  // Scan numbers need the final scan-time; rows for the same scan merge
+  std::map<uint64_t, Stimulus::Step> byScan;
+  for (auto& row : rows) {
+    lineNo = row.step.line;
+    uint64_t scan = 0;
+    if (isTime(row.at)) {
+      double seconds = parseTimeStringToFloat(row.at);
+      scan = static_cast<uint64_t>(std::ceil(seconds / out.scanTime - 1e-6));
+    } else if (!parseValue(row.at, scan)) {
+      return error("bad scan number '" + row.at + "'");
+    }
+    auto [it, inserted] = byScan.try_emplace(scan, std::move(row.step));
+    if (!inserted) {
+      auto& step = it->second;
+      step.inputs.insert(step.inputs.end(), row.step.inputs.begin(), row.step.inputs.end());
+      step.expects.insert(step.expects.end(), row.step.expects.begin(), row.step.expects.end());
+    }
+    it->second.scan = scan;
+  }
+  for (auto& [scan, step] : byScan) {
+    out.steps.push_back(std::move(step));
+  }
+  return {true, ""};
+}
+
+ParseResult checkStimulusSignals(const Stimulus& stim, const Program& prog) {
+  for (const auto& step : stim.steps) {
+    for (const auto* list : {&step.inputs, &step.expects}) {
+      for (const auto& assign : *list) {
+        if (!prog.symbolToSignal.count(assign.name)) {
+          return {false, stim.path + ":" + std::to_string(step.line) + ": unknown signal '" + assign.name + "'"};
+        }
+      }
+    }
+  }
+  return {true, ""};
+}
+
+StimulusResult runStimulus(const Stimulus& stim, Simulator& sim) {
+  StimulusResult res;
+  for (const auto& step : stim.steps) {
+    while (sim.scanCount() + 1 < step.scan) {
+      sim.runScan(stim.scanTime);
+    }
+    for (const auto& in : step.inputs) {
+      sim.setAnalogSignal(in.name, sim.isAnalogSignal(in.name) ? in.value : (in.value != 0));
+    }
+    if (sim.scanCount() < step.scan) {
+      sim.runScan(stim.scanTime);
+    }
+    for (const auto& ex : step.expects) {
+      uint64_t actual = sim.getAnalogSignalValue(ex.name);
+      if (actual != ex.value) {
+        res.passed = false;
+        res.failScan = step.scan;
+        res.failMessage = stim.path + ":" + std::to_string(step.line) + ": " + ex.name + " expected " +
+                          std::to_string(ex.value) + ", got " + std::to_string(actual);
+        break;
+      }
+    }
+    if (!res.passed) break;
+  }
+  res.scans = sim.scanCount();
+  return res;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "Parser.hpp"
+#include "Sim.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Scripted inputs and expected values for one program, read from a sidecar
+// file next to it (AND.gll -> AND.stim):
+//
+//   # comment
+//   program AND.gll        optional, default: same name with .gll or .txt
+//   scan-time 10ms         virtual time per scan, default 10ms
+//   order settle           source (default), dependency or settle
+//   @1  a=1 b=0  expect c=0
+//   @2  b=1      expect c=1
+//   @500ms a=0   expect c=0
+//
+// "@N" is scan N (the first scan is 1, @0 is the state before any scan),
+// "@<time>" the first scan by which that much virtual time has passed.
+// Assignments before "expect" are applied right before that scan, the ones
+// after it are checked right after it. Values are 0/1 or integers for
+// analog signals ("0x" for hex).
+struct Stimulus {
+  std::string path, programPath;
+  float scanTime = 0.01f;
+  ScanOrder order = ScanOrder::Source;
+
+  struct Assign {
+    std::string name;
+    uint64_t value;
+  };
+  struct Step {
+    uint64_t scan = 0;
+    std::vector<Assign> inputs, expects;
+    int line = 0;
+  };
+  std::vector<Step> steps; // ascending scan, one per scan
+};
+
+ParseResult parseStimulus(const std::string& path, Stimulus& out);
+// Every assigned and expected name must be a signal of `prog`
+ParseResult checkStimulusSignals(const Stimulus& stim, const Program& prog);
+
+struct StimulusResult {
+  bool passed = true;
+  uint64_t scans = 0;       // scans run
+  uint64_t failScan = 0;    // first diverging scan
+  std::string failMessage;  // "<file>:<line>: c expected 1, got 0"
+};
+
+// Run the steps on `sim`, which must be built from the stimulus' program.
+// Stops at the first expectation that does not hold.
+StimulusResult runStimulus(const Stimulus& stim, Simulator& sim);
@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Lock-free exchange of the latest value between exactly one writer and one
+// reader thread. The writer fills back() and publish()es it, the reader
+// take()s the newest published value into front(). Neither side ever waits
+// for the other; values published faster than the reader takes them are
+// overwritten. Slots are reused, so the writer must set everything it
+// publishes (back() holds an older value, not the last published one).
+template <typename T>
+class TripleBuffer {
+public:
+  TripleBuffer() = default;
+  TripleBuffer(const TripleBuffer&) = delete;
+  TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+  // Same setup for all three slots, before the threads start
+  template <typename F>
+  void forEachSlot(F f) {
+    for (T& slot : slots_) {
+      f(slot);
+    }
+  }
+
+  // Writer side
+  T& back() { return slots_[back_]; }
+  void publish() {
+    uint8_t old = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel);
+    back_ = old & kIndex;
+  }
+
+  // Reader side: false if nothing was published since the last take()
+  bool take() {
+    if (!(middle_.load(std::memory_order_relaxed) & kFresh)) {
+      return false;
+    }
+    uint8_t old = middle_.exchange(front_, std::memory_order_acq_rel);
+    front_ = old & kIndex;
+    return true;
+  }
+  const T& front() const { return slots_[front_]; }
+
+private:
+  static constexpr uint8_t kIndex = 3, kFresh = 4;
+  T slots_[3];
+  // The writer's slot and the reader's slot; the third one is in between,
+  // its index and whether it is newer than front() packed into middle_
+  alignas(64) uint8_t back_ = 0;
+  alignas(64) uint8_t front_ = 1;
+  alignas(64) std::atomic<uint8_t> middle_{2};
+};
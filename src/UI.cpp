@@ -7,8 +7,8 @@
 #include <cctype>
 #include <vector>
 
-UI::UI(const Program &prog, Simulator &sim, ModbusManager &modbus)
-    : prog_(prog), sim_(sim), modbus_(modbus)
+UI::UI(const Program &prog, Simulator &sim, ModbusManager &modbus, ScanHistory &history)
+    : prog_(prog), sim_(sim), modbus_(modbus), history_(history)
 {
   loadFont();
   updateSimSpeed();
@@ -22,13 +22,29 @@ UI::UI(const Program &prog, Simulator &sim, ModbusManager &modbus)
   numOutputsInput_ = std::to_string(modbus_.getNumOutputs());
   numAnalogInputsInput_ = std::to_string(modbus_.getNumAnalogInputs());
   numAnalogOutputsInput_ = std::to_string(modbus_.getNumAnalogOutputs());
+  pollPeriodInput_ = std::to_string(modbus_.getPollPeriodMs());
   registerMode32Bit_ = (modbus_.getAnalogRegisterMode() == ModbusManager::AnalogRegisterMode::BITS_32);
+  serverMode_ = (modbus_.getMode() == ModbusManager::Mode::Server);
+  rtuTransport_ = (modbus_.getTransport() == ModbusManager::Transport::Rtu);
+  serialDeviceInput_ = modbus_.getSerialDevice();
+  baudInput_ = std::to_string(modbus_.getBaudRate());
 
   // Layout will be updated when window size is known
   // Default initialization
   updateLayout({1920, 1080});
 }
 
+void UI::carryControlState(const UI &previous)
+{
+  running_ = previous.running_;
+  repeatEnabled_ = previous.repeatEnabled_;
+  sliderValue_ = previous.sliderValue_;
+  scrollOffset_ = previous.scrollOffset_;
+  settingsOpen_ = previous.settingsOpen_;
+  updateSimSpeed();
+  wasStepping_ = sim_.isSteppingThrough();
+}
+
 void UI::loadFont()
 {
   // Potential font paths in order of preference
@@ -76,6 +92,27 @@ void UI::updateSimSpeed()
   simSpeed_ = 0.5f * std::pow(4000.0f, sliderValue_);
 }
 
+void UI::rewindTo(uint64_t scan)
+{
+  if (history_.empty())
+    return;
+  scan = std::clamp(scan, history_.oldestScan(), history_.newestScan());
+  running_ = false;
+  if (history_.restore(scan, sim_))
+  {
+    wasStepping_ = false;
+  }
+}
+
+void UI::scrubTo(float x)
+{
+  if (history_.empty())
+    return;
+  float rel = std::clamp((x - historyBar_.position.x) / historyBar_.size.x, 0.0f, 1.0f);
+  uint64_t span = history_.newestScan() - history_.oldestScan();
+  rewindTo(history_.oldestScan() + static_cast<uint64_t>(std::lround(rel * static_cast<double>(span))));
+}
+
 void UI::updateLayout(const sf::Vector2u &windowSize)
 {
   windowSize_ = windowSize;
@@ -102,6 +139,14 @@ void UI::updateLayout(const sf::Vector2u &windowSize)
   settingsBtn_ = sf::FloatRect({sidebarPadding_, currentY}, {buttonWidth, buttonHeight_});
   currentY += buttonHeight_ + buttonSpacing_;
 
+  // History: step back | scrub bar | step forward
+  float historyBtnWidth = buttonWidth * 0.15f;
+  historyBackBtn_ = sf::FloatRect({sidebarPadding_, currentY}, {historyBtnWidth, buttonHeight_});
+  historyBar_ = sf::FloatRect({sidebarPadding_ + historyBtnWidth + buttonSpacing_ * 0.5f, currentY},
+                              {buttonWidth - 2 * historyBtnWidth - buttonSpacing_, buttonHeight_});
+  historyFwdBtn_ = sf::FloatRect({sidebarPadding_ + buttonWidth - historyBtnWidth, currentY}, {historyBtnWidth, buttonHeight_});
+  currentY += buttonHeight_ + buttonSpacing_;
+
   // Speed slider
   float sliderHeight = buttonHeight_;
   speedSlider_ = sf::FloatRect({sidebarPadding_, currentY}, {buttonWidth, sliderHeight});
@@ -277,9 +322,9 @@ void UI::handleEvent(sf::RenderWindow &win, const sf::Event &ev)
         char c = static_cast<char>(textEntered->unicode);
         std::string *target = nullptr;
         if (activeInputField_ == 0)
-          target = &ipInput_;
+          target = rtuTransport_ ? &serialDeviceInput_ : &ipInput_;
         else if (activeInputField_ == 1)
-          target = &portInput_;
+          target = rtuTransport_ ? &baudInput_ : &portInput_;
         else if (activeInputField_ == 2)
           target = &slaveIdInput_;
         else if (activeInputField_ == 3)
@@ -290,6 +335,8 @@ void UI::handleEvent(sf::RenderWindow &win, const sf::Event &ev)
           target = &numAnalogInputsInput_;
         else if (activeInputField_ == 6)
           target = &numAnalogOutputsInput_;
+        else if (activeInputField_ == 7)
+          target = &pollPeriodInput_;
 
         if (target)
         {
@@ -310,12 +357,12 @@ void UI::handleEvent(sf::RenderWindow &win, const sf::Event &ev)
     {
       sf::Vector2f mousePos(static_cast<float>(mousePressed->position.x), static_cast<float>(mousePressed->position.y));
       float cardWidth = 450.0f;
-      float cardHeight = 520.0f;
+      float cardHeight = 640.0f;
       sf::Vector2f cardPos((windowSize_.x - cardWidth) / 2.0f, (windowSize_.y - cardHeight) / 2.0f);
 
-      // Check input fields (7 text fields)
+      // Check input fields (8 text fields)
       activeInputField_ = -1;
-      for (int i = 0; i < 7; ++i)
+      for (int i = 0; i < 8; ++i)
       {
         sf::FloatRect fieldRect({cardPos.x + 180, cardPos.y + 70 + i * 40 - 5}, {220, 30});
         if (isPointInRect(mousePos, fieldRect))
@@ -325,7 +372,7 @@ void UI::handleEvent(sf::RenderWindow &win, const sf::Event &ev)
       }
 
       // Check register mode toggle button
-      sf::FloatRect toggleRect({cardPos.x + 180, cardPos.y + 70 + 7 * 40 - 5}, {220, 30});
+      sf::FloatRect toggleRect({cardPos.x + 180, cardPos.y + 70 + 8 * 40 - 5}, {220, 30});
       if (isPointInRect(mousePos, toggleRect))
       {
         registerMode32Bit_ = !registerMode32Bit_;
@@ -333,25 +380,44 @@ void UI::handleEvent(sf::RenderWindow &win, const sf::Event &ev)
                                                           : ModbusManager::AnalogRegisterMode::BITS_16);
       }
 
+      // Check client/server toggle button
+      sf::FloatRect serverRect({cardPos.x + 180, cardPos.y + 70 + 9 * 40 - 5}, {220, 30});
+      if (isPointInRect(mousePos, serverRect) && !modbus_.isConnected() && !modbus_.isConnecting())
+      {
+        serverMode_ = !serverMode_;
+        modbus_.setMode(serverMode_ ? ModbusManager::Mode::Server : ModbusManager::Mode::Client);
+      }
+
+      // Check TCP/RTU toggle button
+      sf::FloatRect transportRect({cardPos.x + 180, cardPos.y + 70 + 10 * 40 - 5}, {220, 30});
+      if (isPointInRect(mousePos, transportRect) && !modbus_.isConnected() && !modbus_.isConnecting())
+      {
+        rtuTransport_ = !rtuTransport_;
+        modbus_.setTransport(rtuTransport_ ? ModbusManager::Transport::Rtu : ModbusManager::Transport::Tcp);
+      }
+
       // Connect Button
       sf::FloatRect connectBtnRect({cardPos.x + 20, cardPos.y + cardHeight - 60}, {100, 40});
       if (isPointInRect(mousePos, connectBtnRect))
       {
-        if (modbus_.isConnected())
+        if (modbus_.isConnected() || modbus_.isConnecting())
         {
           modbus_.disconnect();
         }
         else
         {
           modbus_.setIp(ipInput_);
+          modbus_.setSerialDevice(serialDeviceInput_);
           try
           {
             modbus_.setPort(std::stoi(portInput_));
+            modbus_.setBaudRate(std::stoi(baudInput_));
             modbus_.setSlaveId(std::stoi(slaveIdInput_));
             modbus_.setNumInputs(std::stoi(numInputsInput_));
             modbus_.setNumOutputs(std::stoi(numOutputsInput_));
             modbus_.setNumAnalogInputs(std::stoi(numAnalogInputsInput_));
             modbus_.setNumAnalogOutputs(std::stoi(numAnalogOutputsInput_));
+            modbus_.setPollPeriodMs(std::stoi(pollPeriodInput_));
             modbus_.setAnalogRegisterMode(registerMode32Bit_ ? ModbusManager::AnalogRegisterMode::BITS_32 
                                                               : ModbusManager::AnalogRegisterMode::BITS_16);
           }
@@ -534,6 +600,16 @@ void UI::handleEvent(sf::RenderWindow &win, const sf::Event &ev)
     {
       stepRequested_ = true;
     }
+    else if (keyPressed->code == sf::Keyboard::Key::Left)
+    {
+      // An unfinished slow-step cycle is dropped first, then whole scans
+      rewindTo(sim_.isSteppingThrough() ? sim_.scanCount() : sim_.scanCount() - 1);
+    }
+    else if (keyPressed->code == sf::Keyboard::Key::Right)
+    {
+      if (!history_.empty() && sim_.scanCount() < history_.newestScan())
+        rewindTo(sim_.scanCount() + 1);
+    }
     else if (keyPressed->code == sf::Keyboard::Key::Equal)
     {
       sliderValue_ = std::min(1.0f, sliderValue_ + 0.1f);
@@ -766,6 +842,20 @@ void UI::handleEvent(sf::RenderWindow &win, const sf::Event &ev)
     {
       settingsOpen_ = true;
     }
+    else if (isPointInRect(mousePos, historyBackBtn_))
+    {
+      rewindTo(sim_.isSteppingThrough() ? sim_.scanCount() : sim_.scanCount() - 1);
+    }
+    else if (isPointInRect(mousePos, historyFwdBtn_))
+    {
+      if (!history_.empty() && sim_.scanCount() < history_.newestScan())
+        rewindTo(sim_.scanCount() + 1);
+    }
+    else if (isPointInRect(mousePos, historyBar_))
+    {
+      scrubbing_ = true;
+      scrubTo(mousePos.x);
+    }
     else if (isPointInRect(mousePos, speedSlider_))
     {
       float relX = mousePos.x - speedSlider_.position.x;
@@ -776,6 +866,7 @@ void UI::handleEvent(sf::RenderWindow &win, const sf::Event &ev)
 
   if (auto *mouseReleased = ev.getIf<sf::Event::MouseButtonReleased>())
   {
+    scrubbing_ = false;
     if (mouseDown_ && !activeBtn_.empty())
     {
       sim_.setMomentary(activeBtn_, false);
@@ -786,6 +877,10 @@ void UI::handleEvent(sf::RenderWindow &win, const sf::Event &ev)
 
   if (auto *mouseMoved = ev.getIf<sf::Event::MouseMoved>())
   {
+    if (scrubbing_)
+    {
+      scrubTo(static_cast<float>(mouseMoved->position.x));
+    }
     if (mouseDown_)
     {
       sf::Vector2f mousePos(static_cast<float>(mouseMoved->position.x), static_cast<float>(mouseMoved->position.y));
@@ -839,6 +934,7 @@ void UI::draw(sf::RenderWindow &win)
   }
 
   drawControls(win);
+  drawHistoryControls(win);
   drawBTNWidgets(win);
   drawTimerWidgets(win);
   drawCounterWidgets(win);
@@ -1001,6 +1097,60 @@ void UI::drawControls(sf::RenderWindow &win)
   }
 }
 
+void UI::drawHistoryControls(sf::RenderWindow &win)
+{
+  if (!fontLoaded_)
+    return;
+
+  bool rewound = !history_.empty() && sim_.scanCount() < history_.newestScan();
+
+  for (const auto *rect : {&historyBackBtn_, &historyFwdBtn_})
+  {
+    sf::RectangleShape btn(rect->size);
+    btn.setPosition(rect->position);
+    btn.setFillColor(Theme::ButtonDefault);
+    win.draw(btn);
+  }
+  sf::Text backText(font_, "<", 14);
+  backText.setPosition(historyBackBtn_.position + sf::Vector2f(historyBackBtn_.size.x * 0.5f - 4, 10));
+  backText.setFillColor(Theme::TextDefault);
+  win.draw(backText);
+  sf::Text fwdText(font_, ">", 14);
+  fwdText.setPosition(historyFwdBtn_.position + sf::Vector2f(historyFwdBtn_.size.x * 0.5f - 4, 10));
+  fwdText.setFillColor(Theme::TextDefault);
+  win.draw(fwdText);
+
+  sf::RectangleShape barBg(historyBar_.size);
+  barBg.setPosition(historyBar_.position);
+  barBg.setFillColor(rewound ? sf::Color(120, 100, 40, 200) : Theme::ButtonDefault);
+  win.draw(barBg);
+
+  std::string label = "History: empty";
+  if (!history_.empty())
+  {
+    uint64_t oldest = history_.oldestScan();
+    uint64_t newest = history_.newestScan();
+    uint64_t scan = std::clamp(sim_.scanCount(), oldest, newest);
+    float rel = newest > oldest ? static_cast<float>(scan - oldest) / static_cast<float>(newest - oldest) : 1.0f;
+    sf::RectangleShape marker(sf::Vector2f(4, historyBar_.size.y));
+    marker.setPosition(sf::Vector2f(historyBar_.position.x + rel * (historyBar_.size.x - 4), historyBar_.position.y));
+    marker.setFillColor(Theme::TextDefault);
+    win.draw(marker);
+
+    char buf[64];
+    if (rewound)
+      snprintf(buf, sizeof(buf), "Scan %llu (-%llu) [</>]", static_cast<unsigned long long>(sim_.scanCount()),
+               static_cast<unsigned long long>(newest - sim_.scanCount()));
+    else
+      snprintf(buf, sizeof(buf), "Scan %llu [</>]", static_cast<unsigned long long>(sim_.scanCount()));
+    label = buf;
+  }
+  sf::Text historyText(font_, label, 12);
+  historyText.setPosition(historyBar_.position + sf::Vector2f(8, 12));
+  historyText.setFillColor(Theme::TextDefault);
+  win.draw(historyText);
+}
+
 void UI::drawText(sf::RenderWindow &win)
 {
   if (!fontLoaded_)
@@ -1070,6 +1220,21 @@ void UI::drawLineHighlight(sf::RenderWindow &win)
     return;
   }
 
+  // A lookup-table node stands for several gates; mark all of their lines
+  int curNode = sim_.currentEvaluatingNode();
+  if (curNode >= 0 && curNode < static_cast<int>(prog_.nodes.size()))
+  {
+    for (int line : prog_.nodes[curNode].coveredLines)
+    {
+      if (line == curLine || line < 0 || line >= static_cast<int>(prog_.sourceLines.size()))
+        continue;
+      sf::RectangleShape covered(sf::Vector2f(contentAreaWidth_ - 40.0f, Theme::LineHeight));
+      covered.setPosition(sf::Vector2f(textStartX_, textStartY_ + line * Theme::LineHeight));
+      covered.setFillColor(sf::Color(80, 120, 180, 50));
+      win.draw(covered);
+    }
+  }
+
   float y = textStartY_ + curLine * Theme::LineHeight;
 
   // Draw highlight bar behind the line
@@ -1340,7 +1505,7 @@ void UI::drawSettingsPopup(sf::RenderWindow &win)
 
   // Popup card
   float cardWidth = 450.0f;
-  float cardHeight = 520.0f;
+  float cardHeight = 640.0f;
   sf::Vector2f cardPos((windowSize_.x - cardWidth) / 2.0f, (windowSize_.y - cardHeight) / 2.0f);
 
   sf::RectangleShape card(sf::Vector2f(cardWidth, cardHeight));
@@ -1350,7 +1515,7 @@ void UI::drawSettingsPopup(sf::RenderWindow &win)
   card.setOutlineThickness(2);
   win.draw(card);
 
-  sf::Text title(font_, "Modbus TCP Settings", 20);
+  sf::Text title(font_, "Modbus Settings", 20);
   title.setPosition(cardPos + sf::Vector2f(20, 20));
   title.setFillColor(Theme::TextDefault);
   win.draw(title);
@@ -1378,13 +1543,22 @@ void UI::drawSettingsPopup(sf::RenderWindow &win)
     currentY += 40;
   };
 
-  drawInput("IP Address:", ipInput_, 0);
-  drawInput("Port:", portInput_, 1);
+  if (rtuTransport_)
+  {
+    drawInput("Serial Device:", serialDeviceInput_, 0);
+    drawInput("Baud Rate:", baudInput_, 1);
+  }
+  else
+  {
+    drawInput("IP Address:", ipInput_, 0);
+    drawInput("Port:", portInput_, 1);
+  }
   drawInput("Slave ID:", slaveIdInput_, 2);
   drawInput("Digital Inputs:", numInputsInput_, 3);
   drawInput("Digital Outputs:", numOutputsInput_, 4);
   drawInput("Analog Inputs:", numAnalogInputsInput_, 5);
   drawInput("Analog Outputs:", numAnalogOutputsInput_, 6);
+  drawInput("Poll Period (ms):", pollPeriodInput_, 7);
 
   // Register Mode toggle
   sf::Text modeLabel(font_, "Register Mode:", 14);
@@ -1405,32 +1579,91 @@ void UI::drawSettingsPopup(sf::RenderWindow &win)
   modeValue.setFillColor(sf::Color::White);
   win.draw(modeValue);
 
+  currentY += 40;
+
+  // Client/Server toggle
+  sf::Text roleLabel(font_, "Role:", 14);
+  roleLabel.setPosition({cardPos.x + 20, currentY});
+  roleLabel.setFillColor(Theme::TextDefault);
+  win.draw(roleLabel);
+
+  sf::RectangleShape roleBg(sf::Vector2f(220, 30));
+  roleBg.setPosition({cardPos.x + 180, currentY - 5});
+  roleBg.setFillColor(serverMode_ ? sf::Color(80, 100, 60) : sf::Color(60, 80, 100));
+  roleBg.setOutlineColor(sf::Color(100, 100, 110));
+  roleBg.setOutlineThickness(1);
+  win.draw(roleBg);
+
+  sf::Text roleValue(font_, serverMode_ ? "Server (listen on IP)" : "Client (poll device)", 14);
+  roleValue.setPosition({cardPos.x + 190, currentY});
+  roleValue.setFillColor(sf::Color::White);
+  win.draw(roleValue);
+
+  currentY += 40;
+
+  // TCP/RTU toggle; parity, data/stop bits and frame delay are set in
+  // modbus_config.txt
+  sf::Text transportLabel(font_, "Transport:", 14);
+  transportLabel.setPosition({cardPos.x + 20, currentY});
+  transportLabel.setFillColor(Theme::TextDefault);
+  win.draw(transportLabel);
+
+  sf::RectangleShape transportBg(sf::Vector2f(220, 30));
+  transportBg.setPosition({cardPos.x + 180, currentY - 5});
+  transportBg.setFillColor(rtuTransport_ ? sf::Color(80, 100, 60) : sf::Color(60, 80, 100));
+  transportBg.setOutlineColor(sf::Color(100, 100, 110));
+  transportBg.setOutlineThickness(1);
+  win.draw(transportBg);
+
+  std::string transportText = "TCP";
+  if (rtuTransport_)
+    transportText = std::string("RTU ") + std::to_string(modbus_.getDataBits()) + modbus_.getParity() +
+                    std::to_string(modbus_.getStopBits());
+  sf::Text transportValue(font_, transportText, 14);
+  transportValue.setPosition({cardPos.x + 190, currentY});
+  transportValue.setFillColor(sf::Color::White);
+  win.draw(transportValue);
+
   currentY += 50;
 
   // Status message
-  if (!modbus_.getLastError().empty())
+  std::string lastError = modbus_.getLastError();
+  if (!lastError.empty())
   {
-    sf::Text err(font_, modbus_.getLastError(), 12);
+    sf::Text err(font_, lastError, 12);
     err.setPosition({cardPos.x + 20, currentY});
     err.setFillColor(Theme::TextRed);
     win.draw(err);
   }
   else if (modbus_.isConnected())
   {
-    sf::Text status(font_, "Connected", 12);
+    std::string statusText = "Connected";
+    if (modbus_.getEndpoints().size() > 1)
+      statusText += " to " + std::to_string(modbus_.getEndpoints().size()) + " endpoints";
+    if (modbus_.getMode() == ModbusManager::Mode::Server)
+      statusText = "Listening, " + std::to_string(modbus_.getClientCount()) + " client(s)";
+    sf::Text status(font_, statusText, 12);
     status.setPosition({cardPos.x + 20, currentY});
     status.setFillColor(Theme::TextGreen);
     win.draw(status);
   }
+  else if (modbus_.isConnecting())
+  {
+    sf::Text status(font_, "Connecting...", 12);
+    status.setPosition({cardPos.x + 20, currentY});
+    status.setFillColor(Theme::TextYellow);
+    win.draw(status);
+  }
 
   // Connect/Disconnect Button
+  bool active = modbus_.isConnected() || modbus_.isConnecting();
   float btnY = cardPos.y + cardHeight - 60;
   sf::RectangleShape btn(sf::Vector2f(100, 40));
   btn.setPosition({cardPos.x + 20, btnY});
-  btn.setFillColor(modbus_.isConnected() ? Theme::ErrorColor : Theme::ButtonRunning);
+  btn.setFillColor(active ? Theme::ErrorColor : Theme::ButtonRunning);
   win.draw(btn);
 
-  sf::Text btnText(font_, modbus_.isConnected() ? "Disconnect" : "Connect", 14);
+  sf::Text btnText(font_, serverMode_ ? (active ? "Stop" : "Start") : (active ? "Disconnect" : "Connect"), 14);
   btnText.setPosition({cardPos.x + 30, btnY + 10});
   btnText.setFillColor(sf::Color::White);
   win.draw(btnText);
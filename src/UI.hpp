@@ -2,18 +2,21 @@
 #include "Sim.hpp"
 #include "Theme.hpp"
 #include "ModbusManager.hpp"
+#include "History.hpp"
 #include <SFML/Graphics.hpp>
 #include <string>
 #include <unordered_map>
 
 struct UI
 {
-  UI(const Program &prog, Simulator &sim, ModbusManager &modbus);
+  UI(const Program &prog, Simulator &sim, ModbusManager &modbus, ScanHistory &history);
 
   void handleEvent(sf::RenderWindow &win, const sf::Event &ev);
   void update(float dt);
   void draw(sf::RenderWindow &win);
   void updateLayout(const sf::Vector2u &windowSize);
+  // Take over run/speed/scroll state from the UI being replaced on hot reload
+  void carryControlState(const UI &previous);
 
   float simSpeed() const { return simSpeed_; }
   bool isRunning() const { return running_; }
@@ -28,6 +31,7 @@ private:
   const Program &prog_;
   Simulator &sim_;
   ModbusManager &modbus_;
+  ScanHistory &history_;
 
   sf::Font font_;
   bool fontLoaded_ = false;
@@ -47,8 +51,13 @@ private:
   std::string numOutputsInput_;
   std::string numAnalogInputsInput_;
   std::string numAnalogOutputsInput_;
+  std::string pollPeriodInput_;
   bool registerMode32Bit_ = false;
-  int activeInputField_ = -1; // 0=IP, 1=Port, 2=SlaveID, 3=NumInputs, 4=NumOutputs, 5=AnalogInputs, 6=AnalogOutputs
+  bool serverMode_ = false;
+  bool rtuTransport_ = false;
+  std::string serialDeviceInput_;
+  std::string baudInput_;
+  int activeInputField_ = -1; // 0=IP/Device, 1=Port/Baud, 2=SlaveID, 3=NumInputs, 4=NumOutputs, 5=AnalogInputs, 6=AnalogOutputs, 7=PollPeriod
 
   // Mouse state
   bool mouseDown_ = false;
@@ -69,6 +78,10 @@ private:
   sf::FloatRect playRepeatBtn_;
   sf::FloatRect stepBtn_;
   sf::FloatRect settingsBtn_;
+  sf::FloatRect historyBackBtn_;
+  sf::FloatRect historyBar_;
+  sf::FloatRect historyFwdBtn_;
+  bool scrubbing_ = false; // dragging on historyBar_
   sf::FloatRect speedSlider_;
   float sliderValue_ = 0.5f; // 0.0 = 0.1x, 1.0 = 10x
   float buttonHeight_ = 40.0f;
@@ -100,6 +113,9 @@ private:
 
   void loadFont();
   void updateSimSpeed();
+  void rewindTo(uint64_t scan); // pauses and shows a recorded scan
+  void scrubTo(float x);
+  void drawHistoryControls(sf::RenderWindow &win);
   void drawText(sf::RenderWindow &win);
   void drawControls(sf::RenderWindow &win);
   void drawSettingsPopup(sf::RenderWindow &win);
@@ -0,0 +1,264 @@
+#include "Vcd.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <unordered_set>
+
+static bool isInternalName(const std::string& name) {
+  return name.rfind("_not_", 0) == 0 || name.rfind("_ps_", 0) == 0 || name.rfind("_ns_", 0) == 0 ||
+         name.rfind("_bdd_", 0) == 0;
+}
+
+// Shortest identifier codes first: "!", "\"", ... "~", "!!", ...
+static std::string vcdCode(size_t index) {
+  std::string code;
+  do {
+    code += static_cast<char>('!' + index % 94);
+    index /= 94;
+  } while (index > 0);
+  return code;
+}
+
+bool VcdWriter::selectSignals(const Program& prog, const std::string& spec, std::vector<std::string>& names,
+                              std::string& err) {
+  names.clear();
+  if (spec.empty() || spec == "io") {
+    for (const auto* list : {&prog.inputNames, &prog.outputNames, &prog.analogInputNames, &prog.analogOutputNames}) {
+      names.insert(names.end(), list->begin(), list->end());
+    }
+  } else if (spec == "all") {
+    std::vector<std::pair<int, std::string>> byId;
+    for (const auto& [name, sigId] : prog.symbolToSignal) {
+      if (!isInternalName(name) && !prog.constantSignalValues.count(sigId)) {
+        byId.emplace_back(sigId, name);
+      }
+    }
+    std::sort(byId.begin(), byId.end());
+    for (auto& [sigId, name] : byId) {
+      names.push_back(std::move(name));
+    }
+  } else {
+    size_t pos = 0;
+    while (pos <= spec.size()) {
+      size_t comma = spec.find(',', pos);
+      if (comma == std::string::npos) comma = spec.size();
+      std::string item = spec.substr(pos, comma - pos);
+      pos = comma + 1;
+      if (item.empty()) continue;
+      if (item.back() == '*') {
+        std::string prefix = item.substr(0, item.size() - 1);
+        std::vector<std::pair<int, std::string>> byId;
+        for (const auto& [name, sigId] : prog.symbolToSignal) {
+          if (name.rfind(prefix, 0) == 0 && !isInternalName(name) && !prog.constantSignalValues.count(sigId)) {
+            byId.emplace_back(sigId, name);
+          }
+        }
+        std::sort(byId.begin(), byId.end());
+        for (auto& [sigId, name] : byId) {
+          names.push_back(std::move(name));
+        }
+      } else if (prog.symbolToSignal.count(item)) {
+        names.push_back(item);
+      } else {
+        err = "unknown signal '" + item + "'";
+        return false;
+      }
+    }
+  }
+  // Keep the first occurrence of names listed twice
+  std::unordered_set<std::string> seen;
+  std::erase_if(names, [&](const std::string& name) { return !seen.insert(name).second; });
+  if (names.empty()) {
+    err = "no signals selected by '" + spec + "'";
+    return false;
+  }
+  return true;
+}
+
+VcdWriter::~VcdWriter() {
+  close();
+}
+
+bool VcdWriter::open(const std::string& path, const Program& prog, std::vector<std::string> names,
+                     std::string& err) {
+  close();
+  file_ = std::fopen(path.c_str(), "wb");
+  if (!file_) {
+    err = "cannot open '" + path + "' for writing";
+    return false;
+  }
+  names_ = std::move(names);
+  codes_.clear();
+  for (size_t i = 0; i < names_.size(); ++i) {
+    codes_.push_back(vcdCode(i));
+  }
+  bind(prog);
+  analog_.assign(names_.size(), false);
+  std::unordered_set<int> cvOutputs;
+  for (const auto& node : prog.nodes) {
+    if (node.cvOutputSignal >= 0) cvOutputs.insert(node.cvOutputSignal);
+  }
+  for (size_t i = 0; i < names_.size(); ++i) {
+    int sigId = sigIds_[i];
+    analog_[i] = sigId >= 0 && (prog.analogSignals.count(sigId) || cvOutputs.count(sigId));
+  }
+
+  std::time_t now = std::time(nullptr);
+  char date[64];
+  std::strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", std::localtime(&now));
+  std::fprintf(file_, "$date %s $end\n$version GLLSimulator $end\n$timescale 1us $end\n$scope module gll $end\n",
+               date);
+  for (size_t i = 0; i < names_.size(); ++i) {
+    std::fprintf(file_, "$var wire %d %s %s $end\n", analog_[i] ? 64 : 1, codes_[i].c_str(), names_[i].c_str());
+  }
+  std::fprintf(file_, "$upscope $end\n$enddefinitions $end\n");
+
+  // Room for a full dump plus the changes of a few busy scans
+  ring_ = std::make_unique<SpscRing<Change>>(std::max<size_t>(size_t{1} << 16, names_.size() * 4));
+  resync_ = true;
+  lastTime_ = 0;
+  stamped_ = false;
+  droppedScans_ = droppedSinceGap_ = 0;
+  stop_ = false;
+  thread_ = std::thread(&VcdWriter::run_, this);
+  return true;
+}
+
+void VcdWriter::bind(const Program& prog) {
+  sigIds_.assign(names_.size(), -1);
+  for (size_t i = 0; i < names_.size(); ++i) {
+    auto it = prog.symbolToSignal.find(names_[i]);
+    if (it != prog.symbolToSignal.end()) {
+      sigIds_[i] = it->second;
+    }
+  }
+}
+
+void VcdWriter::record(const Simulator& sim) {
+  if (!file_) {
+    return;
+  }
+  // Scans without virtual time in between (manual steps, several scans in
+  // one frame) are spread 1 us apart so each stays visible in the viewer
+  uint64_t time = static_cast<uint64_t>(std::llround(sim.simTime() * 1e6));
+  if (stamped_) {
+    time = std::max(time, lastTime_ + 1);
+  }
+  lastTime_ = time;
+  stamped_ = true;
+
+  const auto& sig = sim.signals();
+  auto valueOf = [&](size_t i) -> uint64_t {
+    int sigId = sigIds_[i];
+    if (sigId < 0 || sigId >= static_cast<int>(sig.size())) return last_[i];
+    return analog_[i] ? sig[sigId] : (sig[sigId] != 0);
+  };
+
+  if (resync_) {
+    if (ring_->freeSlots() < names_.size() + 1) {
+      ++droppedScans_;
+      ++droppedSinceGap_;
+      return;
+    }
+    if (droppedSinceGap_ > 0) {
+      ring_->push({time, kGap, droppedSinceGap_});
+      droppedSinceGap_ = 0;
+    }
+    last_.resize(names_.size(), 0);
+    for (size_t i = 0; i < names_.size(); ++i) {
+      last_[i] = valueOf(i);
+      ring_->push({time, static_cast<uint32_t>(i), last_[i]});
+    }
+    resync_ = false;
+    return;
+  }
+
+  for (size_t i = 0; i < names_.size(); ++i) {
+    uint64_t value = valueOf(i);
+    if (value == last_[i]) continue;
+    if (!ring_->push({time, static_cast<uint32_t>(i), value})) {
+      // Writer is behind: lose the rest of this scan and re-dump later
+      ++droppedScans_;
+      ++droppedSinceGap_;
+      resync_ = true;
+      return;
+    }
+    last_[i] = value;
+  }
+}
+
+void VcdWriter::close() {
+  if (!file_) {
+    return;
+  }
+  stop_ = true;
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  std::fclose(file_);
+  file_ = nullptr;
+  if (droppedScans_ > 0) {
+    fprintf(stderr, "VCD: writer fell behind, %llu scan(s) were not recorded\n",
+            static_cast<unsigned long long>(droppedScans_));
+  }
+}
+
+void VcdWriter::run_() {
+  std::string out;
+  uint64_t time = 0;
+  bool haveTime = false;
+  auto drain = [&] {
+    Change c;
+    bool any = false;
+    while (ring_->pop(c)) {
+      any = true;
+      if (!haveTime || c.time != time) {
+        time = c.time;
+        haveTime = true;
+        out += '#';
+        out += std::to_string(time);
+        out += '\n';
+      }
+      if (c.var == kGap) {
+        out += "$comment " + std::to_string(c.value) + " scan(s) dropped $end\n";
+        continue;
+      }
+      if (analog_[c.var]) {
+        out += 'b';
+        int bit = 63;
+        while (bit > 0 && !((c.value >> bit) & 1)) --bit;
+        for (; bit >= 0; --bit) {
+          out += ((c.value >> bit) & 1) ? '1' : '0';
+        }
+        out += ' ';
+      } else {
+        out += c.value ? '1' : '0';
+      }
+      out += codes_[c.var];
+      out += '\n';
+      if (out.size() >= (size_t{1} << 16)) {
+        std::fwrite(out.data(), 1, out.size(), file_);
+        out.clear();
+      }
+    }
+    return any;
+  };
+
+  while (true) {
+    if (!drain()) {
+      if (stop_.load(std::memory_order_acquire)) {
+        // The producer stopped before setting stop_; take what it left
+        drain();
+        break;
+      }
+      if (!out.empty()) {
+        std::fwrite(out.data(), 1, out.size(), file_);
+        out.clear();
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+  }
+  std::fwrite(out.data(), 1, out.size(), file_);
+  std::fflush(file_);
+}
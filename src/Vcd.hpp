@@ -0,0 +1,69 @@
+#pragma once
+#include "AST.hpp"
+#include "Sim.hpp"
+#include "SpscRing.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Streams signal changes to a Value Change Dump file for waveform viewers
+// (GTKWave, Surfer, ...). record() runs on the scan thread after every scan;
+// it only compares values and pushes the changes into a lock-free ring, and a
+// background thread formats and writes the file. If the writer falls behind,
+// changes are dropped instead of stalling the scan: the trace gets a comment
+// at the gap and every recorded signal is dumped again once there is room.
+class VcdWriter {
+public:
+  VcdWriter() = default;
+  ~VcdWriter();
+  VcdWriter(const VcdWriter&) = delete;
+  VcdWriter& operator=(const VcdWriter&) = delete;
+
+  // Resolve a signal set: "io" (declared IN/OUT/AIN/AOUT), "all" (every named
+  // signal except literals and the internal _not_/_ps_/_ns_/_bdd_ ones) or a
+  // comma separated list of names, where a trailing '*' matches a prefix
+  static bool selectSignals(const Program& prog, const std::string& spec, std::vector<std::string>& names,
+                            std::string& err);
+
+  // Write the header for `names` and start the writer thread. Analog
+  // signals and counter CV outputs are declared as 64-bit vectors.
+  bool open(const std::string& path, const Program& prog, std::vector<std::string> names, std::string& err);
+  // Re-resolve the names after a hot reload; a name the new program lacks
+  // keeps its last value in the trace
+  void bind(const Program& prog);
+  // Queue the changes since the previous scan, stamped with sim.simTime()
+  void record(const Simulator& sim);
+  // Write out everything queued and close the file
+  void close();
+
+  bool isOpen() const { return file_ != nullptr; }
+  uint64_t droppedScans() const { return droppedScans_; }
+
+private:
+  struct Change {
+    uint64_t time; // microseconds
+    uint32_t var;  // index into names_, or kGap
+    uint64_t value;
+  };
+  static constexpr uint32_t kGap = UINT32_MAX; // value = scans dropped
+
+  FILE* file_ = nullptr;
+  std::vector<std::string> names_, codes_;
+  std::vector<bool> analog_;    // declared width, fixed by the header
+  std::vector<int> sigIds_;     // current program's signal id per name, -1 = gone
+  std::vector<uint64_t> last_;  // last value queued per name
+  bool resync_ = true;          // next record() dumps every signal
+  uint64_t lastTime_ = 0;
+  bool stamped_ = false;
+  uint64_t droppedScans_ = 0, droppedSinceGap_ = 0;
+
+  std::unique_ptr<SpscRing<Change>> ring_; // sized in open() to hold a full dump
+  std::atomic<bool> stop_{false};
+  std::thread thread_;
+
+  void run_();
+};
@@ -1,28 +1,178 @@
 #include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <chrono>
 #include <cstdio>
 #include <iostream>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
 #include <vector>
 #include "Parser.hpp"
+#include "Graph.hpp"
+#include "Optimizer.hpp"
 #include "Sim.hpp"
 #include "UI.hpp"
 #include "ModbusManager.hpp"
+#include "FileWatcher.hpp"
+#include "HotReload.hpp"
+#include "Vcd.hpp"
+#include "History.hpp"
+#include "Replay.hpp"
+#include "Coverage.hpp"
 
 int main(int argc, char** argv) {
-  if (argc < 2) {
-    printf("Usage: GLLSimulator <program.txt>\n");
+  LoadOptions options;
+  const char* fPath = nullptr;
+  const char* vcdPath = nullptr;
+  std::string vcdSignals = "io";
+  long headlessScans = -1;  // >= 0: run this many scans without a window
+  float scanTime = 0.01f;   // virtual seconds per headless scan
+  long historyScans = 10000;  // scans kept for rewinding, 0 = off
+  const char* recordPath = nullptr;
+  const char* replayPath = nullptr;  // replay headless instead of opening a window
+  const char* coveragePath = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    if (std::string(argv[i]) == "--optimize") {
+      options.optimize = true;
+    } else if (std::string(argv[i]) == "--minimize") {
+      // BDD minimization on top of --optimize
+      options.optimize = true;
+      options.bddMinimize = true;
+    } else if (std::string(argv[i]) == "--dependency-order") {
+      options.order = ScanOrder::Dependency;
+    } else if (std::string(argv[i]) == "--settle-loops") {
+      options.order = ScanOrder::Settle;
+    } else if (std::string(argv[i]) == "--vcd" && i + 1 < argc) {
+      vcdPath = argv[++i];
+    } else if (std::string(argv[i]) == "--vcd-signals" && i + 1 < argc) {
+      vcdSignals = argv[++i];
+    } else if (std::string(argv[i]) == "--headless" && i + 1 < argc) {
+      headlessScans = std::strtol(argv[++i], nullptr, 10);
+    } else if (std::string(argv[i]) == "--scan-time" && i + 1 < argc) {
+      scanTime = std::strtof(argv[++i], nullptr) / 1000.0f;
+    } else if (std::string(argv[i]) == "--record" && i + 1 < argc) {
+      recordPath = argv[++i];
+    } else if (std::string(argv[i]) == "--replay" && i + 1 < argc) {
+      replayPath = argv[++i];
+    } else if (std::string(argv[i]) == "--coverage" && i + 1 < argc) {
+      coveragePath = argv[++i];
+    } else if (std::string(argv[i]) == "--history" && i + 1 < argc) {
+      historyScans = std::max(0L, std::strtol(argv[++i], nullptr, 10));
+    } else {
+      fPath = argv[i];
+    }
+  }
+  if (!fPath) {
+    printf("Usage: GLLSimulator [--optimize | --minimize] [--dependency-order | --settle-loops]\n"
+           "                    [--vcd <trace.vcd> [--vcd-signals io|all|<name,prefix*,...>]]\n"
+           "                    [--headless <scans> [--scan-time <ms>] | --replay <inputs.log>]\n"
+           "                    [--record <inputs.log>] [--history <scans>] [--coverage <report.txt>]\n"
+           "                    <program.txt>\n");
     return 1;
   }
 
-  auto prog = std::make_unique<Program>();
-  const char* fPath = argv[1];
-  prog->lastModifiedAt = std::filesystem::last_write_time(fPath);
-  auto res = parseFile(argv[1], *prog);
+  auto prog = std::make_shared<Program>();
+  auto res = parseFileParallel(fPath, *prog);
   if (!res.ok) {
     fprintf(stderr, "Parse error: %s\n", res.msg.c_str());
     return 1;
   }
-  auto sim = std::make_unique<Simulator>(*prog);
+  if (options.optimize) {
+    if (options.order != ScanOrder::Source) {
+      sortNodesByDependencies(*prog);
+    }
+    auto stats = optimizeProgram(*prog, options.bddMinimize);
+    if (options.bddMinimize) {
+      printf("BDD minimization: %zu -> %zu gates (%zu cones rewritten, %zu merged)\n",
+             stats.bddGatesBefore, stats.bddGatesAfter, stats.bddRewritten, stats.bddMerged);
+    }
+    printf("Optimized: %zu -> %zu nodes (%zu folded, %zu removed, %zu merged, %zu NOT absorbed, %zu tables)\n",
+           stats.nodesBefore, stats.nodesAfter, stats.folded, stats.removed, stats.merged, stats.absorbed,
+           stats.tables);
+  }
+  auto sim = std::make_unique<Simulator>(*prog, options.order);
+  if (!sim->feedbackLoops().empty()) {
+    printf("Dependency order: %zu feedback loop(s) %s\n", sim->feedbackLoops().size(),
+           options.order == ScanOrder::Settle ? "are iterated until they settle" : "keep their source order");
+  }
+
+  VcdWriter vcd;
+  if (vcdPath) {
+    std::vector<std::string> names;
+    std::string err;
+    if (!VcdWriter::selectSignals(*prog, vcdSignals, names, err) || !vcd.open(vcdPath, *prog, names, err)) {
+      fprintf(stderr, "VCD: %s\n", err.c_str());
+      return 1;
+    }
+    printf("Recording %zu signal(s) to %s\n", names.size(), vcdPath);
+    sim->addScanObserver([&vcd](const Simulator& s) { vcd.record(s); });
+  }
+
+  InputRecorder recorder;
+  if (recordPath) {
+    std::string err;
+    if (!recorder.open(recordPath, fPath, err)) {
+      fprintf(stderr, "Record: %s\n", err.c_str());
+      return 1;
+    }
+    sim->addInputObserver([&recorder](const Simulator& s, const InputEvent& e) { recorder.record(s, e); });
+  }
+
+  // Coverage of the program as last loaded, written on exit
+  std::unique_ptr<Coverage> coverage;
+  if (coveragePath) {
+    coverage = std::make_unique<Coverage>(*prog);
+    sim->setCoverage(coverage.get());
+  }
+  auto writeCoverage = [&] {
+    if (!coverage) return;
+    FILE* file = std::fopen(coveragePath, "w");
+    if (!file) {
+      fprintf(stderr, "Coverage: cannot open '%s' for writing\n", coveragePath);
+      return;
+    }
+    std::fputs(coverage->report(fPath).c_str(), file);
+    std::fclose(file);
+  };
+
+  if (replayPath) {
+    auto start = std::chrono::steady_clock::now();
+    auto replay = replayInputLog(replayPath, *sim);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    recorder.close(*sim);
+    writeCoverage();
+    if (!replay.result.ok) {
+      fprintf(stderr, "Replay failed: %s\n", replay.result.msg.c_str());
+      return 1;
+    }
+    printf("Replayed %zu input(s) over %llu scans (%.3f s virtual) in %.3f s%s\n", replay.events,
+           static_cast<unsigned long long>(sim->scanCount()), sim->simTime(), seconds,
+           replay.complete ? "" : " (stopped early)");
+    for (const auto& name : prog->outputNames) {
+      printf("  %s = %d\n", name.c_str(), sim->getSignalValue(name) ? 1 : 0);
+    }
+    for (const auto& name : prog->analogOutputNames) {
+      printf("  %s = %llu\n", name.c_str(), static_cast<unsigned long long>(sim->getAnalogSignalValue(name)));
+    }
+    return 0;
+  }
+
+  if (headlessScans >= 0) {
+    auto start = std::chrono::steady_clock::now();
+    for (long scan = 0; scan < headlessScans; ++scan) {
+      sim->runScan(scanTime);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("Ran %ld scans (%.3f s virtual) in %.3f s\n", headlessScans, sim->simTime(), seconds);
+    recorder.close(*sim);
+    writeCoverage();
+    return 0;
+  }
+
   auto modbus = std::make_unique<ModbusManager>();
+  modbus->bind(*prog);
+  ScanHistory history(static_cast<size_t>(historyScans));
+  sim->addScanObserver([&history](const Simulator& s) { history.record(s); });
   
   // Create fullscreen window (borderless)
   auto fsModes = sf::VideoMode::getFullscreenModes();
@@ -30,24 +180,51 @@ int main(int argc, char** argv) {
   win.setView(sf::View(sf::FloatRect({0.f, 0.f}, {static_cast<float>(win.getSize().x), static_cast<float>(win.getSize().y)})));
   win.setFramerateLimit(60);
   win.setTitle("GLL - " + std::filesystem::path(fPath).filename().string());
-  auto ui = std::make_unique<UI>(*prog, *sim, *modbus);
+  auto ui = std::make_unique<UI>(*prog, *sim, *modbus, history);
   ui->updateLayout(win.getSize());
 
+  FileWatcher watcher({fPath});
+  HotReloader reloader(fPath, options);
+
   sf::Clock clock;
   while (win.isOpen()) {
-    if (fileWatcher(fPath, *prog)) {
-      Program tmpProg;
-      if (parseFile(fPath, tmpProg).ok) {
-        // Successfully parsed new changes - hot reloading now
-        tmpProg.lastModifiedAt = std::filesystem::last_write_time(fPath);
-        *prog = std::move(tmpProg);
-        // recreate sim and ui to make sure sizes match
-        sim = std::make_unique<Simulator>(*prog);
-        ui = std::make_unique<UI>(*prog, *sim, *modbus);
+    // Parsing and Simulator construction happen on the reloader's worker;
+    // the current program keeps running until the new one is ready
+    if (watcher.consumeChange()) {
+      reloader.request(prog);
+    }
+    if (auto build = reloader.take()) {
+      if (build->result.ok) {
+        // Swap at a scan boundary and carry the running state over
+        sim->completeScan();
+        build->sim->restoreState(sim->saveState());
+        auto newUi = std::make_unique<UI>(*build->prog, *build->sim, *modbus, history);
+        newUi->carryControlState(*ui);
+        ui = std::move(newUi);
+        sim = std::move(build->sim);
+        prog = std::move(build->prog);
+        modbus->bind(*prog);
+        if (vcd.isOpen()) {
+          vcd.bind(*prog);
+          sim->addScanObserver([&vcd](const Simulator& s) { vcd.record(s); });
+        }
+        // Recorded scans refer to the old signal ids
+        history.clear();
+        sim->addScanObserver([&history](const Simulator& s) { history.record(s); });
+        if (recorder.isOpen()) {
+          recorder.markDiscontinuity(*sim, "program reloaded");
+          sim->addInputObserver([&recorder](const Simulator& s, const InputEvent& e) { recorder.record(s, e); });
+        }
+        if (coverage) {
+          coverage = std::make_unique<Coverage>(*prog);
+          sim->setCoverage(coverage.get());
+        }
 
         ui->updateLayout(win.getSize());
         win.setTitle("GLL - " + std::filesystem::path(fPath).filename().string());
         printf("Hot-Reload complete\n");
+      } else {
+        fprintf(stderr, "Hot-Reload failed: %s\n", build->result.msg.c_str());
       }
     }
     for (auto event = win.pollEvent(); event.has_value(); event = win.pollEvent()) {
@@ -71,5 +248,7 @@ int main(int argc, char** argv) {
     win.display();
   }
 
+  recorder.close(*sim);
+  writeCoverage();
   return 0;
 }
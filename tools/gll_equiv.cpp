@@ -0,0 +1,375 @@
+// Equivalence checker: drives two programs with the same IN/AIN names with
+// identical input sequences and compares their OUT/AOUT values after every
+// scan. Short sequences are enumerated exhaustively when the input space is
+// small, then random sequences run 64 to a BitSim across a thread pool.
+// The first difference is replayed on Simulator and printed as a trace.
+#include "BitSim.hpp"
+#include "Graph.hpp"
+#include "Optimizer.hpp"
+#include "Parser.hpp"
+#include "Sim.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+static constexpr int kLanes = BitSim::kLanes;
+static constexpr int kExhaustiveBits = 20; // inputs x scans enumerated at most
+
+struct Options {
+  ScanOrder order = ScanOrder::Source;
+  int depth = 512;          // scans per random sequence
+  uint64_t sequences = 16384;
+  float scanTime = 0.01f;
+  uint64_t seed = 1;
+  uint64_t analogMax = 255;
+  unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+};
+
+// Signals both programs are compared on, by name, with ids in each program
+struct Port {
+  std::string name;
+  int a, b;
+  bool analog;
+};
+
+struct Pair {
+  const Program& a;
+  const Program& b;
+  std::vector<Port> inputs, outputs;
+};
+
+static uint64_t splitmix64(uint64_t& x) {
+  uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+static bool matchPorts(const Program& a, const Program& b, const std::vector<std::string>& namesA,
+                       const std::vector<std::string>& namesB, bool analog, const char* kind,
+                       std::vector<Port>& out) {
+  std::vector<std::string> sa = namesA, sb = namesB;
+  std::sort(sa.begin(), sa.end());
+  std::sort(sb.begin(), sb.end());
+  if (sa != sb) {
+    fprintf(stderr, "%s names differ between the programs\n", kind);
+    return false;
+  }
+  for (const auto& name : sa) {
+    out.push_back({name, a.symbolToSignal.at(name), b.symbolToSignal.at(name), analog});
+  }
+  return true;
+}
+
+// Input words of one batch: inputs[scan * inputCount + i], lane values for
+// analog inputs in values[(scan * inputCount + i) * 64 + lane]
+struct Batch {
+  std::vector<uint64_t> bits, values;
+};
+
+static void exhaustiveBatch(const Pair& pair, int depth, uint64_t batch, Batch& in) {
+  size_t n = pair.inputs.size();
+  in.bits.assign(depth * n, 0);
+  for (int lane = 0; lane < kLanes; ++lane) {
+    uint64_t sequence = batch * kLanes + lane;
+    for (size_t k = 0; k < depth * n; ++k) {
+      in.bits[k] |= ((sequence >> k) & 1) << lane;
+    }
+  }
+}
+
+// Each lane flips its inputs with its own probability, 1/2 down to 1/256 per
+// scan, so some sequences toggle fast and others hold long enough for timers
+static void randomBatch(const Pair& pair, const Options& opt, uint64_t batch, Batch& in) {
+  size_t n = pair.inputs.size();
+  uint64_t rng = opt.seed * 0x2545F4914F6CDD1Dull + batch;
+  in.bits.assign(opt.depth * n, 0);
+  in.values.assign(opt.depth * n * kLanes, 0);
+  uint64_t laneRate[8] = {};
+  for (int lane = 0; lane < kLanes; ++lane) {
+    laneRate[lane % 8] |= uint64_t{1} << lane;
+  }
+  for (int scan = 0; scan < opt.depth; ++scan) {
+    for (size_t i = 0; i < n; ++i) {
+      size_t k = scan * n + i;
+      uint64_t flip = 0, all = ~uint64_t{0};
+      for (int rate = 0; rate < 8; ++rate) {
+        all &= splitmix64(rng);
+        flip |= all & laneRate[rate];
+      }
+      uint64_t prev = scan == 0 ? splitmix64(rng) : in.bits[k - n];
+      if (!pair.inputs[i].analog) {
+        in.bits[k] = scan == 0 ? prev : prev ^ flip;
+        continue;
+      }
+      for (int lane = 0; lane < kLanes; ++lane) {
+        uint64_t& value = in.values[k * kLanes + lane];
+        if (scan == 0 || ((flip >> lane) & 1)) {
+          value = splitmix64(rng) % (opt.analogMax + 1);
+        } else {
+          value = in.values[(k - n) * kLanes + lane];
+        }
+        if (value != 0) in.bits[k] |= uint64_t{1} << lane;
+      }
+    }
+  }
+}
+
+// Run one batch on both programs; returns the first scan (1-based) with a
+// difference and its lowest lane, or 0
+static int runBatch(const Pair& pair, BitSim& simA, BitSim& simB, const Batch& in, int depth, float scanTime,
+                    int& lane) {
+  size_t n = pair.inputs.size();
+  simA.reset();
+  simB.reset();
+  for (int scan = 0; scan < depth; ++scan) {
+    for (size_t i = 0; i < n; ++i) {
+      const Port& port = pair.inputs[i];
+      size_t k = scan * n + i;
+      if (port.analog && !in.values.empty()) {
+        for (int l = 0; l < kLanes; ++l) {
+          simA.setValue(port.a, l, in.values[k * kLanes + l]);
+          simB.setValue(port.b, l, in.values[k * kLanes + l]);
+        }
+      } else {
+        simA.setBits(port.a, in.bits[k]);
+        simB.setBits(port.b, in.bits[k]);
+      }
+    }
+    simA.scan(scanTime);
+    simB.scan(scanTime);
+    uint64_t diff = 0;
+    for (const Port& port : pair.outputs) {
+      if (!simA.hasValues(port.a) && !simB.hasValues(port.b)) {
+        diff |= simA.bits(port.a) ^ simB.bits(port.b);
+        continue;
+      }
+      for (int l = 0; l < kLanes; ++l) {
+        if (simA.value(port.a, l) != simB.value(port.b, l)) diff |= uint64_t{1} << l;
+      }
+    }
+    if (diff) {
+      lane = std::countr_zero(diff);
+      return scan + 1;
+    }
+  }
+  return 0;
+}
+
+struct Counterexample {
+  uint64_t batch = UINT64_MAX;
+  int lane = 0, scan = 0;
+  Batch inputs;
+};
+
+// Run batches [0, batches) on a thread pool. The reported counterexample is
+// the one in the lowest batch, whatever the thread count.
+static Counterexample search(const Pair& pair, const Options& opt, uint64_t batches, int depth,
+                             void (*make)(const Pair&, const Options&, int, uint64_t, Batch&)) {
+  Counterexample found;
+  std::mutex foundMutex;
+  std::atomic<uint64_t> nextBatch{0}, firstFail{UINT64_MAX};
+  std::vector<std::thread> pool;
+  for (unsigned t = 0; t < std::min<uint64_t>(opt.jobs, batches); ++t) {
+    pool.emplace_back([&] {
+      BitSim simA(pair.a, opt.order), simB(pair.b, opt.order);
+      Batch in;
+      for (uint64_t b = nextBatch++; b < batches && b < firstFail; b = nextBatch++) {
+        make(pair, opt, depth, b, in);
+        int lane = 0;
+        int scan = runBatch(pair, simA, simB, in, depth, opt.scanTime, lane);
+        if (scan == 0) continue;
+        std::lock_guard<std::mutex> lock(foundMutex);
+        if (b < found.batch) {
+          found = {b, lane, scan, in};
+          firstFail = b;
+        }
+      }
+    });
+  }
+  for (auto& thread : pool) {
+    thread.join();
+  }
+  return found;
+}
+
+static std::string valueList(const Simulator& sim, const std::vector<Port>& ports) {
+  std::string text;
+  for (const Port& port : ports) {
+    text += " " + port.name + "=" + std::to_string(sim.getAnalogSignalValue(port.name));
+  }
+  return text;
+}
+
+// Replay the counterexample lane on Simulator and print the scans where its
+// inputs change, up to the first difference. Returns false if Simulator does not reproduce the difference.
+static bool printTrace(const Pair& pair, const Options& opt, const Counterexample& cex) {
+  Simulator simA(pair.a, opt.order), simB(pair.b, opt.order);
+  size_t n = pair.inputs.size();
+  bool differs = false;
+  std::string prevInputs;
+  for (int scan = 0; scan < cex.scan; ++scan) {
+    std::string inputs;
+    for (size_t i = 0; i < n; ++i) {
+      const Port& port = pair.inputs[i];
+      size_t k = scan * n + i;
+      uint64_t value = port.analog && !cex.inputs.values.empty() ? cex.inputs.values[k * kLanes + cex.lane]
+                                                                 : (cex.inputs.bits[k] >> cex.lane) & 1;
+      simA.setAnalogSignal(port.name, value);
+      simB.setAnalogSignal(port.name, value);
+      inputs += " " + port.name + "=" + std::to_string(value);
+    }
+    simA.runScan(opt.scanTime);
+    simB.runScan(opt.scanTime);
+    std::string diverging;
+    for (const Port& port : pair.outputs) {
+      if (simA.getAnalogSignalValue(port.name) != simB.getAnalogSignalValue(port.name)) {
+        diverging += " " + port.name;
+      }
+    }
+    bool last = !diverging.empty() || scan + 1 == cex.scan;
+    if (inputs != prevInputs || last) {
+      printf("  scan %d:%s\n", scan + 1, inputs.c_str());
+      prevInputs = inputs;
+    }
+    if (last) {
+      printf("    A:%s\n    B:%s\n", valueList(simA, pair.outputs).c_str(),
+             valueList(simB, pair.outputs).c_str());
+    }
+    if (!diverging.empty()) {
+      printf("    differs:%s\n", diverging.c_str());
+      differs = true;
+      break;
+    }
+  }
+  return differs;
+}
+
+static void makeExhaustive(const Pair& pair, const Options&, int depth, uint64_t batch, Batch& in) {
+  exhaustiveBatch(pair, depth, batch, in);
+}
+
+static void makeRandom(const Pair& pair, const Options& opt, int, uint64_t batch, Batch& in) {
+  randomBatch(pair, opt, batch, in);
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  bool optimize = false, bdd = false;
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "-j" && hasValue) {
+      opt.jobs = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--order" && hasValue) {
+      std::string order = argv[++i];
+      if (order == "settle") {
+        fprintf(stderr, "Settle order is not supported\n");
+        return 2;
+      }
+      if (order != "source" && order != "dependency") {
+        fprintf(stderr, "Unknown order '%s'\n", order.c_str());
+        return 2;
+      }
+      opt.order = order == "dependency" ? ScanOrder::Dependency : ScanOrder::Source;
+    } else if (arg == "--depth" && hasValue) {
+      opt.depth = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--sequences" && hasValue) {
+      opt.sequences = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--scan-time" && hasValue) {
+      opt.scanTime = std::max(0.001f, static_cast<float>(std::atof(argv[++i])) / 1000.0f);
+    } else if (arg == "--seed" && hasValue) {
+      opt.seed = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--analog-max" && hasValue) {
+      opt.analogMax = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--optimize") {
+      optimize = true;
+    } else if (arg == "--bdd") {
+      optimize = bdd = true;
+    } else {
+      files.push_back(arg);
+    }
+  }
+  if (files.size() != 2) {
+    printf("Usage: gll_equiv [-j <threads>] [--order source|dependency] [--depth <scans>]\n"
+           "                 [--sequences <n>] [--scan-time <ms>] [--seed <n>] [--analog-max <n>]\n"
+           "                 [--optimize | --bdd] <a.gll> <b.gll>\n"
+           "--optimize/--bdd optimize the second program first, so a program can be\n"
+           "checked against its optimized self.\n");
+    return 2;
+  }
+
+  Program progA, progB;
+  for (auto [path, prog] : {std::pair{files[0], &progA}, std::pair{files[1], &progB}}) {
+    ParseResult res = parseFile(path, *prog);
+    if (!res.ok) {
+      fprintf(stderr, "%s: %s\n", path.c_str(), res.msg.c_str());
+      return 2;
+    }
+  }
+  if (optimize) {
+    if (opt.order != ScanOrder::Source) {
+      sortNodesByDependencies(progB);
+    }
+    optimizeProgram(progB, bdd);
+  }
+
+  Pair pair{progA, progB, {}, {}};
+  if (!matchPorts(progA, progB, progA.inputNames, progB.inputNames, false, "IN", pair.inputs) ||
+      !matchPorts(progA, progB, progA.analogInputNames, progB.analogInputNames, true, "AIN", pair.inputs) ||
+      !matchPorts(progA, progB, progA.outputNames, progB.outputNames, false, "OUT", pair.outputs) ||
+      !matchPorts(progA, progB, progA.analogOutputNames, progB.analogOutputNames, true, "AOUT", pair.outputs)) {
+    return 2;
+  }
+  size_t n = pair.inputs.size();
+  bool analogInputs = !progA.analogInputNames.empty();
+
+  auto start = std::chrono::steady_clock::now();
+  Counterexample cex;
+  std::string covered;
+
+  // All sequences of the longest depth that still fits the enumeration
+  int exhaustiveDepth = n == 0 ? opt.depth : std::min<int>(opt.depth, kExhaustiveBits / static_cast<int>(n));
+  if (!analogInputs && exhaustiveDepth > 0) {
+    int bits = static_cast<int>(n) * exhaustiveDepth;
+    uint64_t batches = bits <= 6 ? 1 : uint64_t{1} << (bits - 6);
+    cex = search(pair, opt, batches, exhaustiveDepth, makeExhaustive);
+    if (cex.batch == UINT64_MAX) {
+      covered = "all input sequences of " + std::to_string(exhaustiveDepth) + " scan(s)";
+    } else {
+      printf("NOT EQUIVALENT: difference after scan %d of input sequence %llu\n", cex.scan,
+             static_cast<unsigned long long>(cex.batch * kLanes + cex.lane));
+    }
+  }
+  if (cex.batch == UINT64_MAX && n > 0 && opt.sequences > 0) {
+    uint64_t batches = (opt.sequences + kLanes - 1) / kLanes;
+    cex = search(pair, opt, batches, opt.depth, makeRandom);
+    if (cex.batch == UINT64_MAX) {
+      covered += (covered.empty() ? "" : " and ") + std::to_string(batches * kLanes) + " random sequences of " +
+                 std::to_string(opt.depth) + " scans";
+    } else {
+      printf("NOT EQUIVALENT: difference after scan %d of random sequence %llu (seed %llu)\n", cex.scan,
+             static_cast<unsigned long long>(cex.batch * kLanes + cex.lane),
+             static_cast<unsigned long long>(opt.seed));
+    }
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  if (cex.batch != UINT64_MAX) {
+    if (!printTrace(pair, opt, cex)) {
+      printf("  (Simulator does not reproduce the difference; this is a BitSim bug)\n");
+    }
+    printf("%.3f s\n", seconds);
+    return 1;
+  }
+  printf("EQUIVALENT on %s (%.3f s)\n", covered.c_str(), seconds);
+  return 0;
+}
@@ -0,0 +1,266 @@
+// Stuck-at fault simulator: runs the .stim files of each program with every
+// signal stuck at 0 and at 1 and reports which faults change an OUT/AOUT
+// value. Each fault gets its own lane of a BitSim, lane 0 runs fault free
+// as the reference, so 63 faults are simulated per pass; passes are spread
+// over a thread pool.
+#include "BitSim.hpp"
+#include "Parser.hpp"
+#include "Stimulus.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static constexpr int kLanes = BitSim::kLanes;
+static constexpr int kFaultsPerPass = kLanes - 1; // lane 0 is the reference
+
+struct Fault {
+  int sig;
+  bool stuckAt1;
+};
+
+// One program with the stimulus files that exercise it
+struct Target {
+  std::string programPath;
+  Program prog;
+  std::vector<Stimulus> stimuli;
+  std::vector<std::string> signalNames; // by id
+  std::vector<Fault> faults;
+  std::vector<bool> detected;           // by fault
+  std::vector<std::string> warnings;
+};
+
+static bool isAnalog(const Program& prog, int sig) {
+  return prog.analogSignals.count(sig) > 0;
+}
+
+// Lanes whose outputs differ from lane 0 after the last scan
+static uint64_t outputDiff(const Target& target, const BitSim& sim) {
+  uint64_t diff = 0;
+  auto check = [&](const std::vector<std::string>& names) {
+    for (const auto& name : names) {
+      int sig = target.prog.symbolToSignal.at(name);
+      if (!sim.hasValues(sig)) {
+        uint64_t bits = sim.bits(sig);
+        diff |= bits ^ (0 - (bits & 1));
+        continue;
+      }
+      uint64_t reference = sim.value(sig, 0);
+      for (int lane = 1; lane < kLanes; ++lane) {
+        if (sim.value(sig, lane) != reference) diff |= uint64_t{1} << lane;
+      }
+    }
+  };
+  check(target.prog.outputNames);
+  check(target.prog.analogOutputNames);
+  return diff;
+}
+
+// Lanes 1..count get faults[first..first+count); returns the lanes whose
+// outputs differed from the reference in any scan of any stimulus
+static uint64_t runPass(Target& target, size_t first, size_t count, std::string& warning) {
+  uint64_t lanes = count >= kFaultsPerPass ? ~uint64_t{1} : ((uint64_t{1} << count) - 1) << 1;
+  std::map<int, std::pair<uint64_t, uint64_t>> stuck; // sig -> stuck-at-0/1 lanes
+  for (size_t i = 0; i < count; ++i) {
+    const Fault& fault = target.faults[first + i];
+    auto& masks = stuck[fault.sig];
+    (fault.stuckAt1 ? masks.second : masks.first) |= uint64_t{1} << (i + 1);
+  }
+
+  uint64_t detected = 0;
+  for (const auto& stim : target.stimuli) {
+    BitSim sim(target.prog, stim.order);
+    if (!sim.supported()) {
+      warning = stim.path + ": settle order is not supported, skipped";
+      continue;
+    }
+    for (const auto& [sig, masks] : stuck) {
+      sim.setStuck(sig, masks.first, masks.second);
+    }
+    sim.reset();
+    for (const auto& step : stim.steps) {
+      while (sim.scanCount() + 1 < step.scan) {
+        sim.scan(stim.scanTime);
+        detected |= outputDiff(target, sim);
+      }
+      for (const auto& in : step.inputs) {
+        int sig = target.prog.symbolToSignal.at(in.name);
+        if (isAnalog(target.prog, sig)) {
+          for (int lane = 0; lane < kLanes; ++lane) {
+            sim.setValue(sig, lane, in.value);
+          }
+        } else {
+          sim.setBits(sig, in.value != 0 ? ~uint64_t{0} : 0);
+        }
+      }
+      if (sim.scanCount() < step.scan) {
+        sim.scan(stim.scanTime);
+        detected |= outputDiff(target, sim);
+      }
+      for (const auto& ex : step.expects) {
+        uint64_t actual = sim.value(target.prog.symbolToSignal.at(ex.name), 0);
+        if (actual != ex.value && warning.empty()) {
+          warning = stim.path + ":" + std::to_string(step.line) + ": fails without faults (" + ex.name +
+                    " expected " + std::to_string(ex.value) + ", got " + std::to_string(actual) + ")";
+        }
+      }
+      if ((detected & lanes) == lanes) break;
+    }
+    if ((detected & lanes) == lanes) break;
+  }
+  return detected & lanes;
+}
+
+static bool loadTargets(const std::vector<std::string>& stimPaths, std::vector<std::unique_ptr<Target>>& targets) {
+  std::map<std::string, Target*> byProgram;
+  for (const auto& path : stimPaths) {
+    Stimulus stim;
+    ParseResult res = parseStimulus(path, stim);
+    if (!res.ok) {
+      fprintf(stderr, "%s\n", res.msg.c_str());
+      return false;
+    }
+    std::string key = fs::weakly_canonical(stim.programPath).string();
+    Target*& target = byProgram[key];
+    if (!target) {
+      targets.push_back(std::make_unique<Target>());
+      target = targets.back().get();
+      target->programPath = stim.programPath;
+      res = parseFile(stim.programPath, target->prog);
+      if (!res.ok) {
+        fprintf(stderr, "%s: %s\n", stim.programPath.c_str(), res.msg.c_str());
+        return false;
+      }
+    }
+    res = checkStimulusSignals(stim, target->prog);
+    if (!res.ok) {
+      fprintf(stderr, "%s\n", res.msg.c_str());
+      return false;
+    }
+    target->stimuli.push_back(std::move(stim));
+  }
+
+  // Every signal but the constants, once per id (aliases share one)
+  for (auto& target : targets) {
+    const Program& prog = target->prog;
+    target->signalNames.assign(prog.symbolToSignal.size(), std::string());
+    for (const auto& [name, sig] : prog.symbolToSignal) {
+      if (target->signalNames[sig].empty() || name < target->signalNames[sig]) target->signalNames[sig] = name;
+    }
+    for (size_t sig = 0; sig < target->signalNames.size(); ++sig) {
+      if (prog.constantSignalValues.count(static_cast<int>(sig))) continue;
+      target->faults.push_back({static_cast<int>(sig), false});
+      target->faults.push_back({static_cast<int>(sig), true});
+    }
+    target->detected.assign(target->faults.size(), false);
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+  bool quiet = false;
+  double required = 0.0;
+  std::vector<std::string> stimPaths;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "-j" && i + 1 < argc) {
+      jobs = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--quiet") {
+      quiet = true;
+    } else if (arg == "--require" && i + 1 < argc) {
+      required = std::atof(argv[++i]);
+    } else if (fs::is_directory(arg)) {
+      for (const auto& entry : fs::recursive_directory_iterator(arg)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".stim") {
+          stimPaths.push_back(entry.path().string());
+        }
+      }
+    } else {
+      stimPaths.push_back(arg);
+    }
+  }
+  if (stimPaths.empty()) {
+    printf("Usage: gll_fault [-j <threads>] [--quiet] [--require <percent>] <dir | test.stim>...\n");
+    return 2;
+  }
+  std::sort(stimPaths.begin(), stimPaths.end());
+
+  std::vector<std::unique_ptr<Target>> targets;
+  if (!loadTargets(stimPaths, targets)) {
+    return 2;
+  }
+
+  struct Pass {
+    Target* target;
+    size_t first, count;
+    std::string warning;
+  };
+  std::vector<Pass> passes;
+  for (auto& target : targets) {
+    for (size_t first = 0; first < target->faults.size(); first += kFaultsPerPass) {
+      passes.push_back({target.get(), first, std::min<size_t>(kFaultsPerPass, target->faults.size() - first), {}});
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<uint64_t> results(passes.size(), 0);
+  std::atomic<size_t> nextPass{0};
+  std::vector<std::thread> pool;
+  for (unsigned t = 0; t < std::min<size_t>(jobs, passes.size()); ++t) {
+    pool.emplace_back([&] {
+      for (size_t i = nextPass++; i < passes.size(); i = nextPass++) {
+        results[i] = runPass(*passes[i].target, passes[i].first, passes[i].count, passes[i].warning);
+      }
+    });
+  }
+  for (auto& thread : pool) {
+    thread.join();
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  for (size_t i = 0; i < passes.size(); ++i) {
+    Pass& pass = passes[i];
+    for (size_t f = 0; f < pass.count; ++f) {
+      pass.target->detected[pass.first + f] = (results[i] >> (f + 1)) & 1;
+    }
+    auto& warnings = pass.target->warnings;
+    if (!pass.warning.empty() && std::find(warnings.begin(), warnings.end(), pass.warning) == warnings.end()) {
+      warnings.push_back(pass.warning);
+    }
+  }
+
+  size_t totalFaults = 0, totalDetected = 0;
+  bool belowRequired = false;
+  for (const auto& target : targets) {
+    size_t detected = std::count(target->detected.begin(), target->detected.end(), true);
+    size_t faults = target->faults.size();
+    double percent = faults ? 100.0 * detected / faults : 100.0;
+    totalFaults += faults;
+    totalDetected += detected;
+    belowRequired |= percent < required;
+    printf("%s: %zu of %zu stuck-at faults detected (%.1f%%) by %zu stimulus file(s)\n", target->programPath.c_str(),
+           detected, faults, percent, target->stimuli.size());
+    for (const auto& warning : target->warnings) {
+      printf("  warning: %s\n", warning.c_str());
+    }
+    if (quiet) continue;
+    for (size_t f = 0; f < faults; ++f) {
+      if (target->detected[f]) continue;
+      const Fault& fault = target->faults[f];
+      printf("  undetected: %s stuck-at-%d\n", target->signalNames[fault.sig].c_str(), fault.stuckAt1 ? 1 : 0);
+    }
+  }
+  printf("%zu of %zu faults detected in %zu program(s), %zu passes in %.3f s\n", totalDetected, totalFaults,
+         targets.size(), passes.size(), seconds);
+  return belowRequired ? 1 : 0;
+}
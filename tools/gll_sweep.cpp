@@ -0,0 +1,378 @@
+// Parameter sweep: runs one program with every combination of the given
+// TON/TOF preset times and CTU/CTD preset values, fed by a .stim file (or
+// no inputs at all for programs that model their plant themselves), and
+// reports how long each combination took until a signal reached a value.
+// Every combination gets its own lane of a BitSim, so 64 run per pass;
+// passes are spread over a thread pool.
+#include "BitSim.hpp"
+#include "Parser.hpp"
+#include "Stimulus.hpp"
+#include "TimeUtils.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+static constexpr int kLanes = BitSim::kLanes;
+static constexpr uint64_t kMaxCombinations = 100000000;
+
+// One swept preset: "T1=100ms:1s:50ms" or "C1=1:20"
+struct Param {
+  std::string spec, nodeName;
+  int node = -1;
+  bool timer = false;
+  std::vector<double> values; // seconds for timers
+};
+
+struct Options {
+  unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+  float scanTime = 0.01f;
+  ScanOrder order = ScanOrder::Source;
+  std::string untilName;
+  uint64_t untilValue = 1;
+  double maxTime = 60.0;
+  size_t top = 0; // 0 = all
+};
+
+struct Outcome {
+  uint64_t scan = 0; // first scan after which the signal had the value, 0 = never
+  bool passed = true; // expectations of the stimulus
+};
+
+static bool isTime(const std::string& text) {
+  return !text.empty() && (std::isdigit(static_cast<unsigned char>(text[0])) || text[0] == '.');
+}
+
+static bool parseParam(const Program& prog, float scanTime, Param& param, std::string& error) {
+  size_t eq = param.spec.find('=');
+  if (eq == std::string::npos) {
+    error = "expected <node>=<from>:<to>[:<step>]";
+    return false;
+  }
+  param.nodeName = param.spec.substr(0, eq);
+  for (size_t i = 0; i < prog.nodes.size(); ++i) {
+    if (prog.nodes[i].name == param.nodeName) param.node = static_cast<int>(i);
+  }
+  if (param.node < 0) {
+    error = "no node named " + param.nodeName;
+    return false;
+  }
+  auto type = prog.nodes[param.node].type;
+  param.timer = type == Program::Node::TON_ || type == Program::Node::TOF_;
+  if (!param.timer && type != Program::Node::CTU_ && type != Program::Node::CTD_) {
+    error = param.nodeName + " is not a TON, TOF, CTU or CTD";
+    return false;
+  }
+
+  std::vector<std::string> parts;
+  std::string rest = param.spec.substr(eq + 1);
+  for (size_t start = 0;;) {
+    size_t colon = rest.find(':', start);
+    parts.push_back(rest.substr(start, colon - start));
+    if (colon == std::string::npos) break;
+    start = colon + 1;
+  }
+  if (parts.size() < 2 || parts.size() > 3) {
+    error = "expected <from>:<to>[:<step>]";
+    return false;
+  }
+  double from, to, step;
+  if (param.timer) {
+    for (const auto& part : parts) {
+      if (!isTime(part)) {
+        error = "bad time '" + part + "'";
+        return false;
+      }
+    }
+    from = parseTimeStringToFloat(parts[0]);
+    to = parseTimeStringToFloat(parts[1]);
+    step = parts.size() == 3 ? parseTimeStringToFloat(parts[2]) : scanTime;
+  } else {
+    char* end = nullptr;
+    for (const auto& part : parts) {
+      std::strtol(part.c_str(), &end, 10);
+      if (part.empty() || *end) {
+        error = "bad value '" + part + "'";
+        return false;
+      }
+    }
+    from = std::atoi(parts[0].c_str());
+    to = std::atoi(parts[1].c_str());
+    step = parts.size() == 3 ? std::atoi(parts[2].c_str()) : 1;
+  }
+  if (param.timer && from <= 0) {
+    error = "preset times must be positive";
+    return false;
+  }
+  if (step <= 0 || to < from) {
+    error = "empty range";
+    return false;
+  }
+  for (uint64_t k = 0; from + k * step <= to + step * 1e-6; ++k) {
+    param.values.push_back(from + k * step);
+  }
+  return true;
+}
+
+// Value of each parameter in combination `combo`, the last parameter
+// changing fastest
+static void comboValues(const std::vector<Param>& params, uint64_t combo, std::vector<double>& out) {
+  out.resize(params.size());
+  for (size_t p = params.size(); p-- > 0;) {
+    out[p] = params[p].values[combo % params[p].values.size()];
+    combo /= params[p].values.size();
+  }
+}
+
+static void runPass(const Program& prog, const Stimulus* stim, const Options& opt, int untilSig,
+                    const std::vector<Param>& params, uint64_t first, uint64_t combos, std::vector<Outcome>& outcomes) {
+  BitSim sim(prog, opt.order);
+  int count = static_cast<int>(std::min<uint64_t>(kLanes, combos - first));
+  uint64_t lanes = count == kLanes ? ~uint64_t{0} : (uint64_t{1} << count) - 1;
+  std::vector<double> values;
+  for (int lane = 0; lane < count; ++lane) {
+    comboValues(params, first + lane, values);
+    for (size_t p = 0; p < params.size(); ++p) {
+      int node = params[p].node;
+      if (params[p].timer) {
+        sim.setPresetTime(node, lane, static_cast<float>(values[p]));
+        continue;
+      }
+      // A swept PV behaves like one written into the program, so a CTD
+      // starts at it
+      int pv = static_cast<int>(values[p]);
+      sim.setPresetCounter(node, lane, pv);
+      if (prog.nodes[node].type == Program::Node::CTD_) sim.setCounterValue(node, lane, pv);
+    }
+  }
+
+  uint64_t reached = 0, failed = 0;
+  auto check = [&] {
+    uint64_t hit = 0;
+    if (sim.hasValues(untilSig)) {
+      for (int lane = 0; lane < count; ++lane) {
+        if (sim.value(untilSig, lane) == opt.untilValue) hit |= uint64_t{1} << lane;
+      }
+    } else {
+      hit = opt.untilValue == 1 ? sim.bits(untilSig) : opt.untilValue == 0 ? ~sim.bits(untilSig) : 0;
+    }
+    hit &= lanes & ~reached;
+    for (uint64_t bits = hit; bits; bits &= bits - 1) {
+      outcomes[first + std::countr_zero(bits)].scan = sim.scanCount();
+    }
+    reached |= hit;
+  };
+
+  uint64_t maxScans = static_cast<uint64_t>(std::ceil(opt.maxTime / opt.scanTime - 1e-6));
+  uint64_t lastStep = stim && !stim->steps.empty() ? stim->steps.back().scan : 0;
+  if (stim) {
+    for (const auto& step : stim->steps) {
+      while (sim.scanCount() + 1 < step.scan) {
+        sim.scan(opt.scanTime);
+        check();
+      }
+      for (const auto& in : step.inputs) {
+        int sig = prog.symbolToSignal.at(in.name);
+        if (prog.analogSignals.count(sig)) {
+          for (int lane = 0; lane < kLanes; ++lane) {
+            sim.setValue(sig, lane, in.value);
+          }
+        } else {
+          sim.setBits(sig, in.value != 0 ? ~uint64_t{0} : 0);
+        }
+      }
+      if (sim.scanCount() < step.scan) {
+        sim.scan(opt.scanTime);
+        check();
+      }
+      for (const auto& ex : step.expects) {
+        int sig = prog.symbolToSignal.at(ex.name);
+        for (int lane = 0; lane < count; ++lane) {
+          if (sim.value(sig, lane) != ex.value) failed |= uint64_t{1} << lane;
+        }
+      }
+    }
+  }
+  while ((reached & lanes) != lanes && sim.scanCount() < std::max(maxScans, lastStep)) {
+    sim.scan(opt.scanTime);
+    check();
+  }
+  for (int lane = 0; lane < count; ++lane) {
+    outcomes[first + lane].passed = !((failed >> lane) & 1);
+  }
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  std::vector<Param> params;
+  std::string path, until;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "-j" && hasValue) {
+      opt.jobs = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--param" && hasValue) {
+      params.push_back({argv[++i], {}, -1, false, {}});
+    } else if (arg == "--until" && hasValue) {
+      until = argv[++i];
+    } else if (arg == "--max-time" && hasValue) {
+      opt.maxTime = parseTimeStringToFloat(argv[++i]);
+    } else if (arg == "--scan-time" && hasValue) {
+      opt.scanTime = std::max(0.001f, static_cast<float>(std::atof(argv[++i])) / 1000.0f);
+    } else if (arg == "--order" && hasValue) {
+      std::string order = argv[++i];
+      if (order == "settle") {
+        fprintf(stderr, "Settle order is not supported\n");
+        return 2;
+      }
+      if (order != "source" && order != "dependency") {
+        fprintf(stderr, "Unknown order '%s'\n", order.c_str());
+        return 2;
+      }
+      opt.order = order == "dependency" ? ScanOrder::Dependency : ScanOrder::Source;
+    } else if (arg == "--top" && hasValue) {
+      opt.top = std::strtoull(argv[++i], nullptr, 10);
+    } else {
+      path = arg;
+    }
+  }
+  if (path.empty() || params.empty() || until.empty()) {
+    printf("Usage: gll_sweep --param <node>=<from>:<to>[:<step>]... --until <signal>[=<value>]\n"
+           "                 [--max-time <time>] [--scan-time <ms>] [--order source|dependency]\n"
+           "                 [--top <n>] [-j <threads>] <program.gll | test.stim>\n"
+           "Timers take times (--param T1=100ms:1s:50ms, step default one scan), counters\n"
+           "integers (--param C1=1:20, step default 1). Prints one CSV row per combination,\n"
+           "fastest to reach <signal>=<value> first. A .stim file brings its own scan time\n"
+           "and order.\n");
+    return 2;
+  }
+
+  Stimulus stim;
+  bool haveStim = path.size() > 5 && path.compare(path.size() - 5, 5, ".stim") == 0;
+  std::string programPath = path;
+  if (haveStim) {
+    ParseResult res = parseStimulus(path, stim);
+    if (!res.ok) {
+      fprintf(stderr, "%s\n", res.msg.c_str());
+      return 2;
+    }
+    programPath = stim.programPath;
+    opt.scanTime = stim.scanTime;
+    opt.order = stim.order;
+  }
+  Program prog;
+  ParseResult res = parseFile(programPath, prog);
+  if (res.ok && haveStim) res = checkStimulusSignals(stim, prog);
+  if (!res.ok) {
+    fprintf(stderr, "%s: %s\n", programPath.c_str(), res.msg.c_str());
+    return 2;
+  }
+  if (opt.order == ScanOrder::Settle) {
+    fprintf(stderr, "Settle order is not supported\n");
+    return 2;
+  }
+
+  size_t eq = until.find('=');
+  opt.untilName = until.substr(0, eq);
+  if (eq != std::string::npos) opt.untilValue = std::strtoull(until.c_str() + eq + 1, nullptr, 0);
+  auto it = prog.symbolToSignal.find(opt.untilName);
+  if (it == prog.symbolToSignal.end()) {
+    fprintf(stderr, "--until: no signal named %s\n", opt.untilName.c_str());
+    return 2;
+  }
+  int untilSig = it->second;
+
+  uint64_t combos = 1;
+  for (auto& param : params) {
+    std::string error;
+    if (!parseParam(prog, opt.scanTime, param, error)) {
+      fprintf(stderr, "--param %s: %s\n", param.spec.c_str(), error.c_str());
+      return 2;
+    }
+    for (const auto& other : params) {
+      if (&other != &param && other.node == param.node) {
+        fprintf(stderr, "--param %s: %s is swept twice\n", param.spec.c_str(), param.nodeName.c_str());
+        return 2;
+      }
+    }
+    combos *= param.values.size();
+    if (combos > kMaxCombinations) {
+      fprintf(stderr, "More than %llu combinations\n", static_cast<unsigned long long>(kMaxCombinations));
+      return 2;
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<Outcome> outcomes(combos);
+  uint64_t passes = (combos + kLanes - 1) / kLanes;
+  std::atomic<uint64_t> nextPass{0};
+  std::vector<std::thread> pool;
+  for (unsigned t = 0; t < std::min<uint64_t>(opt.jobs, passes); ++t) {
+    pool.emplace_back([&] {
+      for (uint64_t i = nextPass++; i < passes; i = nextPass++) {
+        runPass(prog, haveStim ? &stim : nullptr, opt, untilSig, params, i * kLanes, combos, outcomes);
+      }
+    });
+  }
+  for (auto& thread : pool) {
+    thread.join();
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  // Fastest first; combinations that never got there or failed an
+  // expectation last, each group in sweep order
+  std::vector<uint64_t> order(combos);
+  for (uint64_t i = 0; i < combos; ++i) {
+    order[i] = i;
+  }
+  auto rank = [&](uint64_t i) {
+    const Outcome& o = outcomes[i];
+    return std::pair{!o.passed || o.scan == 0, o.scan};
+  };
+  std::stable_sort(order.begin(), order.end(), [&](uint64_t a, uint64_t b) { return rank(a) < rank(b); });
+
+  std::string header;
+  for (const auto& param : params) {
+    header += param.nodeName + ",";
+  }
+  header += "scan,time";
+  if (haveStim) header += ",expectations";
+  printf("%s\n", header.c_str());
+  uint64_t reached = 0, passed = 0;
+  std::vector<double> values;
+  for (uint64_t i = 0; i < combos; ++i) {
+    const Outcome& o = outcomes[order[i]];
+    reached += o.scan != 0;
+    passed += o.passed;
+    if (opt.top && i >= opt.top) continue;
+    comboValues(params, order[i], values);
+    std::string row;
+    for (size_t p = 0; p < params.size(); ++p) {
+      row += params[p].timer ? parseFloatToTimeString(static_cast<float>(values[p]))
+                             : std::to_string(static_cast<int>(values[p]));
+      row += ",";
+    }
+    if (o.scan) {
+      char time[32];
+      snprintf(time, sizeof(time), "%gs", o.scan * static_cast<double>(opt.scanTime));
+      row += std::to_string(o.scan) + "," + time;
+    } else {
+      row += "-,-";
+    }
+    if (haveStim) row += o.passed ? ",pass" : ",fail";
+    printf("%s\n", row.c_str());
+  }
+  fprintf(stderr, "%llu combinations, %llu reached %s=%llu", static_cast<unsigned long long>(combos),
+          static_cast<unsigned long long>(reached), opt.untilName.c_str(),
+          static_cast<unsigned long long>(opt.untilValue));
+  if (haveStim) fprintf(stderr, ", %llu passed the expectations", static_cast<unsigned long long>(passed));
+  fprintf(stderr, " (%.3f s)\n", seconds);
+  return 0;
+}
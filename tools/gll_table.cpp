@@ -0,0 +1,360 @@
+// Specification extractor: prints the complete truth table of a
+// combinational program, or the reachable state-transition graph of a small
+// sequential one, as CSV or JSON. Rows are computed 64 at a time on a
+// BitSim; truth tables are split across a thread pool.
+#include "BitSim.hpp"
+#include "Graph.hpp"
+#include "Parser.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+static constexpr int kLanes = BitSim::kLanes;
+static constexpr uint64_t kChunkBatches = 256; // 16384 rows per job
+
+struct Options {
+  bool json = false;
+  ScanOrder order = ScanOrder::Source;
+  float scanTime = 0.01f;
+  int maxInputs = 30;
+  size_t maxStates = 4096;
+  unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+};
+
+struct Ports {
+  std::vector<std::string> inputNames, outputNames;
+  std::vector<int> inputs, outputs;
+};
+
+static bool isStateful(const Program::Node& node) {
+  switch (node.type) {
+  case Program::Node::PS_:
+  case Program::Node::NS_:
+  case Program::Node::SR_:
+  case Program::Node::RS_:
+  case Program::Node::TON_:
+  case Program::Node::TOF_:
+  case Program::Node::CTU_:
+  case Program::Node::CTD_:
+    return true;
+  default:
+    return false;
+  }
+}
+
+static std::string jsonList(const std::vector<std::string>& names) {
+  std::string text = "[";
+  for (size_t i = 0; i < names.size(); ++i) {
+    text += (i ? ", \"" : "\"") + names[i] + "\"";
+  }
+  return text + "]";
+}
+
+static void appendValue(std::string& text, uint64_t value) {
+  if (value <= 1) {
+    text += static_cast<char>('0' + value);
+  } else {
+    text += std::to_string(value);
+  }
+}
+
+// Input words for batch `batch`: the first IN is the most significant bit of
+// the row number, so the rows count up in binary
+static void rowInputs(const Ports& ports, uint64_t batch, BitSim& sim) {
+  static constexpr uint64_t kLaneBit[6] = {0xAAAAAAAAAAAAAAAAull, 0xCCCCCCCCCCCCCCCCull, 0xF0F0F0F0F0F0F0F0ull,
+                                           0xFF00FF00FF00FF00ull, 0xFFFF0000FFFF0000ull, 0xFFFFFFFF00000000ull};
+  size_t n = ports.inputs.size();
+  for (size_t i = 0; i < n; ++i) {
+    size_t bit = n - 1 - i;
+    uint64_t word = bit < 6 ? kLaneBit[bit] : (((batch >> (bit - 6)) & 1) ? ~uint64_t{0} : 0);
+    sim.setBits(ports.inputs[i], word);
+  }
+}
+
+static void formatRows(const Ports& ports, const Options& opt, uint64_t firstBatch, uint64_t batches,
+                       uint64_t rows, BitSim& sim, std::string& out) {
+  size_t n = ports.inputs.size();
+  for (uint64_t b = firstBatch; b < firstBatch + batches; ++b) {
+    sim.reset();
+    rowInputs(ports, b, sim);
+    sim.scan(0.0f);
+    for (int lane = 0; lane < kLanes && b * kLanes + lane < rows; ++lane) {
+      uint64_t row = b * kLanes + lane;
+      out += opt.json ? (row ? ",\n    [" : "    [") : "";
+      for (size_t i = 0; i < n; ++i) {
+        if (i) out += ',';
+        appendValue(out, (row >> (n - 1 - i)) & 1);
+      }
+      for (int sig : ports.outputs) {
+        out += ',';
+        appendValue(out, sim.value(sig, lane));
+      }
+      out += opt.json ? "]" : "\n";
+    }
+  }
+}
+
+// All 2^n input combinations, one scan each in dependency order so acyclic
+// logic has settled. Chunks are computed on the pool and written in order.
+static void truthTable(const Program& prog, const Ports& ports, const Options& opt) {
+  uint64_t rows = uint64_t{1} << ports.inputs.size();
+  uint64_t batches = (rows + kLanes - 1) / kLanes;
+  uint64_t chunks = (batches + kChunkBatches - 1) / kChunkBatches;
+
+  std::vector<std::string> header = ports.inputNames;
+  header.insert(header.end(), ports.outputNames.begin(), ports.outputNames.end());
+  if (opt.json) {
+    printf("{\n  \"kind\": \"truth-table\",\n  \"inputs\": %s,\n  \"outputs\": %s,\n  \"rows\": [\n",
+           jsonList(ports.inputNames).c_str(), jsonList(ports.outputNames).c_str());
+  } else {
+    std::string line;
+    for (size_t i = 0; i < header.size(); ++i) {
+      line += (i ? "," : "") + header[i];
+    }
+    printf("%s\n", line.c_str());
+  }
+
+  unsigned jobs = static_cast<unsigned>(std::min<uint64_t>(opt.jobs, chunks));
+  std::vector<std::string> text(jobs);
+  for (uint64_t round = 0; round < chunks; round += jobs) {
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < jobs && round + t < chunks; ++t) {
+      pool.emplace_back([&, t] {
+        BitSim sim(prog, ScanOrder::Dependency);
+        uint64_t first = (round + t) * kChunkBatches;
+        text[t].clear();
+        formatRows(ports, opt, first, std::min(kChunkBatches, batches - first), rows, sim, text[t]);
+      });
+    }
+    for (size_t t = 0; t < pool.size(); ++t) {
+      pool[t].join();
+      fwrite(text[t].data(), 1, text[t].size(), stdout);
+    }
+  }
+  if (opt.json) printf("\n  ]\n}\n");
+}
+
+// Nonzero signals and node memory of one lane, e.g. "Q=1 t1.elapsed=0.03"
+static std::string describeState(const Program& prog, const std::vector<std::string>& signalNames,
+                                 const BitSim& sim, int lane) {
+  std::string text;
+  auto add = [&](const std::string& item) { text += (text.empty() ? "" : " ") + item; };
+  for (size_t sig = 0; sig < signalNames.size(); ++sig) {
+    uint64_t value = sim.value(static_cast<int>(sig), lane);
+    if (value != 0 && !prog.constantSignalValues.count(static_cast<int>(sig))) {
+      add(signalNames[sig] + "=" + std::to_string(value));
+    }
+  }
+  for (size_t i = 0; i < prog.nodes.size(); ++i) {
+    const auto& node = prog.nodes[i];
+    int idx = static_cast<int>(i);
+    if (node.type == Program::Node::TON_ || node.type == Program::Node::TOF_) {
+      if (sim.timerStatus(idx, lane)) add(node.name + ".q=1");
+      if (float elapsed = sim.timerElapsed(idx, lane); elapsed != 0.0f) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%g", elapsed);
+        add(node.name + ".elapsed=" + buf);
+      }
+    }
+    if (node.type == Program::Node::CTU_ || node.type == Program::Node::CTD_) {
+      if (node.cvOutputSignal < 0 && sim.counterValue(idx, lane) != 0) {
+        add(node.name + ".cv=" + std::to_string(sim.counterValue(idx, lane)));
+      }
+    }
+    if (node.type == Program::Node::PS_ || node.type == Program::Node::NS_ || node.type == Program::Node::CTU_ ||
+        node.type == Program::Node::CTD_) {
+      if (sim.previousInput(idx, lane)) add(node.name + ".prev=1");
+    }
+  }
+  return text.empty() ? "-" : text;
+}
+
+// Breadth-first search from the power-on state over all input combinations
+static bool stateGraph(const Program& prog, const Ports& ports, const Options& opt) {
+  std::vector<std::string> signalNames(prog.symbolToSignal.size());
+  for (const auto& [name, id] : prog.symbolToSignal) {
+    signalNames[id] = name;
+  }
+  struct Transition {
+    int from;
+    uint64_t inputs;
+    int to;
+    std::vector<uint64_t> outputs;
+  };
+  std::map<std::vector<uint64_t>, int> ids;
+  std::vector<std::vector<uint64_t>> states;
+  std::vector<std::string> descriptions;
+  std::vector<Transition> transitions;
+
+  BitSim sim(prog, opt.order);
+  std::vector<uint64_t> state;
+  sim.saveLane(0, state);
+  ids.emplace(state, 0);
+  states.push_back(state);
+  descriptions.push_back(describeState(prog, signalNames, sim, 0));
+
+  size_t n = ports.inputs.size();
+  uint64_t combos = uint64_t{1} << n;
+  for (size_t s = 0; s < states.size(); ++s) {
+    for (uint64_t first = 0; first < combos; first += kLanes) {
+      for (int lane = 0; lane < kLanes; ++lane) {
+        sim.loadLane(lane, states[s]);
+      }
+      for (size_t i = 0; i < n; ++i) {
+        uint64_t word = 0;
+        for (int lane = 0; lane < kLanes; ++lane) {
+          word |= (((first + lane) >> (n - 1 - i)) & 1) << lane;
+        }
+        sim.setBits(ports.inputs[i], word);
+      }
+      sim.scan(opt.scanTime);
+      for (int lane = 0; lane < kLanes && first + lane < combos; ++lane) {
+        sim.saveLane(lane, state);
+        auto [it, inserted] = ids.emplace(state, static_cast<int>(states.size()));
+        if (inserted) {
+          if (states.size() >= opt.maxStates) {
+            fprintf(stderr, "More than %zu reachable states, raise --max-states\n", opt.maxStates);
+            return false;
+          }
+          states.push_back(state);
+          descriptions.push_back(describeState(prog, signalNames, sim, lane));
+        }
+        Transition tr{static_cast<int>(s), first + lane, it->second, {}};
+        for (int sig : ports.outputs) {
+          tr.outputs.push_back(sim.value(sig, lane));
+        }
+        transitions.push_back(std::move(tr));
+      }
+    }
+  }
+
+  auto inputBits = [&](uint64_t combo, const char* sep) {
+    std::string text;
+    for (size_t i = 0; i < n; ++i) {
+      if (i) text += sep;
+      appendValue(text, (combo >> (n - 1 - i)) & 1);
+    }
+    return text;
+  };
+  auto outputValues = [&](const std::vector<uint64_t>& values, const char* sep) {
+    std::string text;
+    for (size_t i = 0; i < values.size(); ++i) {
+      if (i) text += sep;
+      appendValue(text, values[i]);
+    }
+    return text;
+  };
+
+  if (opt.json) {
+    printf("{\n  \"kind\": \"state-graph\",\n  \"inputs\": %s,\n  \"outputs\": %s,\n  \"states\": [\n",
+           jsonList(ports.inputNames).c_str(), jsonList(ports.outputNames).c_str());
+    for (size_t s = 0; s < states.size(); ++s) {
+      printf("    {\"id\": %zu, \"state\": \"%s\"}%s\n", s, descriptions[s].c_str(),
+             s + 1 < states.size() ? "," : "");
+    }
+    printf("  ],\n  \"transitions\": [\n");
+    for (size_t t = 0; t < transitions.size(); ++t) {
+      const auto& tr = transitions[t];
+      printf("    {\"from\": %d, \"in\": [%s], \"to\": %d, \"out\": [%s]}%s\n", tr.from,
+             inputBits(tr.inputs, ", ").c_str(), tr.to, outputValues(tr.outputs, ", ").c_str(),
+             t + 1 < transitions.size() ? "," : "");
+    }
+    printf("  ]\n}\n");
+    return true;
+  }
+
+  for (size_t s = 0; s < states.size(); ++s) {
+    printf("# state %zu: %s\n", s, descriptions[s].c_str());
+  }
+  std::string header = "from";
+  for (const auto& name : ports.inputNames) {
+    header += "," + name;
+  }
+  header += ",to";
+  for (const auto& name : ports.outputNames) {
+    header += "," + name;
+  }
+  printf("%s\n", header.c_str());
+  for (const auto& tr : transitions) {
+    printf("%d,%s,%d,%s\n", tr.from, inputBits(tr.inputs, ",").c_str(), tr.to, outputValues(tr.outputs, ",").c_str());
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  std::string path;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "-j" && hasValue) {
+      opt.jobs = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--json") {
+      opt.json = true;
+    } else if (arg == "--order" && hasValue) {
+      std::string order = argv[++i];
+      if (order == "settle") {
+        fprintf(stderr, "Settle order is not supported\n");
+        return 2;
+      }
+      if (order != "source" && order != "dependency") {
+        fprintf(stderr, "Unknown order '%s'\n", order.c_str());
+        return 2;
+      }
+      opt.order = order == "dependency" ? ScanOrder::Dependency : ScanOrder::Source;
+    } else if (arg == "--scan-time" && hasValue) {
+      opt.scanTime = std::max(0.001f, static_cast<float>(std::atof(argv[++i])) / 1000.0f);
+    } else if (arg == "--max-inputs" && hasValue) {
+      opt.maxInputs = std::clamp(std::atoi(argv[++i]), 1, 40);
+    } else if (arg == "--max-states" && hasValue) {
+      opt.maxStates = std::max(1, std::atoi(argv[++i]));
+    } else {
+      path = arg;
+    }
+  }
+  if (path.empty()) {
+    printf("Usage: gll_table [-j <threads>] [--json] [--order source|dependency] [--scan-time <ms>]\n"
+           "                 [--max-inputs <n>] [--max-states <n>] <program>\n");
+    return 2;
+  }
+
+  Program prog;
+  ParseResult res = parseFile(path, prog);
+  if (!res.ok) {
+    fprintf(stderr, "%s: %s\n", path.c_str(), res.msg.c_str());
+    return 2;
+  }
+  if (!prog.analogInputNames.empty()) {
+    fprintf(stderr, "%s: analog inputs (AIN) cannot be enumerated\n", path.c_str());
+    return 2;
+  }
+
+  Ports ports;
+  ports.inputNames = prog.inputNames;
+  ports.outputNames = prog.outputNames;
+  ports.outputNames.insert(ports.outputNames.end(), prog.analogOutputNames.begin(), prog.analogOutputNames.end());
+  for (const auto& name : ports.inputNames) {
+    ports.inputs.push_back(prog.symbolToSignal.at(name));
+  }
+  for (const auto& name : ports.outputNames) {
+    ports.outputs.push_back(prog.symbolToSignal.at(name));
+  }
+
+  std::vector<int> order;
+  bool combinational = computeDependencyOrder(prog, order) && std::none_of(prog.nodes.begin(), prog.nodes.end(), isStateful);
+  int limit = combinational ? opt.maxInputs : std::min(opt.maxInputs, 16);
+  if (static_cast<int>(ports.inputs.size()) > limit) {
+    fprintf(stderr, "%s: %zu inputs, at most %d can be enumerated for a %s program\n", path.c_str(),
+            ports.inputs.size(), limit, combinational ? "combinational" : "sequential");
+    return 2;
+  }
+  if (combinational) {
+    truthTable(prog, ports, opt);
+    return 0;
+  }
+  return stateGraph(prog, ports, opt) ? 0 : 1;
+}
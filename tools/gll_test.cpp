@@ -0,0 +1,123 @@
+// Regression runner: executes every <name>.stim sidecar against its program
+// headless, spread over a thread pool, and reports pass/fail per test.
+#include "Coverage.hpp"
+#include "Graph.hpp"
+#include "Optimizer.hpp"
+#include "Parser.hpp"
+#include "Sim.hpp"
+#include "Stimulus.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct TestOutcome {
+  bool passed = false;
+  uint64_t scans = 0;
+  double millis = 0.0;
+  std::string message;
+  std::string coverage; // report, with --coverage
+};
+
+static TestOutcome runTest(const std::string& stimPath, bool optimize, bool coverage) {
+  TestOutcome outcome;
+  auto start = std::chrono::steady_clock::now();
+  Stimulus stim;
+  Program prog;
+  ParseResult res = parseStimulus(stimPath, stim);
+  if (res.ok) res = parseFile(stim.programPath, prog);
+  if (res.ok) res = checkStimulusSignals(stim, prog);
+  if (!res.ok) {
+    outcome.message = res.msg;
+    return outcome;
+  }
+  if (optimize) {
+    if (stim.order != ScanOrder::Source) {
+      sortNodesByDependencies(prog);
+    }
+    optimizeProgram(prog);
+  }
+  Simulator sim(prog, stim.order);
+  Coverage cov(prog);
+  if (coverage) sim.setCoverage(&cov);
+  StimulusResult run = runStimulus(stim, sim);
+  if (coverage) outcome.coverage = cov.report(stim.programPath);
+  outcome.passed = run.passed;
+  outcome.scans = run.scans;
+  if (!run.passed) {
+    outcome.message = "scan " + std::to_string(run.failScan) + ": " + run.failMessage;
+  }
+  outcome.millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  return outcome;
+}
+
+int main(int argc, char** argv) {
+  unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+  bool optimize = false, quiet = false, coverage = false;
+  std::vector<std::string> tests;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "-j" && i + 1 < argc) {
+      jobs = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--optimize") {
+      optimize = true;
+    } else if (arg == "--quiet") {
+      quiet = true;
+    } else if (arg == "--coverage") {
+      coverage = true;
+    } else if (fs::is_directory(arg)) {
+      for (const auto& entry : fs::recursive_directory_iterator(arg)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".stim") {
+          tests.push_back(entry.path().string());
+        }
+      }
+    } else {
+      tests.push_back(arg);
+    }
+  }
+  if (tests.empty()) {
+    printf("Usage: gll_test [-j <threads>] [--optimize] [--quiet] [--coverage] <dir | test.stim>...\n");
+    return 1;
+  }
+  std::sort(tests.begin(), tests.end());
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<TestOutcome> outcomes(tests.size());
+  std::atomic<size_t> nextTest{0};
+  std::vector<std::thread> pool;
+  for (unsigned t = 0; t < std::min<size_t>(jobs, tests.size()); ++t) {
+    pool.emplace_back([&] {
+      for (size_t i = nextTest++; i < tests.size(); i = nextTest++) {
+        outcomes[i] = runTest(tests[i], optimize, coverage);
+      }
+    });
+  }
+  for (auto& thread : pool) {
+    thread.join();
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  size_t failed = 0;
+  for (size_t i = 0; i < tests.size(); ++i) {
+    const auto& outcome = outcomes[i];
+    if (!outcome.passed) {
+      ++failed;
+      printf("FAIL %s\n     %s\n", tests[i].c_str(), outcome.message.c_str());
+    } else if (!quiet) {
+      printf("PASS %s (%llu scans, %.2f ms)\n", tests[i].c_str(), static_cast<unsigned long long>(outcome.scans),
+             outcome.millis);
+    }
+    if (!outcome.coverage.empty()) {
+      printf("%s", outcome.coverage.c_str());
+    }
+  }
+  printf("%zu passed, %zu failed in %.3f s\n", tests.size() - failed, failed, seconds);
+  return failed == 0 ? 0 : 1;
+}